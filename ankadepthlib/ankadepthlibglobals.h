@@ -16,7 +16,31 @@ namespace AnkaDepthLib
 #define MAX_DISTANCE				40.0f
 #define DISTANCE_SLICE				0.25f		// opt = 0.25f
 #define DISTANCED_SIZE_FACTOR		2.0
+#define ZBUFFER_SPLAT_FACTOR		6.0		// opt = 6.0
+#define OCCUPANCY_TILE_SIZE			64
+#define PANORAMA_TILE_SIZE			256
+#define PANORAMA_HALO				32			// >= widest post filter radius (bilateral d = 50)
+#define GROUND_HEIGHT_QUANTUM		0.001		// metres, when ground poses are quantized
+#define GROUND_CACHE_SIZE			4
 #define DEFAULT_CAM_OFFSET			2.35
+#define PATCH_FILTER_CELL			0.0002		// degrees, filtered patch views are shared within a cell
+#define PATCH_FILTER_MARGIN			16.0		// metres, >= half the diagonal of a cell
+#define PATCH_FILTER_TIME_STEP		10000		// msecs, filtered patch views are shared within a step
+#define PATCH_FILTER_TIME_WINDOW	55.0		// seconds around the task, >= the patch query's 50 + half a step
+#define PATCH_ROW_BYTES				40			// x, y, z, gpstime and intensity of a fetched row as 8 byte values
+#define PATCH_DISK_CACHE_QUEUE_MB	256			// blocks waiting for the disk cache's writer, stores beyond it are dropped
+#define PATCH_DISK_CACHE_SLOTS		64			// worker processes of a host with a disk cache slot of their own
+#define SHARED_PATCH_ARENA_NAME		"AnkaDepthSharedPatchArena"
+#define PATCH_CACHE_SHARDS			16
+#define PATCH_CACHE_FOCUS_POINTS	8			// task positions the trajectory policy keeps patches around
+#define PATCH_CACHE_FOCUS_REACH		120.0		// metres, MAX_DISTANCE plus the extent of a patch and a task step
+#define PATCH_FETCH_BATCH			32			// patches per database round trip
+#define PATCH_FETCH_CONNECTIONS		4			// concurrent batch fetches of a process, over all of its tasks
+#define DB_HEALTH_CHECK_INTERVAL	30000		// msecs a pooled connection may idle before it is checked with a round trip
+#define PATCH_INDEX_CELL			100.0		// metres, grid cell of the worker's patch index
+#define PATCH_TIME_WINDOW			50.0		// seconds between a patch's mean time and the task for it to be a candidate
+#define PATCH_PREFETCH_MAX_STEP		25.0		// metres between a worker's consecutive frames of a drive, longer steps are not extrapolated
+#define TASK_BATCH_MAX				64			// tasks or results in one grid message
 
 #pragma region Inline Functions
 	inline double deg2rad(double deg)
@@ -51,10 +75,10 @@ namespace AnkaDepthLib
 		double d = 0, sum = 0;
 		for (int i = (_row - _size / 2); i <= (_row + _size / 2); i++)
 		{
-			x = i >= 0 ? i : _image.rows - i;
+			x = i >= 0 ? i : _image.rows + i;
 			for (int j = (_col - _size / 2); j <= (_col + _size / 2); j++)
 			{
-				y = j >= 0 ? j : _image.cols - j;
+				y = j >= 0 ? j : _image.cols + j;
 
 				if (!_exceptMid || (_exceptMid && (x != _row && y != _col)))
 				{
@@ -81,10 +105,10 @@ namespace AnkaDepthLib
 		double d = 0, min = 0;
 		for (int i = (_row - _size / 2); i <= (_row + _size / 2); i++)
 		{
-			x = i >= 0 ? i : _image.rows - i;
+			x = i >= 0 ? i : _image.rows + i;
 			for (int j = (_col - _size / 2); j <= (_col + _size / 2); j++)
 			{
-				y = j >= 0 ? j : _image.cols - j;
+				y = j >= 0 ? j : _image.cols + j;
 
 				if (!_exceptMid || (_exceptMid && (x != _row && y != _col)))
 				{
@@ -152,7 +176,18 @@ namespace AnkaDepthLib
 		DTPT_SYS_CALL,
 		DTPT_TASK_CONFIG,
 		DTPT_TASK_EXECUTE,
-		DTPT_TASK_RESULT
+		DTPT_TASK_RESULT,
+		DTPT_TASK_EXECUTE_BATCH,	// a task per argument
+		DTPT_TASK_RESULT_BATCH,		// a status and a task id per pair of arguments
+		DTPT_GRID_CAPS,				// the GridCapabilities of the sender
+		DTPT_TASK_EXECUTE_FRAME,	// a GridFrame of tasks
+		DTPT_TASK_RESULT_FRAME		// a GridFrame of results
+	};
+
+	enum GridCapability
+	{
+		GC_TASK_BATCHES = 1,
+		GC_BINARY_FRAMES = 2
 	};
 
 	enum DepthTaskWorkerStatus
@@ -163,6 +198,71 @@ namespace AnkaDepthLib
 		DTWS_RUNNING = 2,
 		DTWS_COMPLETED = 3
 	};
+
+	enum DepthRasterizerMode
+	{
+		DRM_SLICES = 0,
+		DRM_ZBUFFER = 1
+	};
+
+	enum HoleFillMode
+	{
+		HFM_SCAN = 0,
+		HFM_SUMMED_AREA = 1
+	};
+
+	enum PatchFetchMode
+	{
+		PFM_FULL = 0,
+		PFM_FILTERED = 1
+	};
+
+	enum PatchTransferMode
+	{
+		PTM_ROWS = 0,
+		PTM_BINARY = 1
+	};
+
+	// task fetches go ahead of the prefetcher's on the connection and decode threads
+	enum PatchFetchPriority
+	{
+		PFP_PREFETCH = 0,
+		PFP_TASK = 1
+	};
+
+	enum DatabaseRole
+	{
+		DBR_POINT_CLOUD = 0,
+		DBR_KGM = 1
+	};
+
+	enum PatchCandidateMode
+	{
+		PCM_DATABASE = 0,
+		PCM_INDEX = 1
+	};
+
+	enum PatchCachePolicy
+	{
+		PCP_LRU = 0,
+		PCP_ARC = 1,
+		PCP_TRAJECTORY = 2
+	};
+
+	enum SchedulingMode
+	{
+		SM_SCATTERED = 0,
+		SM_DRIVE_RUNS = 1,
+		SM_HILBERT_RUNS = 2
+	};
+
+	enum SphericalProjectorLevel
+	{
+		SPL_SCALAR = 0,
+		SPL_SSE4 = 1,
+		SPL_AVX2 = 2,
+		SPL_AVX512 = 3
+	};
 #pragma endregion
 
 	class AnkaDepthLibGlobals
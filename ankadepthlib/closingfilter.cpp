@@ -0,0 +1,111 @@
+#include "closingfilter.h"
+#include <cfloat>
+#include <cstring>
+
+using namespace AnkaDepthLib;
+
+ClosingFilter::ClosingFilter()
+{
+}
+
+void ClosingFilter::close(const cv::Mat & _src, cv::Mat & _dst, int _radius, bool _wrapCols)
+{
+	cv::Mat dilated;
+	filter<true>(_src, dilated, _radius, _wrapCols);
+	filter<false>(dilated, _dst, _radius, _wrapCols);
+}
+
+void ClosingFilter::dilate(const cv::Mat & _src, cv::Mat & _dst, int _radius, bool _wrapCols)
+{
+	filter<true>(_src, _dst, _radius, _wrapCols);
+}
+
+void ClosingFilter::erode(const cv::Mat & _src, cv::Mat & _dst, int _radius, bool _wrapCols)
+{
+	filter<false>(_src, _dst, _radius, _wrapCols);
+}
+
+template<bool IsMax>
+void ClosingFilter::filter(const cv::Mat & _src, cv::Mat & _dst, int _radius, bool _wrapCols)
+{
+	CV_Assert(_src.type() == CV_32FC1);
+
+	// separable: along the rows, then along the columns through a transpose so both passes stream memory
+	cv::Mat rows, cols;
+	filterRows<IsMax>(_src, rows, _radius, _wrapCols);
+	cv::transpose(rows, rows);
+	filterRows<IsMax>(rows, cols, _radius, false);
+	cv::transpose(cols, _dst);
+}
+
+template<bool IsMax>
+void ClosingFilter::filterRows(const cv::Mat & _src, cv::Mat & _dst, int _radius, bool _wrap)
+{
+	_dst.create(_src.rows, _src.cols, CV_32FC1);
+
+	int n = _src.cols;
+	if (_radius <= 0 || n == 0)
+	{
+		_src.copyTo(_dst);
+		return;
+	}
+
+	const float identity = IsMax ? -FLT_MAX : FLT_MAX;
+	int k = 2 * _radius + 1;
+
+	// a wrapped window covering the whole ring sees every pixel of the row
+	if (_wrap && k >= n)
+	{
+		for (int y = 0; y < _src.rows; ++y)
+		{
+			const float * s = _src.ptr<float>(y);
+			float e = identity;
+			for (int x = 0; x < n; ++x)
+				e = IsMax ? std::max(e, s[x]) : std::min(e, s[x]);
+
+			float * d = _dst.ptr<float>(y);
+			for (int x = 0; x < n; ++x)
+				d[x] = e;
+		}
+		return;
+	}
+
+	// padded line: _radius pixels on both sides (wrapped or neutral), extended to whole blocks of k
+	int len = n + 2 * _radius;
+	int lenPadded = ((len + k - 1) / k) * k;
+	cv::AutoBuffer<float> buffer(3 * lenPadded);
+	float
+		* line = buffer.data(),
+		* g = line + lenPadded,
+		* h = g + lenPadded;
+
+	for (int y = 0; y < _src.rows; ++y)
+	{
+		const float * s = _src.ptr<float>(y);
+		for (int i = 0; i < _radius; ++i)
+		{
+			line[i] = _wrap ? s[n - _radius + i] : identity;
+			line[_radius + n + i] = _wrap ? s[i] : identity;
+		}
+		memcpy(line + _radius, s, n * sizeof(float));
+		for (int i = len; i < lenPadded; ++i)
+			line[i] = identity;
+
+		// running extreme from the start (g) and from the end (h) of each block
+		for (int b = 0; b < lenPadded; b += k)
+		{
+			g[b] = line[b];
+			for (int i = b + 1; i < b + k; ++i)
+				g[i] = IsMax ? std::max(g[i - 1], line[i]) : std::min(g[i - 1], line[i]);
+
+			h[b + k - 1] = line[b + k - 1];
+			for (int i = b + k - 2; i >= b; --i)
+				h[i] = IsMax ? std::max(h[i + 1], line[i]) : std::min(h[i + 1], line[i]);
+		}
+
+		// the window [x, x + k) of the padded line spans at most two blocks
+		float * d = _dst.ptr<float>(y);
+		for (int x = 0; x < n; ++x)
+			d[x] = IsMax ? std::max(h[x], g[x + k - 1]) : std::min(h[x], g[x + k - 1]);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+namespace AnkaDepthLib
+{
+	// morphological closing of CV_32FC1 depth images with a square structuring element, using van Herk/Gil-Werman
+	// running max/min so the cost per pixel does not depend on the element size
+	class ClosingFilter
+	{
+	public:
+		// closes _src with a (2 * _radius + 1) square element; columns wrap around the 0/360 seam when _wrapCols is set,
+		// otherwise the borders are ignored exactly like cv::morphologyEx's default border
+		static void close(const cv::Mat & _src, cv::Mat & _dst, int _radius, bool _wrapCols = true);
+
+		static void dilate(const cv::Mat & _src, cv::Mat & _dst, int _radius, bool _wrapCols = true);
+		static void erode(const cv::Mat & _src, cv::Mat & _dst, int _radius, bool _wrapCols = true);
+
+		// radius of the single element equivalent to _iterations passes of a _size x _size element
+		static inline int equivalentRadius(int _size, int _iterations)
+		{
+			return (_size / 2) * _iterations;
+		}
+
+	private:
+		ClosingFilter();
+
+		template<bool IsMax>
+		static void filterRows(const cv::Mat & _src, cv::Mat & _dst, int _radius, bool _wrap);
+
+		template<bool IsMax>
+		static void filter(const cv::Mat & _src, cv::Mat & _dst, int _radius, bool _wrapCols);
+	};
+}
\ No newline at end of file
@@ -0,0 +1,152 @@
+#include "dbconnectionpool.h"
+#include <QSqlError>
+
+using namespace AnkaDepthLib;
+
+QThreadStorage<DBConnectionPool::ThreadConnections *> DBConnectionPool::mConnections;
+QAtomicInt DBConnectionPool::mGeneration(0);
+QAtomicInt DBConnectionPool::mSerial(0);
+DepthConfiguration * DBConnectionPool::mConfig = nullptr;
+
+DBConnectionPool::DBConnectionPool()
+{
+}
+
+void DBConnectionPool::init(DepthConfiguration * _config)
+{
+	mConfig = _config;
+	mGeneration.ref();
+}
+
+QSqlDatabase DBConnectionPool::database(DatabaseRole _database)
+{
+	Connection * connection = DBConnectionPool::connection(_database);
+	return connection ? connection->db : QSqlDatabase();
+}
+
+bool DBConnectionPool::exec(DatabaseRole _database, const QString & _name, const QString & _sql, const QVariantList & _values, QSqlQuery & _query)
+{
+	for (int attempt = 0; attempt < 2; ++attempt)
+	{
+		Connection * connection = DBConnectionPool::connection(_database, attempt > 0);
+		if (!connection)
+			return false;
+
+		QHash<QString, QSqlQuery>::iterator it = connection->statements.find(_name);
+		if (it == connection->statements.end())
+		{
+			QSqlQuery statement(connection->db);
+			statement.setForwardOnly(true);
+			if (!statement.prepare(_sql))
+			{
+				_query = statement;
+				// a statement that fails to prepare on a live connection fails on a new one too
+				if (isAlive(*connection))
+					return false;
+				continue;
+			}
+			it = connection->statements.insert(_name, statement);
+		}
+
+		QSqlQuery & statement = it.value();
+		for (int i = 0; i < _values.count(); ++i)
+			statement.bindValue(i, _values[i]);
+
+		bool res = statement.exec();
+		_query = statement;
+		connection->lastUse.start();
+		if (res || isAlive(*connection))
+			return res;
+	}
+
+	return false;
+}
+
+DBConnectionPool::Connection * DBConnectionPool::connection(DatabaseRole _database, bool _reopen)
+{
+	if (!mConfig)
+		return nullptr;
+
+	// deleted with the thread, on the thread, which closes its connections
+	if (!mConnections.hasLocalData())
+		mConnections.setLocalData(new ThreadConnections());
+
+	Connection & connection = mConnections.localData()->connections[_database];
+	bool valid =
+		!_reopen &&
+		connection.db.isOpen() &&
+		connection.generation == mGeneration.load() &&
+		(connection.lastUse.elapsed() < DB_HEALTH_CHECK_INTERVAL || isAlive(connection));
+
+	if (!valid && !open(connection, _database))
+		return nullptr;
+
+	connection.lastUse.start();
+	return &connection;
+}
+
+bool DBConnectionPool::open(Connection & _connection, DatabaseRole _database)
+{
+	_connection.close();
+
+	// names are never reused, a connection of a thread that has gone may still be being removed
+	_connection.name = QString("db_pool_%1_%2").arg(_database).arg(mSerial.fetchAndAddRelaxed(1));
+	_connection.generation = mGeneration.load();
+	_connection.db = QSqlDatabase::addDatabase("QPSQL", _connection.name);
+	if (_database == DBR_KGM)
+	{
+		_connection.db.setHostName(mConfig->kgmDatabaseIp());
+		_connection.db.setPort(mConfig->kgmDatabasePort());
+		_connection.db.setDatabaseName(mConfig->kgmDatabaseName());
+		_connection.db.setUserName(mConfig->kgmDatabaseUserName());
+		_connection.db.setPassword(mConfig->kgmDatabasePassword());
+		_connection.db.setConnectOptions(mConfig->kgmDatabaseOptions());
+	}
+	else
+	{
+		_connection.db.setHostName(mConfig->pcDatabaseIp());
+		_connection.db.setPort(mConfig->pcDatabasePort());
+		_connection.db.setDatabaseName(mConfig->pcDatabaseName());
+		_connection.db.setUserName(mConfig->pcDatabaseUserName());
+		_connection.db.setPassword(mConfig->pcDatabasePassword());
+		_connection.db.setConnectOptions(mConfig->pcDatabaseOptions());
+	}
+
+	return _connection.db.open();
+}
+
+bool DBConnectionPool::isAlive(Connection & _connection)
+{
+	if (!_connection.db.isOpen())
+		return false;
+
+	QSqlQuery query(_connection.db);
+	bool res = query.exec("SELECT 1") && query.next();
+	_connection.lastUse.start();
+	return res;
+}
+
+#pragma region Connection
+DBConnectionPool::Connection::Connection()
+	: generation(-1)
+{
+}
+
+DBConnectionPool::Connection::~Connection()
+{
+	close();
+}
+
+void DBConnectionPool::Connection::close()
+{
+	if (name.isEmpty())
+		return;
+
+	// the statements and the handle are copies of the connection, they go before it is removed
+	statements.clear();
+	db.close();
+	db = QSqlDatabase();
+	QSqlDatabase::removeDatabase(name);
+	name.clear();
+}
+#pragma endregion
\ No newline at end of file
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <QString>
+#include <QHash>
+#include <QVariantList>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QElapsedTimer>
+#include <QThreadStorage>
+#include <QAtomicInt>
+#include "ankadepthlibglobals.h"
+#include "depthconfiguration.h"
+
+namespace AnkaDepthLib
+{
+	// long lived database connections, one per thread and database. a QSqlDatabase may only be used by the thread that
+	// opened it, so every thread keeps its own in thread local storage for as long as it lives. the pools running the
+	// tasks, the fetch batches and the prefetches never let their threads expire, so an idle worker keeps the
+	// connections and the statements prepared on them; the patch index's thread runs once per configuration and lets
+	// its connection go when it expires
+	class DBConnectionPool
+	{
+	public:
+		// the settings of the connections; connections opened with earlier settings are reopened on their next use
+		static void init(DepthConfiguration * _config);
+
+		// the calling thread's connection to _database, opened on first use. checked with a round trip after it idled
+		// for DB_HEALTH_CHECK_INTERVAL and reopened if it has dropped; not open if the server cannot be reached
+		static QSqlDatabase database(DatabaseRole _database);
+
+		// runs the statement _name on the calling thread's connection with _values bound in order; it is prepared from
+		// _sql the first time the connection runs it. a connection the execution finds dropped is reopened and the
+		// statement run once more. _query is left on the result
+		static bool exec(DatabaseRole _database, const QString & _name, const QString & _sql, const QVariantList & _values, QSqlQuery & _query);
+
+	private:
+		DBConnectionPool();
+
+		class Connection
+		{
+		public:
+			Connection();
+			~Connection();
+
+			void close();
+
+			QString name;
+			QSqlDatabase db;
+			QHash<QString, QSqlQuery> statements;
+			QElapsedTimer lastUse;
+			int generation;
+		};
+
+		class ThreadConnections
+		{
+		public:
+			Connection connections[2];
+		};
+
+		// the calling thread's connection, opened or reopened as needed; nullptr if it cannot be opened
+		static Connection * connection(DatabaseRole _database, bool _reopen = false);
+		static bool open(Connection & _connection, DatabaseRole _database);
+		static bool isAlive(Connection & _connection);
+
+		static QThreadStorage<ThreadConnections *> mConnections;
+		static QAtomicInt mGeneration;
+		static QAtomicInt mSerial;
+		static DepthConfiguration * mConfig;
+	};
+}
\ No newline at end of file
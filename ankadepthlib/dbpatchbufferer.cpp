@@ -1,16 +1,46 @@
 #include "dbpatchbufferer.h"
+#include "dbconnectionpool.h"
 #include <QSqlDatabase>
 #include <QSqlQuery>
 #include <QSqlResult>
 #include <QSqlError>
 #include <QThread>
+#include <QVector>
+#include <QSet>
+#include <cmath>
 
 using namespace AnkaDepthLib;
 
-QQueue<int> DBPatchBufferer::mPatchBufferQueue;
-QMap<int, LidarPointVector> DBPatchBufferer::mPatchBufferMap;
+PatchCache DBPatchBufferer::mCache;
 QReadWriteLock DBPatchBufferer::mRWLock;
+QMap<int, PcPatchDecoder> DBPatchBufferer::mDecoders;
+TransverseMercator DBPatchBufferer::mProjection;
+PatchDiskCache DBPatchBufferer::mDiskCache;
+SharedPatchArena DBPatchBufferer::mSharedArena;
+PatchIndex DBPatchBufferer::mPatchIndex;
 DepthConfiguration * DBPatchBufferer::mDepthConfig = nullptr;
+QReadWriteLock DBPatchBufferer::mInitLock(QReadWriteLock::Recursive);
+QString DBPatchBufferer::mDatabaseSettings;
+QString DBPatchBufferer::mDiskCacheSettings;
+QString DBPatchBufferer::mArenaSettings;
+QString DBPatchBufferer::mCacheSettings;
+QString DBPatchBufferer::mIndexSettings;
+
+PatchFetchStatistics::PatchFetchStatistics()
+	:
+	patches(0),
+	cachedPatches(0),
+	sharedPatches(0),
+	diskPatches(0),
+	rows(0),
+	culledRows(0)
+{
+}
+
+qint64 PatchFetchStatistics::culledBytes() const
+{
+	return culledRows * PATCH_ROW_BYTES;
+}
 
 DBPatchBufferer::DBPatchBufferer(QObject * _parent)
 	: QObject(_parent)
@@ -21,127 +51,535 @@ DBPatchBufferer::~DBPatchBufferer()
 {
 }
 
+DBPatchBufferer::PatchRows::PatchRows()
+	: total(-1)
+{
+}
+
 void AnkaDepthLib::DBPatchBufferer::init(DepthConfiguration * _depthConfig)
 {
+	// the loads and candidate queries in flight finish first and new ones wait; a configuration sent again keeps the
+	// connections, the opened host caches and the index
+	QWriteLocker locker(&mInitLock);
+	bool rebound = mDepthConfig != _depthConfig;
 	mDepthConfig = _depthConfig;
+
+	QString database = (QStringList()
+		<< mDepthConfig->pcDatabaseIp() << QString::number(mDepthConfig->pcDatabasePort()) << mDepthConfig->pcDatabaseName()
+		<< mDepthConfig->pcDatabaseUserName() << mDepthConfig->pcDatabasePassword() << mDepthConfig->pcDatabaseOptions()
+		<< mDepthConfig->kgmDatabaseIp() << QString::number(mDepthConfig->kgmDatabasePort()) << mDepthConfig->kgmDatabaseName()
+		<< mDepthConfig->kgmDatabaseUserName() << mDepthConfig->kgmDatabasePassword() << mDepthConfig->kgmDatabaseOptions()).join('\n');
+	if (rebound || database != mDatabaseSettings)
+	{
+		DBConnectionPool::init(mDepthConfig);
+		mDatabaseSettings = database;
+	}
+
+	// the process cache holds points projected to the old zone, the host caches key them by zone
+	if (mDepthConfig->utmZone() != mProjection.zone())
+	{
+		mProjection = TransverseMercator(mDepthConfig->utmZone());
+		mCache.clear();
+	}
+
+	QString diskCache = QString("%1\n%2").arg(mDepthConfig->patchDiskCacheDir()).arg(mDepthConfig->patchDiskCacheMB());
+	if (diskCache != mDiskCacheSettings)
+	{
+		mDiskCache.open(mDepthConfig->patchDiskCacheDir(), (qint64)mDepthConfig->patchDiskCacheMB() << 20);
+		mDiskCacheSettings = diskCache;
+	}
+
+	QString arena = QString::number(mDepthConfig->sharedPatchArenaMB());
+	if (arena != mArenaSettings)
+	{
+		mSharedArena.open(SHARED_PATCH_ARENA_NAME, (qint64)mDepthConfig->sharedPatchArenaMB() << 20);
+		mArenaSettings = arena;
+	}
+
+	QString cache = QString("%1\n%2").arg((int)mDepthConfig->patchCachePolicy()).arg(mDepthConfig->patchCacheMB());
+	if (cache != mCacheSettings)
+	{
+		mCache.setPolicy(mDepthConfig->patchCachePolicy());
+		mCache.setBudget((qint64)mDepthConfig->patchCacheMB() << 20);
+		mCacheSettings = cache;
+	}
+
+	// the index is read back from its snapshot while pc_table is unchanged, otherwise built again and snapshotted,
+	// off the caller's thread
+	QString index = QString("%1\n%2\n%3").arg((int)mDepthConfig->patchCandidateMode()).arg(mDepthConfig->patchIndexSnapshot()).arg(mProjection.srid());
+	if (index == mIndexSettings)
+		return;
+	mIndexSettings = index;
+
+	if (mDepthConfig->patchCandidateMode() == PCM_INDEX)
+		mPatchIndex.prepare(mDepthConfig->patchIndexSnapshot(), mProjection);
+	else
+		mPatchIndex.reset(mProjection);
 }
 
-bool DBPatchBufferer::loadPatch(int _patchId, QString _lon, QString _lat, LidarPointVector * _pointsOut)
+bool DBPatchBufferer::candidatePatches(double _lon, double _lat, const QString & _timeStamp, int _limit, QVector<int> & _patchIdsOut, QString * _errorOut)
 {
-	bool
-		res = false,
-		contains = false,
-		dbContains = false,
-		dbLoad = false;
+	_patchIdsOut.clear();
+	QReadLocker locker(&mInitLock);
 
-	QString dbName = QString("db_patch_%1").arg(_patchId);
+	double time = PatchIndex::secondsOf(_timeStamp);
+	if (mPatchIndex.isReady() && !std::isnan(time))
+	{
+		double x = 0, y = 0;
+		mProjection.forward(_lon, _lat, x, y);
+		_patchIdsOut = mPatchIndex.candidates(x, y, MAX_DISTANCE, time, _limit);
+		return true;
+	}
 
-	mRWLock.lockForWrite();
-	res = contains = mPatchBufferQueue.contains(_patchId);
-	dbContains = QSqlDatabase::contains(dbName);
-	if (dbLoad = (!contains && !dbContains))
-	{
-		QSqlDatabase db = QSqlDatabase::addDatabase("QPSQL", dbName);
-		db.setHostName(mDepthConfig->pcDatabaseIp());
-		db.setPort(mDepthConfig->pcDatabasePort());
-		db.setDatabaseName(mDepthConfig->pcDatabaseName());
-		db.setUserName(mDepthConfig->pcDatabaseUserName());
-		db.setPassword(mDepthConfig->pcDatabasePassword());
-		db.setConnectOptions(mDepthConfig->pcDatabaseOptions());
+	// without the worker's patch index the database is asked, over the thread's pooled connection where the candidate
+	// query is prepared once
+	QSqlDatabase db = DBConnectionPool::database(DBR_POINT_CLOUD);
+	if (!db.isOpen())
+	{
+		if (_errorOut)
+			*_errorOut = QString("Point cloud database connection error: %1").arg(db.lastError().text());
+		return false;
+	}
+
+	static const QString qStr = "\
+	WITH patches AS\
+	(\
+		SELECT\
+		((PC_PatchMax(pa, 'gpstime') + PC_PatchMin(pa, 'gpstime')) / 2.0) / 1000000 as patch_time_avg,\
+		(SELECT regexp_matches(filename, '(20[0-9]{2}.[0-9]{2}.[0-9]{2})', 'g'))[1] as patch_date,\
+		*\
+		FROM pc_table\
+		WHERE PC_Intersects(ST_Transform(ST_Buffer(ST_Transform(ST_SetSRID(ST_MakePoint(?::float8, ?::float8), 4326), ?::int), ?::float8), 4326), pa)\
+		)\
+	SELECT\
+	id\
+	FROM patches\
+	WHERE ABS(\
+		(date_part('epoch', to_timestamp(patch_date, 'YYYY-MM-DD')) + patch_time_avg) -\
+		(date_part('epoch', to_timestamp(?::text, 'YYYY-MM-DD HH24:MI:SS.FF')))\
+	) < 50\
+	ORDER BY id\
+	LIMIT ?::int\
+	";
+
+	QSqlQuery query;
+	QVariantList values = QVariantList()
+		<< _lon
+		<< _lat
+		<< mProjection.srid()
+		<< (double)MAX_DISTANCE
+		<< _timeStamp
+		<< _limit;
+	if (!DBConnectionPool::exec(DBR_POINT_CLOUD, "patch_candidates", qStr, values, query))
+	{
+		if (_errorOut)
+			*_errorOut = QString("Point cloud database error: %1").arg(query.lastError().text());
+		return false;
 	}
-	mRWLock.unlock();
 
-	while (!dbLoad && !contains)
+	while (query.next())
+		_patchIdsOut.push_back(query.value(0).toInt());
+	query.finish();
+	return true;
+}
+
+void DBPatchBufferer::addFocus(double _x, double _y)
+{
+	mCache.addFocus(_x, _y);
+}
+
+bool DBPatchBufferer::loadPatch(int _patchId, const PatchFilter & _filter, PointBlockVector * _blocksOut, PatchFetchStatistics * _statsOut)
+{
+	return loadPatches(QVector<int>() << _patchId, _filter, _blocksOut, _statsOut);
+}
+
+bool DBPatchBufferer::loadPatches(QVector<int> _patches, const PatchFilter & _filter, PointBlockVector * _blocksOut, PatchFetchStatistics * _statsOut, PatchFetchPriority _priority)
+{
+	// filtered views of the same patch are loaded and cached independently; patches another task is loading right now
+	// are waited for, not loaded twice
+	QReadLocker locker(&mInitLock);
+	QStringList keys;
+	for (QVector<int>::const_iterator it = _patches.constBegin(); it != _patches.constEnd(); ++it)
+		keys << cacheKey(*it, _filter);
+
+	PointBlockVector blocks;
+	QVector<bool> loaded;
+	bool res = mCache.getAll(keys, [&](const QVector<int> & _indices, const PatchCache::Delivery & _deliver)
 	{
-		mRWLock.lockForRead();
-		res = contains = mPatchBufferQueue.contains(_patchId) && !QSqlDatabase::contains(dbName);
-		mRWLock.unlock();
+		fetchPatches(_patches, keys, _indices, _filter, _deliver, _statsOut, _priority);
+	}, blocks, &loaded);
+
+	// the cache and the tasks share the packed blocks
+	for (int i = 0; i < blocks.count(); ++i)
+	{
+		if (!blocks[i].isValid())
+			continue;
+
+		if (_blocksOut)
+			_blocksOut->push_back(blocks[i]);
+
+		if (_statsOut && !loaded[i])
+			++_statsOut->cachedPatches;
 	}
 
-	if (dbLoad)
+	return res;
+}
+
+void DBPatchBufferer::fetchPatches(const QVector<int> & _patches, const QStringList & _keys, const QVector<int> & _indices, const PatchFilter & _filter, const PatchCache::Delivery & _deliver, PatchFetchStatistics * _statsOut, PatchFetchPriority _priority)
+{
+	// the host's shared arena and the disk cache first, the database only for patches no worker of this host has
+	// loaded and no earlier run has stored
+	QHash<int, int> missing;
+	QVector<int> missingIds;
+	for (QVector<int>::const_iterator it = _indices.constBegin(); it != _indices.constEnd(); ++it)
 	{
-		// db scope
+		QString hostKey = hostCacheKey(_keys[*it]);
+		PointBlock block = mSharedArena.load(hostKey);
+		bool fromArena = block.isValid();
+		// the host's other workers read it in the arena instead of the file, and so does this one from now on
+		if (!fromArena && (block = mDiskCache.load(hostKey)).isValid())
+			block = arenaBlock(hostKey, block);
+
+		if (!block.isValid())
+		{
+			missing.insert(_patches[*it], *it);
+			missingIds.push_back(_patches[*it]);
+			continue;
+		}
+
+		if (_statsOut)
 		{
-			QSqlDatabase db = QSqlDatabase::database(dbName);
-
-			QString qStr = QString("\
-			WITH points AS (\
-				SELECT PC_Explode(pa) AS point\
-				FROM pc_table\
-				WHERE id=%1\
-			)\
+			++(fromArena ? _statsOut->sharedPatches : _statsOut->diskPatches);
+			_statsOut->rows += block.count();
+		}
+		_deliver(*it, true, block);
+	}
+
+	if (missingIds.isEmpty())
+		return;
+
+	// the decode threads hand their patches in here; the statistics and the fallback list are shared between them
+	QMutex mutex;
+	QVector<int> undecoded;
+	FetchSink sink = [&](int _patchId, const PointBlock & _block, qint64 _total)
+	{
+		int index = missing.value(_patchId, -1);
+		if (index < 0)
+			return;
+
+		QString hostKey = hostCacheKey(_keys[index]);
+		PointBlock block = arenaBlock(hostKey, _block);
+
+		if (_statsOut)
+		{
+			QMutexLocker locker(&mutex);
+			++_statsOut->patches;
+			_statsOut->rows += _block.count();
+			if (_total >= _block.count())
+				_statsOut->culledRows += _total - _block.count();
+		}
+		_deliver(index, true, block);
+
+		// written by the disk cache's own thread, the task does not wait for the disk
+		mDiskCache.post(hostKey, _block);
+	};
+	std::function<void(int)> fallback = [&](int _patchId)
+	{
+		QMutexLocker locker(&mutex);
+		undecoded.push_back(_patchId);
+	};
+
+	// the batches run over several connections at once and every patch is decoded while later batches are in flight;
+	// the binary transfer hands the patches it cannot decode back, they follow as rows
+	PatchFetchPipeline pipeline(_priority);
+	bool binary = mDepthConfig->patchTransferMode() == PTM_BINARY;
+	for (int pass = 0; pass < 2 && !missingIds.isEmpty(); ++pass)
+	{
+		for (int b = 0; b < missingIds.count(); b += PATCH_FETCH_BATCH)
+		{
+			QVector<int> batch = missingIds.mid(b, PATCH_FETCH_BATCH);
+			pipeline.fetch([&, batch, binary]() { fetchBatch(pipeline, batch, _filter, binary, sink, fallback); });
+		}
+		pipeline.wait();
+
+		missingIds = binary ? undecoded : QVector<int>();
+		binary = false;
+	}
+}
+
+void DBPatchBufferer::fetchBatch(PatchFetchPipeline & _pipeline, const QVector<int> & _patches, const PatchFilter & _filter, bool _binary, const FetchSink & _sink, const std::function<void(int)> & _fallback)
+{
+	// over the connection thread's pooled connection; patches of a failed batch are not delivered, the cache fails
+	// them and the next task asking tries again
+	if (_binary)
+		fetchBinary(_patches, _filter, _pipeline, _sink, _fallback);
+	else
+		fetchRows(_patches, _filter, _pipeline, _sink);
+}
+
+bool DBPatchBufferer::fetchRows(const QVector<int> & _patches, const PatchFilter & _filter, PatchFetchPipeline & _pipeline, const FetchSink & _sink)
+{
+	static const QString rowsSql = "\
+		WITH points AS (\
+			SELECT id, PC_Explode(pa) AS point\
+			FROM pc_table\
+			WHERE id = ANY(?::int[])\
+		)\
+		SELECT\
+		id,\
+		PC_Get(point, 'x') as x,\
+		PC_Get(point, 'y') as y,\
+		PC_Get(point, 'z') as z,\
+		PC_GET(point, 'gpstime') as gpstime,\
+		PC_GET(point, 'intensity') as intensity\
+		FROM points\
+		";
+
+	// the patches are cut to the geographic box of the range around the task and to the time window before they are
+	// exploded; gpstime counts microseconds from the patch day, which comes from its file name like in the task's
+	// patch query. an extra row per patch with only its point count feeds the statistics
+	static const QString filteredRowsSql = "\
+		WITH patch AS (\
 			SELECT\
-			ST_X(ST_Transform(point::geometry, 32635)) as x,\
-			ST_Y(ST_Transform(point::geometry, 32635)) as y,\
-			ST_Z(ST_Transform(point::geometry, 32635)) as z,\
-			PC_GET(point, 'gpstime') as gpstime,\
-			PC_GET(point, 'intensity') as intensity\
-			FROM points\
-			").arg(_patchId);
-
-			if (db.open())
-			{
-				QSqlQuery query(db);
-				query.setForwardOnly(true);
-				if (query.exec(qStr))
-				{
-					mRWLock.lockForWrite();
-					while(mPatchBufferQueue.count() >= (QThread::idealThreadCount() * mDepthConfig->patchLimit()))
-						mPatchBufferMap.remove(mPatchBufferQueue.dequeue());
-
-					while (query.next())
-					{
-						LidarPoint p(
-							query.value(0).toDouble(),
-							query.value(1).toDouble(),
-							query.value(2).toDouble(),
-							query.value(3).toLongLong(),
-							query.value(4).toInt()
-						);
-
-						mPatchBufferMap[_patchId].push_back(p);
-
-						if (_pointsOut)
-							_pointsOut->push_back(p);
-					}
-					mPatchBufferQueue.enqueue(_patchId);
-
-					mRWLock.unlock();
-					query.finish();
-					res = true;
-				}
-				db.close();
-			}
+			id,\
+			pa,\
+			(date_part('epoch', to_timestamp(?::text, 'YYYY-MM-DD HH24:MI:SS.FF')) -\
+			date_part('epoch', to_timestamp((SELECT regexp_matches(filename, '(20[0-9]{2}.[0-9]{2}.[0-9]{2})', 'g'))[1], 'YYYY-MM-DD'))) * 1000000 AS task_time\
+			FROM pc_table\
+			WHERE id = ANY(?::int[])\
+		),\
+		points AS (\
+			SELECT id, PC_Explode(\
+				PC_FilterBetween(\
+				PC_FilterBetween(\
+				PC_FilterBetween(pa, 'gpstime', task_time - ?::float8, task_time + ?::float8),\
+				'x', ?::float8, ?::float8),\
+				'y', ?::float8, ?::float8)\
+			) AS point\
+			FROM patch\
+		)\
+		SELECT id, PC_NumPoints(pa)::float8, NULL, NULL, NULL, NULL FROM patch\
+		UNION ALL\
+		SELECT\
+		id,\
+		PC_Get(point, 'x') as x,\
+		PC_Get(point, 'y') as y,\
+		PC_Get(point, 'z') as z,\
+		PC_GET(point, 'gpstime') as gpstime,\
+		PC_GET(point, 'intensity') as intensity\
+		FROM points\
+		";
+
+	QSqlQuery query;
+	bool executed = _filter.isNull() ?
+		DBConnectionPool::exec(DBR_POINT_CLOUD, "patch_rows", rowsSql, QVariantList() << idList(_patches), query) :
+		DBConnectionPool::exec(DBR_POINT_CLOUD, "patch_rows_filtered", filteredRowsSql, filterValues(_patches, _filter), query);
+	if (!executed)
+		return false;
+
+	// the rows of a batch come in no particular order, they are collected per patch
+	QHash<int, QSharedPointer<PatchRows>> rows;
+	for (QVector<int>::const_iterator it = _patches.constBegin(); it != _patches.constEnd(); ++it)
+		rows.insert(*it, QSharedPointer<PatchRows>(new PatchRows()));
+
+	while (query.next())
+	{
+		QSharedPointer<PatchRows> patch = rows.value(query.value(0).toInt());
+		if (patch.isNull())
+			continue;
+
+		// the statistics row has no coordinates, it may come at any position of the union
+		if (query.isNull(2))
+		{
+			patch->total = query.value(1).toLongLong();
+			continue;
 		}
-		mRWLock.lockForWrite();
-		QSqlDatabase::removeDatabase(dbName);
-		mRWLock.unlock();
+
+		patch->x.push_back(query.value(1).toDouble());
+		patch->y.push_back(query.value(2).toDouble());
+		patch->z.push_back(query.value(3).toDouble());
+		patch->time.push_back(query.value(4).toLongLong());
+		patch->intensity.push_back(query.value(5).toInt());
 	}
-	else if (contains && _pointsOut)
+	query.finish();
+
+	for (QHash<int, QSharedPointer<PatchRows>>::const_iterator it = rows.constBegin(); it != rows.constEnd(); ++it)
 	{
-		mRWLock.lockForRead();
-		_pointsOut->append(mPatchBufferMap[_patchId]);
-		mRWLock.unlock();
+		int patchId = it.key();
+		QSharedPointer<PatchRows> patch = it.value();
+		_pipeline.decode([patchId, patch, _sink]()
+		{
+			// the rows carry the patch's geographic coordinates, projected here in one batch
+			mProjection.forward(patch->x.constData(), patch->y.constData(), patch->x.count(), patch->x.data(), patch->y.data());
+
+			PointBlockBuilder builder(patch->x.count());
+			for (int i = 0; i < patch->x.count(); ++i)
+				builder.append(patch->x[i], patch->y[i], patch->z[i], patch->time[i], patch->intensity[i]);
+
+			_sink(patchId, builder.build(), patch->total);
+		});
 	}
 
-	return res;
+	return true;
 }
 
-bool DBPatchBufferer::loadPatches(QVector<int> _patches, QString _lon, QString _lat, LidarPointVector * _pointsOut)
+bool DBPatchBufferer::fetchBinary(const QVector<int> & _patches, const PatchFilter & _filter, PatchFetchPipeline & _pipeline, const FetchSink & _sink, const std::function<void(int)> & _fallback)
 {
-	for (QVector<int>::iterator it = _patches.begin(); it != _patches.end(); ++it)
-		if (!loadPatch(*it, _lon, _lat, _pointsOut))
-			return false;
+	// the whole patches, one value each, uncompressed so the layout is the schema's; no explode and no transform on
+	// the server
+	static const QString binarySql = "\
+		SELECT\
+		id,\
+		PC_NumPoints(pa),\
+		PC_Uncompress(pa)::text\
+		FROM pc_table\
+		WHERE id = ANY(?::int[])\
+		";
+
+	static const QString filteredBinarySql = "\
+		WITH patch AS (\
+			SELECT\
+			id,\
+			pa,\
+			(date_part('epoch', to_timestamp(?::text, 'YYYY-MM-DD HH24:MI:SS.FF')) -\
+			date_part('epoch', to_timestamp((SELECT regexp_matches(filename, '(20[0-9]{2}.[0-9]{2}.[0-9]{2})', 'g'))[1], 'YYYY-MM-DD'))) * 1000000 AS task_time\
+			FROM pc_table\
+			WHERE id = ANY(?::int[])\
+		)\
+		SELECT\
+		id,\
+		PC_NumPoints(pa),\
+		PC_Uncompress(\
+			PC_FilterBetween(\
+			PC_FilterBetween(\
+			PC_FilterBetween(pa, 'gpstime', task_time - ?::float8, task_time + ?::float8),\
+			'x', ?::float8, ?::float8),\
+			'y', ?::float8, ?::float8)\
+		)::text\
+		FROM patch\
+		";
+
+	QSqlQuery query;
+	bool executed = _filter.isNull() ?
+		DBConnectionPool::exec(DBR_POINT_CLOUD, "patch_binary", binarySql, QVariantList() << idList(_patches), query) :
+		DBConnectionPool::exec(DBR_POINT_CLOUD, "patch_binary_filtered", filteredBinarySql, filterValues(_patches, _filter), query);
+	if (!executed)
+	{
+		for (QVector<int>::const_iterator it = _patches.constBegin(); it != _patches.constEnd(); ++it)
+			_fallback(*it);
+		return false;
+	}
+
+	// every patch goes to a decode thread as soon as its value is in, the decoders are resolved here on the connection
+	QSet<int> received;
+	while (query.next())
+	{
+		int patchId = query.value(0).toInt();
+		qint64 total = query.value(1).toLongLong();
+		received.insert(patchId);
+
+		// a filter that leaves no point gives no patch
+		if (query.isNull(2))
+		{
+			_sink(patchId, PointBlockBuilder().build(), total);
+			continue;
+		}
+
+		// the patch's text form is its hex WKB
+		QByteArray wkb = QByteArray::fromHex(query.value(2).toByteArray());
+		PcPatchDecoder patchDecoder = decoder(PcPatchDecoder::pcidOf(wkb));
+		if (!patchDecoder.isValid())
+		{
+			_fallback(patchId);
+			continue;
+		}
+
+		_pipeline.decode([patchId, total, wkb, patchDecoder, _sink, _fallback]()
+		{
+			PointBlockBuilder builder(std::max(PcPatchDecoder::pointCountOf(wkb), 0));
+			if (patchDecoder.decode(wkb, mProjection, builder))
+				_sink(patchId, builder.build(), total);
+			else
+				_fallback(patchId);
+		});
+	}
+	query.finish();
+
+	// patches the server did not return are left to the row transfer like those it cannot decode
+	for (QVector<int>::const_iterator it = _patches.constBegin(); it != _patches.constEnd(); ++it)
+		if (!received.contains(*it))
+			_fallback(*it);
 
 	return true;
 }
 
-void DBPatchBufferer::clearBuffer()
+PcPatchDecoder DBPatchBufferer::decoder(int _pcid)
 {
-	mRWLock.lockForWrite();
+	mRWLock.lockForRead();
+	bool known = mDecoders.contains(_pcid);
+	PcPatchDecoder res = mDecoders.value(_pcid);
+	mRWLock.unlock();
+
+	if (known || _pcid < 0)
+		return res;
 
-	mPatchBufferMap.clear();
-	mPatchBufferQueue.clear();
+	// unknown or unreadable schemas are remembered as invalid decoders, their patches are fetched as rows
+	QSqlQuery query;
+	if (DBConnectionPool::exec(DBR_POINT_CLOUD, "pointcloud_format", "SELECT srid, schema FROM pointcloud_formats WHERE pcid = ?::int", QVariantList() << _pcid, query) && query.next())
+		res = PcPatchDecoder(_pcid, query.value(0).toInt(), query.value(1).toString());
+	query.finish();
 
+	mRWLock.lockForWrite();
+	mDecoders.insert(_pcid, res);
 	mRWLock.unlock();
+
+	return res;
+}
+
+QString DBPatchBufferer::idList(const QVector<int> & _patches)
+{
+	// an int[] literal, bound as one value
+	QStringList ids;
+	for (QVector<int>::const_iterator it = _patches.constBegin(); it != _patches.constEnd(); ++it)
+		ids << QString::number(*it);
+	return QString("{%1}").arg(ids.join(','));
+}
+
+QVariantList DBPatchBufferer::filterValues(const QVector<int> & _patches, const PatchFilter & _filter)
+{
+	// in the order of the placeholders of the filtered statements
+	double window = _filter.timeWindow() * 1000000.0;
+	return QVariantList()
+		<< _filter.timeStamp()
+		<< idList(_patches)
+		<< window
+		<< window
+		<< _filter.lonMin()
+		<< _filter.lonMax()
+		<< _filter.latMin()
+		<< _filter.latMax();
+}
+
+QString DBPatchBufferer::cacheKey(int _patchId, const PatchFilter & _filter)
+{
+	if (_filter.isNull())
+		return QString::number(_patchId);
+
+	return QString("%1@%2").arg(_patchId).arg(_filter.key());
+}
+
+QString DBPatchBufferer::hostCacheKey(const QString & _key)
+{
+	return QString("%1/%2").arg(mProjection.srid()).arg(_key);
+}
+
+PointBlock DBPatchBufferer::arenaBlock(const QString & _hostKey, const PointBlock & _block)
+{
+	PointBlock block = mSharedArena.store(_hostKey, _block);
+	return block.isValid() ? block : _block;
+}
+
+void DBPatchBufferer::clearBuffer()
+{
+	mCache.clear();
 }
\ No newline at end of file
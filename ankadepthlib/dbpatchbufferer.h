@@ -1,29 +1,126 @@
 #pragma once
 
+#include <functional>
 #include <QObject>
-#include <QQueue>
+#include <QStringList>
+#include <QVariantList>
 #include <QMap>
 #include <QReadWriteLock>
-#include "lidarpoint.h"
+#include <QSqlDatabase>
+#include "pointblock.h"
+#include "patchcache.h"
+#include "patchfetchpipeline.h"
+#include "patchfilter.h"
+#include "pcpatchdecoder.h"
+#include "patchdiskcache.h"
+#include "sharedpatcharena.h"
+#include "patchindex.h"
+#include "transversemercator.h"
 #include "depthconfiguration.h"
 
 namespace AnkaDepthLib
 {
+	// what a set of patch loads fetched, and what the server side filter of filtered fetches dropped
+	class PatchFetchStatistics
+	{
+	public:
+		PatchFetchStatistics();
+
+		// bytes of the culled rows' values that did not cross the wire
+		qint64 culledBytes() const;
+
+		int patches;		// fetched from the database
+		int cachedPatches;	// served from the cache
+		int sharedPatches;	// copied from the arena the host's workers share
+		int diskPatches;	// read back from the disk cache
+		qint64 rows;		// point rows fetched
+		qint64 culledRows;	// rows the filters dropped before exploding the patches
+	};
+
 	class DBPatchBufferer : public QObject
 	{
 		Q_OBJECT
 	public:
 		~DBPatchBufferer();
+		// again whenever the configuration changes: the projection zone and the host caches come from it. waits for the
+		// loads in flight and sets up again only the parts whose settings changed
 		static void init(DepthConfiguration * _depthConfig);
-		static bool loadPatch(int _patchId, QString _lon, QString _lat, LidarPointVector * _pointsOut = nullptr);
-		static bool loadPatches(QVector<int> _patchIds, QString _lon, QString _lat, LidarPointVector * _pointsOut = nullptr);
+		// a non-null _filter fetches and caches only the filtered view of the patch, under a key that includes the filter
+		static bool loadPatch(int _patchId, const PatchFilter & _filter, PointBlockVector * _blocksOut = nullptr, PatchFetchStatistics * _statsOut = nullptr);
+		// the prefetcher loads at PFP_PREFETCH, its batches wait for a connection behind those of the tasks
+		static bool loadPatches(QVector<int> _patchIds, const PatchFilter & _filter, PointBlockVector * _blocksOut = nullptr, PatchFetchStatistics * _statsOut = nullptr, PatchFetchPriority _priority = PFP_TASK);
 		static void clearBuffer();
 
+		// ids of the patches around a task position and time, from the worker's patch index when it has one and from
+		// the database otherwise; false with the reason in _errorOut if the database could not be asked
+		static bool candidatePatches(double _lon, double _lat, const QString & _timeStamp, int _limit, QVector<int> & _patchIdsOut, QString * _errorOut = nullptr);
+
+		// UTM position of a task about to load its patches, the trajectory cache policy keeps the patches around it
+		static void addFocus(double _x, double _y);
+
 	private:
 		DBPatchBufferer(QObject * _parent = nullptr);
-		static QQueue<int> mPatchBufferQueue;
-		static QMap<int, LidarPointVector> mPatchBufferMap;
+
+		// delivers a fetched patch with the point count it had before the filter, from the decode threads
+		typedef std::function<void(int _patchId, const PointBlock & _block, qint64 _total)> FetchSink;
+
+		// exploded rows of a patch, collected from a batch's result for its decode job
+		class PatchRows
+		{
+		public:
+			PatchRows();
+
+			QVector<double> x;
+			QVector<double> y;
+			QVector<double> z;
+			QVector<qint64> time;
+			QVector<int> intensity;
+			qint64 total;
+		};
+
+		static QString cacheKey(int _patchId, const PatchFilter & _filter);
+		static QString idList(const QVector<int> & _patches);
+		static QVariantList filterValues(const QVector<int> & _patches, const PatchFilter & _filter);
+
+		// the loader of the patches missing from the process cache: the host caches, then batches from the database
+		static void fetchPatches(const QVector<int> & _patches, const QStringList & _keys, const QVector<int> & _indices, const PatchFilter & _filter, const PatchCache::Delivery & _deliver, PatchFetchStatistics * _statsOut, PatchFetchPriority _priority);
+
+		// the host caches outlive the configuration and the process, their keys also name the projection of the points
+		static QString hostCacheKey(const QString & _key);
+		// _block copied into the host's arena and read there, so the process cache keeps no more than a handle of it;
+		// _block itself while the arena is off or has no room for it
+		static PointBlock arenaBlock(const QString & _hostKey, const PointBlock & _block);
+
+		// one batch over the pooled connection of the calling thread, its patches decoded on _pipeline; patches the
+		// binary transfer cannot decode go to _fallback
+		static void fetchBatch(PatchFetchPipeline & _pipeline, const QVector<int> & _patches, const PatchFilter & _filter, bool _binary, const FetchSink & _sink, const std::function<void(int)> & _fallback);
+
+		// one row per point, exploded on the database server and projected in the decode jobs
+		static bool fetchRows(const QVector<int> & _patches, const PatchFilter & _filter, PatchFetchPipeline & _pipeline, const FetchSink & _sink);
+
+		// every patch as one uncompressed WKB value, decoded and projected in the decode jobs
+		static bool fetchBinary(const QVector<int> & _patches, const PatchFilter & _filter, PatchFetchPipeline & _pipeline, const FetchSink & _sink, const std::function<void(int)> & _fallback);
+
+		// decoder of a pcid, its schema is read from pointcloud_formats once
+		static PcPatchDecoder decoder(int _pcid);
+
+		static PatchCache mCache;
+		static QMap<int, PcPatchDecoder> mDecoders;
+		static TransverseMercator mProjection;
+		static PatchDiskCache mDiskCache;
+		static SharedPatchArena mSharedArena;
+		static PatchIndex mPatchIndex;
 		static QReadWriteLock mRWLock;
 		static DepthConfiguration * mDepthConfig;
+
+		// held for reading by the loads and candidate queries, for writing while init swaps what they use
+		static QReadWriteLock mInitLock;
+
+		// the settings the connections, the host caches, the process cache and the index were set up from last
+		static QString mDatabaseSettings;
+		static QString mDiskCacheSettings;
+		static QString mArenaSettings;
+		static QString mCacheSettings;
+		static QString mIndexSettings;
 	};
 }
\ No newline at end of file
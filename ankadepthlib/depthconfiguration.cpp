@@ -3,7 +3,26 @@
 #include <QSettings>
 
 AnkaDepthLib::DepthConfiguration::DepthConfiguration(QObject * _parent)
-	: QObject(_parent)
+	: QObject(_parent),
+	mRasterizerMode(DRM_SLICES),
+	mHoleFillMode(HFM_SCAN),
+	mGroundPoseQuantum(0),
+	mTaskParallelism(0),
+	mPatchFetchMode(PFM_FULL),
+	mPatchTransferMode(PTM_ROWS),
+	mUtmZone(35),
+	mPatchDiskCacheMB(0),
+	mSharedPatchArenaMB(0),
+	mPatchCacheMB(2048),
+	mPatchCachePolicy(PCP_LRU),
+	mPatchCandidateMode(PCM_DATABASE),
+	mPatchPrefetchFrames(0),
+	mPatchPrefetchConcurrency(2),
+	mSchedulingMode(SM_SCATTERED),
+	mWorkerQueueDepth(0),
+	mTaskResultWindow(0),
+	mTaskTimeout(600),
+	mStatusInterval(1000)
 {
 }
 
@@ -57,6 +76,28 @@ QString AnkaDepthLib::DepthConfiguration::toString()
 	sl << mStartWorkTime.toString("hh:mm:ss");
 	sl << mStopWorkTime.toString("hh:mm:ss");
 
+	sl << QString::number(mRasterizerMode);
+	sl << QString::number(mHoleFillMode);
+	sl << QString::number(mGroundPoseQuantum);
+	sl << QString::number(mTaskParallelism);
+	sl << QString::number(mPatchFetchMode);
+	sl << QString::number(mPatchTransferMode);
+	sl << QString::number(mUtmZone);
+	sl << mPatchDiskCacheDir;
+	sl << QString::number(mPatchDiskCacheMB);
+	sl << QString::number(mSharedPatchArenaMB);
+	sl << QString::number(mPatchCacheMB);
+	sl << QString::number(mPatchCachePolicy);
+	sl << QString::number(mPatchCandidateMode);
+	sl << mPatchIndexSnapshot;
+	sl << QString::number(mPatchPrefetchFrames);
+	sl << QString::number(mPatchPrefetchConcurrency);
+	sl << QString::number(mSchedulingMode);
+	sl << QString::number(mWorkerQueueDepth);
+	sl << QString::number(mTaskResultWindow);
+	sl << QString::number(mTaskTimeout);
+	sl << QString::number(mStatusInterval);
+
 	return sl.join(ComputeGrid::ComputeGridGlobals::ProcessCommandDataSeperator);
 }
 
@@ -94,6 +135,28 @@ void AnkaDepthLib::DepthConfiguration::fromString(QString & _string)
 	mFullDayWorkAtSunday = (sl.takeFirst().toInt() > 0);
 	mStartWorkTime = QTime::fromString(sl.takeFirst(), "hh:mm:ss");
 	mStopWorkTime = QTime::fromString(sl.takeFirst(), "hh:mm:ss");
+
+	mRasterizerMode = (DepthRasterizerMode)sl.takeFirst().toInt();
+	mHoleFillMode = (HoleFillMode)sl.takeFirst().toInt();
+	mGroundPoseQuantum = sl.takeFirst().toDouble();
+	mTaskParallelism = sl.takeFirst().toInt();
+	mPatchFetchMode = (PatchFetchMode)sl.takeFirst().toInt();
+	mPatchTransferMode = (PatchTransferMode)sl.takeFirst().toInt();
+	mUtmZone = sl.takeFirst().toInt();
+	mPatchDiskCacheDir = sl.takeFirst();
+	mPatchDiskCacheMB = sl.takeFirst().toInt();
+	mSharedPatchArenaMB = sl.takeFirst().toInt();
+	mPatchCacheMB = sl.takeFirst().toInt();
+	mPatchCachePolicy = (PatchCachePolicy)sl.takeFirst().toInt();
+	mPatchCandidateMode = (PatchCandidateMode)sl.takeFirst().toInt();
+	mPatchIndexSnapshot = sl.takeFirst();
+	mPatchPrefetchFrames = sl.takeFirst().toInt();
+	mPatchPrefetchConcurrency = sl.takeFirst().toInt();
+	mSchedulingMode = (SchedulingMode)sl.takeFirst().toInt();
+	mWorkerQueueDepth = sl.takeFirst().toInt();
+	mTaskResultWindow = sl.takeFirst().toInt();
+	mTaskTimeout = sl.takeFirst().toInt();
+	mStatusInterval = sl.takeFirst().toInt();
 }
 
 void AnkaDepthLib::DepthConfiguration::fromIni(const QString & _iniFile)
@@ -127,6 +190,23 @@ void AnkaDepthLib::DepthConfiguration::fromIni(const QString & _iniFile)
 	mWorkerReprocess = (settings.value("WorkerReprocess", 0).toInt() > 0);
 	mInputRootDirs = settings.value("InputRootDirs").toStringList();
 	mInputSubDirs = settings.value("InputSubDirs").toStringList();
+	mPatchFetchMode = (PatchFetchMode)settings.value("PatchFetchMode", PFM_FULL).toInt();
+	mPatchTransferMode = (PatchTransferMode)settings.value("PatchTransferMode", PTM_ROWS).toInt();
+	mUtmZone = settings.value("UtmZone", 35).toInt();
+	mPatchDiskCacheDir = settings.value("PatchDiskCacheDir").toString();
+	mPatchDiskCacheMB = settings.value("PatchDiskCacheMB", 0).toInt();
+	mSharedPatchArenaMB = settings.value("SharedPatchArenaMB", 0).toInt();
+	mPatchCacheMB = settings.value("PatchCacheMB", 2048).toInt();
+	mPatchCachePolicy = (PatchCachePolicy)settings.value("PatchCachePolicy", PCP_LRU).toInt();
+	mPatchCandidateMode = (PatchCandidateMode)settings.value("PatchCandidateMode", PCM_DATABASE).toInt();
+	mPatchIndexSnapshot = settings.value("PatchIndexSnapshot").toString();
+	mPatchPrefetchFrames = settings.value("PatchPrefetchFrames", 0).toInt();
+	mPatchPrefetchConcurrency = settings.value("PatchPrefetchConcurrency", 2).toInt();
+	mSchedulingMode = (SchedulingMode)settings.value("SchedulingMode", SM_SCATTERED).toInt();
+	mWorkerQueueDepth = settings.value("WorkerQueueDepth", 0).toInt();
+	mTaskResultWindow = settings.value("TaskResultWindow", 0).toInt();
+	mTaskTimeout = settings.value("TaskTimeout", 600).toInt();
+	mStatusInterval = settings.value("StatusInterval", 1000).toInt();
 	settings.endGroup();
 
 	settings.beginGroup("WorkSchedule");
@@ -137,6 +217,13 @@ void AnkaDepthLib::DepthConfiguration::fromIni(const QString & _iniFile)
 	mStopWorkTime = QTime::fromString(settings.value("StopWorkTime").toString(), "hh:mm:ss");
 	settings.endGroup();
 
+	settings.beginGroup("RenderParameters");
+	mRasterizerMode = (DepthRasterizerMode)settings.value("RasterizerMode", DRM_SLICES).toInt();
+	mHoleFillMode = (HoleFillMode)settings.value("HoleFillMode", HFM_SCAN).toInt();
+	mGroundPoseQuantum = settings.value("GroundPoseQuantum", 0).toDouble();
+	mTaskParallelism = settings.value("TaskParallelism", 0).toInt();
+	settings.endGroup();
+
 	//clean empty list entries
 	for (int i = mInputRootDirs.count() - 1; i >= 0; --i)
 	{
@@ -281,4 +368,109 @@ QTime AnkaDepthLib::DepthConfiguration::stopWorkTime()
 {
 	return mStopWorkTime;
 }
+
+AnkaDepthLib::DepthRasterizerMode AnkaDepthLib::DepthConfiguration::rasterizerMode()
+{
+	return mRasterizerMode;
+}
+
+AnkaDepthLib::HoleFillMode AnkaDepthLib::DepthConfiguration::holeFillMode()
+{
+	return mHoleFillMode;
+}
+
+double AnkaDepthLib::DepthConfiguration::groundPoseQuantum()
+{
+	return mGroundPoseQuantum;
+}
+
+int AnkaDepthLib::DepthConfiguration::taskParallelism()
+{
+	return mTaskParallelism;
+}
+
+AnkaDepthLib::PatchFetchMode AnkaDepthLib::DepthConfiguration::patchFetchMode()
+{
+	return mPatchFetchMode;
+}
+
+AnkaDepthLib::PatchTransferMode AnkaDepthLib::DepthConfiguration::patchTransferMode()
+{
+	return mPatchTransferMode;
+}
+
+int AnkaDepthLib::DepthConfiguration::utmZone()
+{
+	return mUtmZone;
+}
+
+QString AnkaDepthLib::DepthConfiguration::patchDiskCacheDir()
+{
+	return mPatchDiskCacheDir;
+}
+
+int AnkaDepthLib::DepthConfiguration::patchDiskCacheMB()
+{
+	return mPatchDiskCacheMB;
+}
+
+int AnkaDepthLib::DepthConfiguration::sharedPatchArenaMB()
+{
+	return mSharedPatchArenaMB;
+}
+
+int AnkaDepthLib::DepthConfiguration::patchCacheMB()
+{
+	return mPatchCacheMB;
+}
+
+AnkaDepthLib::PatchCachePolicy AnkaDepthLib::DepthConfiguration::patchCachePolicy()
+{
+	return mPatchCachePolicy;
+}
+
+AnkaDepthLib::PatchCandidateMode AnkaDepthLib::DepthConfiguration::patchCandidateMode()
+{
+	return mPatchCandidateMode;
+}
+
+QString AnkaDepthLib::DepthConfiguration::patchIndexSnapshot()
+{
+	return mPatchIndexSnapshot;
+}
+
+int AnkaDepthLib::DepthConfiguration::patchPrefetchFrames()
+{
+	return mPatchPrefetchFrames;
+}
+
+int AnkaDepthLib::DepthConfiguration::patchPrefetchConcurrency()
+{
+	return mPatchPrefetchConcurrency;
+}
+
+AnkaDepthLib::SchedulingMode AnkaDepthLib::DepthConfiguration::schedulingMode()
+{
+	return mSchedulingMode;
+}
+
+int AnkaDepthLib::DepthConfiguration::workerQueueDepth()
+{
+	return mWorkerQueueDepth;
+}
+
+int AnkaDepthLib::DepthConfiguration::taskResultWindow()
+{
+	return mTaskResultWindow;
+}
+
+int AnkaDepthLib::DepthConfiguration::taskTimeout()
+{
+	return mTaskTimeout;
+}
+
+int AnkaDepthLib::DepthConfiguration::statusInterval()
+{
+	return mStatusInterval;
+}
 #pragma endregion
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include <QObject>
 #include <QDataStream>
 #include <QTime>
+#include "ankadepthlibglobals.h"
 
 namespace AnkaDepthLib
 {
@@ -51,6 +52,28 @@ namespace AnkaDepthLib
 		bool fullDayWorkAtSunday();
 		QTime startWorkTime();
 		QTime stopWorkTime();
+
+		DepthRasterizerMode rasterizerMode();
+		HoleFillMode holeFillMode();
+		double groundPoseQuantum();
+		int taskParallelism();
+		PatchFetchMode patchFetchMode();
+		PatchTransferMode patchTransferMode();
+		int utmZone();
+		QString patchDiskCacheDir();
+		int patchDiskCacheMB();
+		int sharedPatchArenaMB();
+		int patchCacheMB();
+		PatchCachePolicy patchCachePolicy();
+		PatchCandidateMode patchCandidateMode();
+		QString patchIndexSnapshot();
+		int patchPrefetchFrames();
+		int patchPrefetchConcurrency();
+		SchedulingMode schedulingMode();
+		int workerQueueDepth();
+		int taskResultWindow();
+		int taskTimeout();
+		int statusInterval();
 #pragma endregion
 
 	private:
@@ -89,6 +112,28 @@ namespace AnkaDepthLib
 		QTime
 			mStartWorkTime,
 			mStopWorkTime;
+
+		DepthRasterizerMode mRasterizerMode;
+		HoleFillMode mHoleFillMode;
+		double mGroundPoseQuantum;
+		int mTaskParallelism;
+		PatchFetchMode mPatchFetchMode;
+		PatchTransferMode mPatchTransferMode;
+		int mUtmZone;
+		QString mPatchDiskCacheDir;
+		int mPatchDiskCacheMB;
+		int mSharedPatchArenaMB;
+		int mPatchCacheMB;
+		PatchCachePolicy mPatchCachePolicy;
+		PatchCandidateMode mPatchCandidateMode;
+		QString mPatchIndexSnapshot;
+		int mPatchPrefetchFrames;
+		int mPatchPrefetchConcurrency;
+		SchedulingMode mSchedulingMode;
+		int mWorkerQueueDepth;
+		int mTaskResultWindow;
+		int mTaskTimeout;
+		int mStatusInterval;
 #pragma endregion
 
 	};
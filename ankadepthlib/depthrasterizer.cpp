@@ -0,0 +1,172 @@
+#include "depthrasterizer.h"
+#include "occupancygrid.h"
+#include "closingfilter.h"
+#include "parallelexecutor.h"
+
+using namespace AnkaDepthLib;
+
+DepthRasterizer::DepthRasterizer()
+{
+}
+
+void DepthRasterizer::rasterizeSlices(const ProjectedPoints & _points, const DistanceBuckets & _buckets, PanoramaBuffer & _image, const bool & _interrupted)
+{
+	cv::Mat imgTemp(_image.rows(), _image.cols(), CV_32FC1, cv::Scalar(0));
+	OccupancyGrid occupancy(imgTemp.rows, imgTemp.cols);
+	float d = 0;
+	int slice = _buckets.sliceCount(), sz = 0, px = 0, py = 0;
+	const float * dist = _points.r();
+	const int * x = _points.x(), * y = _points.y();
+	while (!_interrupted && --slice >= 0)
+	{
+		for (int i = _buckets.begin(slice); !_interrupted && i < _buckets.end(slice); ++i)
+		{
+			d = dist[i];
+
+			if (d > 0)
+			{
+				px = x[i];
+				py = y[i];
+				paint(imgTemp, occupancy, py, px, d);
+
+				sz = (int)(DISTANCED_SIZE_FACTOR - (d / MAX_DISTANCE * DISTANCED_SIZE_FACTOR)) + 1;
+
+				if (d < NEAR_DISTANCE_THRESHOLD && py - sz >= 0 && px - sz >= 0)
+				{
+					paint(imgTemp, occupancy, py - sz, px - sz, d);
+					paint(imgTemp, occupancy, py - sz, (px + sz) % (int)W, d);
+					paint(imgTemp, occupancy, (py + sz) % (int)H, px - sz, d);
+					paint(imgTemp, occupancy, (py + sz) % (int)H, (px + sz) % (int)W, d);
+
+					sz *= 2;
+					if (py - sz >= 0 && px - sz >= 0)
+					{
+						_image.at(py - sz, px - sz) = d;
+						_image.atWrapped(py - sz, px + sz) = d;
+						_image.at((py + sz) % (int)H, px - sz) = d;
+						_image.atWrapped((py + sz) % (int)H, px + sz) = d;
+					}
+				}
+			}
+		}
+
+		if (occupancy.isEmpty())
+			continue;
+
+		// closing with sz iterations of an sz x sz kernel is a single closing of radius sz * (sz / 2); an output pixel only
+		// depends on the input within twice that radius and stays empty farther away from the painted tiles
+		sz = ((int)(6.0f - (slice * DISTANCE_SLICE / MAX_DISTANCE * 6.0f)) * 2) + 1;
+		int radius = ClosingFilter::equivalentRadius(sz, sz);
+		int margin = 2 * radius;
+		// the regions are disjoint, each one is closed and merged on its own
+		QVector<cv::Rect> regions = occupancy.regions(margin, true);
+		ParallelExecutor::parallelFor(regions.count(), [&](int _begin, int _end)
+		{
+			for (int i = _begin; !_interrupted && i < _end; ++i)
+			{
+				const cv::Rect & out = regions[i];
+				int
+					top = std::max(out.y - margin, 0),
+					bottom = std::min(out.y + out.height + margin, imgTemp.rows),
+					left = out.x - margin;
+				bool ring = out.width + 2 * margin >= imgTemp.cols;
+
+				// a window around the whole panorama is closed as a ring, narrower ones are cut out across the seam
+				cv::Mat window, closed;
+				if (ring)
+				{
+					window = imgTemp.rowRange(top, bottom);
+					left = 0;
+				}
+				else
+					window = wrappedColumns(imgTemp.rowRange(top, bottom), left, out.width + 2 * margin);
+
+				ClosingFilter::close(window, closed, radius, ring);
+
+				for (int r = 0; !_interrupted && r < out.height; ++r)
+				{
+					const float * src = closed.ptr<float>(out.y - top + r);
+					for (int c = out.x, cs = out.x - left; c < out.x + out.width; ++c, ++cs)
+					{
+						float v = src[cs >= closed.cols ? cs - closed.cols : cs];
+						if (v > 0)
+							_image.atWrapped(out.y + r, c) = v;
+					}
+				}
+			}
+		});
+
+		occupancy.clearImage(imgTemp);
+		occupancy.reset();
+	}
+}
+
+cv::Mat DepthRasterizer::wrappedColumns(const cv::Mat & _image, int _left, int _width)
+{
+	cv::Mat res(_image.rows, _width, _image.type());
+	int x = _left % _image.cols, o = 0;
+	if (x < 0)
+		x += _image.cols;
+
+	while (o < _width)
+	{
+		int w = std::min(_image.cols - x, _width - o);
+		_image.colRange(x, x + w).copyTo(res.colRange(o, o + w));
+		o += w;
+		x = 0;
+	}
+
+	return res;
+}
+
+void DepthRasterizer::rasterizeZBuffer(const ProjectedPoints & _points, const DistanceBuckets & _buckets, PanoramaBuffer & _image, const bool & _interrupted)
+{
+	// no kernel reads the z-buffer's neighbourhood, so it needs no halo
+	PanoramaBuffer zBuffer(_image.rows(), _image.cols(), _image.tileSize(), 0);
+	int bands = ParallelExecutor::parallelism();
+
+	// every thread owns a band of rows and splats the parts of the footprints that fall into it
+	ParallelExecutor::parallelFor(bands, [&](int _begin, int _end)
+	{
+		int
+			first = (int)((qint64)zBuffer.rows() * _begin / bands),
+			last = (int)((qint64)zBuffer.rows() * _end / bands) - 1,
+			px = 0,
+			py = 0,
+			rad = 0;
+		float d = 0;
+		const float * dist = _points.r();
+		const int * x = _points.x(), * y = _points.y();
+
+		// the buckets are one run of points from the nearest slice to the farthest, all with a distance
+		for (int i = 0; !_interrupted && i < _buckets.count(); ++i)
+		{
+			d = dist[i];
+			py = y[i];
+			rad = splatRadius(d);
+			if (py + rad < first || py - rad > last)
+				continue;
+
+			px = x[i];
+			for (int r = std::max(py - rad, first); r <= std::min(py + rad, last); ++r)
+			{
+				for (int j = px - rad; j <= px + rad; ++j)
+				{
+					// wrap around the 0/360 seam without a modulo
+					float & z = zBuffer.atWrapped(r, j);
+					if (z == 0 || d < z)
+						z = d;
+				}
+			}
+		}
+	});
+
+	ParallelExecutor::parallelFor(zBuffer.tileCount(), [&](int _begin, int _end)
+	{
+		for (int i = _begin; !_interrupted && i < _end; ++i)
+		{
+			cv::Mat z = zBuffer.interior(i);
+			z.copyTo(_image.interior(i), z > 0);
+		}
+	});
+}
\ No newline at end of file
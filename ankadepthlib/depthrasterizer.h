@@ -0,0 +1,39 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include "ankadepthlibglobals.h"
+#include "projectedpoints.h"
+#include "distancebuckets.h"
+#include "occupancygrid.h"
+#include "panoramabuffer.h"
+
+namespace AnkaDepthLib
+{
+	class DepthRasterizer
+	{
+	public:
+		// legacy painter's loop: far-to-near distance slices, each closed and painted over the image. the loop in
+		// DepthTaskWorker had its while header twice and never painted the farthest slice, this one paints every slice
+		static void rasterizeSlices(const ProjectedPoints & _points, const DistanceBuckets & _buckets, PanoramaBuffer & _image, const bool & _interrupted);
+
+		// single pass z-buffer: every point is splatted once with a distance dependent footprint, nearest depth wins
+		static void rasterizeZBuffer(const ProjectedPoints & _points, const DistanceBuckets & _buckets, PanoramaBuffer & _image, const bool & _interrupted);
+
+		static inline int splatRadius(double _distance)
+		{
+			return (int)(ZBUFFER_SPLAT_FACTOR - (_distance / MAX_DISTANCE * ZBUFFER_SPLAT_FACTOR));
+		}
+
+	private:
+		DepthRasterizer();
+
+		// copy of the columns [_left, _left + _width) of an equirectangular image, wrapping around the seam
+		static cv::Mat wrappedColumns(const cv::Mat & _image, int _left, int _width);
+
+		static inline void paint(cv::Mat & _image, OccupancyGrid & _occupancy, int _row, int _col, float _distance)
+		{
+			_image.at<float>(_row, _col) = _distance;
+			_occupancy.mark(_row, _col);
+		}
+	};
+}
\ No newline at end of file
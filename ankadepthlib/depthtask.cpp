@@ -16,8 +16,9 @@ AnkaDepthLib::DepthTask::DepthTask(QSqlQuery & _query, QObject * _parent)
 	mLongtitude = _query.value("lon").toDouble();
 	mLatitude = _query.value("lat").toDouble();
 	mAltitude = _query.value("altitude").toDouble();
-	mX = _query.value("x").toDouble();
-	mY = _query.value("y").toDouble();
+	// the UTM coordinates are projected from lon and lat by the reader of the rows, see TransverseMercator
+	mX = 0;
+	mY = 0;
 	mParentDir = _query.value("parent_dir").toString();
 	mSubDir = _query.value("sub_dir").toString();
 	mFileName = _query.value("file_name").toString().split('.')[0] + ".png";
@@ -154,6 +155,41 @@ void AnkaDepthLib::DepthTask::fromString(const QString & _string)
 	mTimeStamp = sl.takeFirst();
 }
 
+void AnkaDepthLib::DepthTask::write(GridFrame::Writer & _writer) const
+{
+	_writer.writeInt32(mId);
+	_writer.writeDouble(mLongtitude);
+	_writer.writeDouble(mLatitude);
+	_writer.writeDouble(mX);
+	_writer.writeDouble(mY);
+	_writer.writeDouble(mAltitude);
+	_writer.writeDouble(mHeading);
+	_writer.writeDouble(mPitch);
+	_writer.writeDouble(mRoll);
+	_writer.writeString(mParentDir);
+	_writer.writeString(mSubDir);
+	_writer.writeString(mFileName);
+	_writer.writeString(mTimeStamp);
+}
+
+bool AnkaDepthLib::DepthTask::read(GridFrame::Reader & _reader)
+{
+	mId = _reader.readInt32();
+	mLongtitude = _reader.readDouble();
+	mLatitude = _reader.readDouble();
+	mX = _reader.readDouble();
+	mY = _reader.readDouble();
+	mAltitude = _reader.readDouble();
+	mHeading = _reader.readDouble();
+	mPitch = _reader.readDouble();
+	mRoll = _reader.readDouble();
+	mParentDir = _reader.readString();
+	mSubDir = _reader.readString();
+	mFileName = _reader.readString();
+	mTimeStamp = _reader.readString();
+	return _reader.isValid();
+}
+
 #pragma region Getters-Setters
 int AnkaDepthLib::DepthTask::id()
 {
@@ -4,6 +4,7 @@
 #include <QDataStream>
 #include <QSqlQuery>
 #include <QDateTime>
+#include "gridframe.h"
 
 namespace AnkaDepthLib
 {
@@ -27,6 +28,10 @@ namespace AnkaDepthLib
 		QString toString() const;
 		void fromString(const QString & _string);
 
+		// the fields of toString in binary, for the workers that negotiated frames; read fails on a short frame
+		void write(GridFrame::Writer & _writer) const;
+		bool read(GridFrame::Reader & _reader);
+
 #pragma region Getters-Setters
 		int id();
 		void setId(int _id);
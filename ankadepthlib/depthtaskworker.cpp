@@ -1,5 +1,10 @@
 #include "depthtaskworker.h"
 #include "dbpatchbufferer.h"
+#include "depthrasterizer.h"
+#include "holefiller.h"
+#include "groundregenerator.h"
+#include "parallelexecutor.h"
+#include "transversemercator.h"
 #include <QSqlDatabase>
 #include <QSqlQuery>
 #include <QSqlResult>
@@ -40,6 +45,7 @@ void DepthTaskWorker::run()
  	cv::TickMeter tm;
 	tm.start();
 	mStatus = DTWS_RUNNING;
+	emit started(this);
 	emit progress(this, QString("Region ID: %1 => Execution started.").arg(id()));
 
 	mOutPath = QString("%1%2/%3/").arg(mConfig->outputRootPath()).arg(mTask.parentDir()).arg(mTask.subDir());
@@ -83,18 +89,9 @@ void DepthTaskWorker::run()
 		emit error(this, QString("WARNING: Region ID: %1 => setup.ank couldn't located at path, defaults loaded. %2").arg(id()).arg(ankFile.fileName()));
 #pragma region Definitions
 	
-	cv::Mat imgIn((int)H, (int)W, CV_32FC1, cv::Scalar(0));
-	cv::Mat imgTemp((int)H, (int)W, CV_32FC1, cv::Scalar(0));
+	PanoramaBuffer imgIn;
+	PanoramaBuffer imgTemp;
 	cv::Mat imgOut((int)H, (int)W, CV_8UC3, cv::Scalar(0, 0, 0));
-	float d = 0;
-	double
-		x = 0,
-		y = 0,
-		z = 0,
-		phi = 0,
-		theta = 0,
-		phiPerPix = 180.0 / H,
-		thetaPerPix = 360.0 / W;
 #pragma endregion
 
 	// directory check
@@ -123,112 +120,76 @@ void DepthTaskWorker::run()
 		return;
 	}
 
-#pragma region Depth Image Creation
-	int slice = (MAX_DISTANCE / DISTANCE_SLICE), sz = 0;
-	while (!mInterrupted && --slice >= 0)
-	while (!mInterrupted && --slice >= 0)
-	{
-		imgTemp = 0;
-		for (LidarPointVector::iterator itp = mDistSliceMap[slice].begin(); !mInterrupted && itp != mDistSliceMap[slice].end(); ++itp)
-		{
-			d = itp->R;
-
-			if (d > 0)
-			{
-				imgTemp.at<float>(itp->get2D_Y(H), itp->get2D_X(W)) = d;
+	// the stages below split into row bands and tiles on the shared executor
+	ParallelExecutor::setParallelism(mConfig->taskParallelism());
+	ParallelExecutor::taskStarted();
 
-				sz = (int)(DISTANCED_SIZE_FACTOR - (itp->R / MAX_DISTANCE * DISTANCED_SIZE_FACTOR)) + 1;
-
-				if (itp->R < NEAR_DISTANCE_THRESHOLD && itp->get2D_Y(H) - sz >= 0 && itp->get2D_X(W) - sz >= 0)
-				{
-					imgTemp.at<float>(itp->get2D_Y(H) - sz, itp->get2D_X(W) - sz) = d;
-					imgTemp.at<float>(itp->get2D_Y(H) - sz, (itp->get2D_X(W) + sz) % (int)W) = d;
-					imgTemp.at<float>((itp->get2D_Y(H) + sz) % (int)H, itp->get2D_X(W) - sz) = d;
-					imgTemp.at<float>((itp->get2D_Y(H) + sz) % (int)H, (itp->get2D_X(W) + sz) % (int)W) = d;
-
-					sz *= 2;
-					if (itp->get2D_Y(H) - sz >= 0 && itp->get2D_X(W) - sz >= 0)
-					{
-						imgIn.at<float>(itp->get2D_Y(H) - sz, itp->get2D_X(W) - sz) = d;
-						imgIn.at<float>(itp->get2D_Y(H) - sz, (itp->get2D_X(W) + sz) % (int)W) = d;
-						imgIn.at<float>((itp->get2D_Y(H) + sz) % (int)H, itp->get2D_X(W) - sz) = d;
-						imgIn.at<float>((itp->get2D_Y(H) + sz) % (int)H, (itp->get2D_X(W) + sz) % (int)W) = d;
-					}
-				}
-			}
-		}
-
-		sz = ((int)(6.0f - (slice * DISTANCE_SLICE / MAX_DISTANCE * 6.0f)) * 2) + 1;
-		cv::morphologyEx(imgTemp, imgTemp, cv::MORPH_CLOSE, cv::Mat::ones(sz, sz, CV_32FC1), cv::Point(-1, -1), sz);
-
-		for (int r = 0; !mInterrupted && r < imgTemp.rows; ++r)
-		{
-			for (int c = 0; !mInterrupted && c < imgTemp.cols; ++c)
-			{
-				if ((d = imgTemp.at<float>(r, c)) > 0)
-					imgIn.at<float>(r, c) = d;
-			}
-		}
-	}
+#pragma region Depth Image Creation
+	if (mConfig->rasterizerMode() == DRM_ZBUFFER)
+		DepthRasterizer::rasterizeZBuffer(mPoints, mDistBuckets, imgIn, mInterrupted);
+	else
+		DepthRasterizer::rasterizeSlices(mPoints, mDistBuckets, imgIn, mInterrupted);
 #pragma endregion
 
 #pragma region Near-Ground Surface Regeneration
-	cv::Mat & rotMat = rotationMatrix(
+	GroundRegenerator::regenerate(
+		imgIn,
+		mCameraOffset,
 		180.0 + mHeadingOffset, // face to the front of the car
 		mTask.pitch() + mPitchOffset,
-		mTask.roll() + mRollOffset
+		mTask.roll() + mRollOffset,
+		mConfig->groundPoseQuantum(),
+		mInterrupted
 	);
-	double phiInv = 0;
-	for (y = H - 1.0; !mInterrupted && y > H / 2.0; y--)
-	{
-		phiInv = deg2rad(180.0 - y * phiPerPix);
-		d = mCameraOffset / cos(phiInv);
-		phi = deg2rad(y * phiPerPix);
-
-		for (x = 0; !mInterrupted && x < W; x++)
-		{
-			theta = deg2rad(x * thetaPerPix);
-
-			if (y * phiPerPix > (GROUND_ASSERTION_MIN_ANGLE + abs(cos(theta)) * VISION_CURVE))
-			{
-				cv::Mat rotated = rotMat * (
-					cv::Mat_<double>(3, 1) <<
-					mCameraOffset / cos(phiInv) * sin(phi) * cos(theta),
-					mCameraOffset / cos(phiInv) * sin(phi) * sin(theta),
-					mCameraOffset / cos(phiInv) * cos(phi)
-					);
-
-				LidarPoint p(
-					rotated.at<double>(0) + mLPCenter.X,
-					rotated.at<double>(1) + mLPCenter.Y,
-					rotated.at<double>(2) + mLPCenter.Z
-				);
-				p.faceTo(mLPCenter); // no heading here
-
-				imgIn.at<float>(p.get2D_Y(H), p.get2D_X(W)) = d;
-			}
-		}
-	}
 #pragma endregion
 
 #pragma region Post Filtering
 	holeFilter(imgIn);
 
-	cv::medianBlur(imgIn, imgIn, 3);
-
-	imgTemp = 0;
-	cv::bilateralFilter(imgIn, imgTemp, 50, 1, 25);
+	// tile by tile: the halo holds every neighbour the kernels read for the tile's interior, so each filter runs on the
+	// interior grown by its radius only; isolated borders keep OpenCV from reading the rest of the tile
+	int bilateralRadius = 25;
+	imgIn.syncHalo();
+	ParallelExecutor::parallelFor(imgIn.tileCount(), [&](int _begin, int _end)
+	{
+		cv::Mat tileTemp;
+		for (int i = _begin; !mInterrupted && i < _end; ++i)
+		{
+			cv::medianBlur(imgIn.window(i, 1), tileTemp, 3);
+			tileTemp(cv::Rect(1, 1, imgIn.tileSize(), imgIn.tileSize())).copyTo(imgTemp.interior(i));
+		}
+	});
 
-	for (int r = 0; !mInterrupted && r < imgTemp.rows; ++r)
+	imgTemp.syncHalo();
+	ParallelExecutor::parallelFor(imgTemp.tileCount(), [&](int _begin, int _end)
 	{
-		for (int c = 0; !mInterrupted && c < imgTemp.cols; ++c)
+		cv::Mat tileTemp;
+		float d = 0;
+		for (int i = _begin; !mInterrupted && i < _end; ++i)
 		{
-			if ((d = imgTemp.at<float>(r, c)) > 0)
-				imgOut.at<cv::Vec3b>(r, c) = dist2pix(d);
+			cv::Mat window = imgTemp.window(i, bilateralRadius);
+			if (cv::countNonZero(window) == 0)
+				continue;
+
+			cv::bilateralFilter(window, tileTemp, 2 * bilateralRadius, 1, bilateralRadius, cv::BORDER_DEFAULT | cv::BORDER_ISOLATED);
+
+			cv::Rect rect = imgTemp.tileRect(i);
+			for (int r = 0; r < rect.height; ++r)
+			{
+				const float * src = tileTemp.ptr<float>(r + bilateralRadius) + bilateralRadius;
+				cv::Vec3b * dst = imgOut.ptr<cv::Vec3b>(rect.y + r) + rect.x;
+				for (int c = 0; c < rect.width; ++c)
+				{
+					if ((d = src[c]) > 0)
+						dst[c] = dist2pix(d);
+				}
+			}
 		}
-	}
+	});
 #pragma endregion
 
+	ParallelExecutor::taskFinished();
+
 	// interruption check
 	if (mInterrupted)
 	{
@@ -281,77 +242,59 @@ bool DepthTaskWorker::loadPoints()
 	bool res = false;
 
 	QVector<int> patchIds;
-	// db scope
+	QString message;
+	bool listed = DBPatchBufferer::candidatePatches(mTask.longtitude(), mTask.latitude(), mTask.timeStamp(), mConfig->patchLimit(), patchIds, &message);
+	if (!listed)
 	{
-		QSqlDatabase db = QSqlDatabase::addDatabase("QPSQL", QString("db_dtw_%1").arg(id()));
-		db.setHostName(mConfig->pcDatabaseIp());
-		db.setPort(mConfig->pcDatabasePort());
-		db.setDatabaseName(mConfig->pcDatabaseName());
-		db.setUserName(mConfig->pcDatabaseUserName());
-		db.setPassword(mConfig->pcDatabasePassword());
-		db.setConnectOptions(mConfig->pcDatabaseOptions());
-
-		if (db.open())
-		{
-			QString qStr = QString("\
-			WITH patches AS\
-			(\
-				SELECT\
-				((PC_PatchMax(pa, 'gpstime') + PC_PatchMin(pa, 'gpstime')) / 2.0) / 1000000 as patch_time_avg,\
-				(SELECT regexp_matches(filename, '(20[0-9]{2}.[0-9]{2}.[0-9]{2})', 'g'))[1] as patch_date,\
-				*\
-				FROM pc_table\
-				WHERE PC_Intersects(ST_Transform(ST_Buffer(ST_Transform(ST_GeomFromText('Point(%1 %2)', 4326), 32635), %3), 4326), pa)\
-				)\
-			SELECT\
-			id\
-			FROM patches\
-			WHERE ABS(\
-				(date_part('epoch', to_timestamp(patch_date, 'YYYY-MM-DD')) + patch_time_avg) -\
-				(date_part('epoch', to_timestamp('%4', 'YYYY-MM-DD HH24:MI:SS.FF')))\
-			) < 50\
-			ORDER BY id\
-			LIMIT %5\
-			").arg(mTask.longtitude()).arg(mTask.latitude()).arg((int)MAX_DISTANCE).arg(mTask.timeStamp()).arg(mConfig->patchLimit());
-
-			QSqlQuery query(db);
-			query.setForwardOnly(true);
-			if (query.exec(qStr))
-			{
-				while (!mInterrupted && query.next())
-					patchIds.push_back(query.value(0).toInt());
+		mStatus = DTWS_ERROR_STATE;
+		emit error(this, QString("Region ID: %1 => %2").arg(id()).arg(message));
+	}
 
-				if (!(res = patchIds.count() >= mConfig->patchThreshold()))
-				{
-					mStatus = DTWS_ERROR_STATE;
-					emit error(this, QString("Region ID: %1 => Not enough patches to process! Retrieved patch count:%2 < threshold:%3").arg(id()).arg(patchIds.count()).arg(patchIds.count()));
-				}
-			}
-			else
-			{
-				mStatus = DTWS_ERROR_STATE;
-				emit error(this, QString("Region ID: %1 => Point cloud database error: %2").arg(id()).arg(db.lastError().text()));
-			}
-		}
-		else
-		{
-			mStatus = DTWS_ERROR_STATE;
-			emit error(this, QString("Region ID: %1 => Point cloud database connection error: %2").arg(id()).arg(db.lastError().text()));
-		}
+	if (listed && !(res = patchIds.count() >= mConfig->patchThreshold()))
+	{
+		mStatus = DTWS_ERROR_STATE;
+		emit error(this, QString("Region ID: %1 => Not enough patches to process! Retrieved patch count:%2 < threshold:%3").arg(id()).arg(patchIds.count()).arg(patchIds.count()));
 	}
-	QSqlDatabase::removeDatabase(QString("db_dtw_%1").arg(id()));
 
 	if (!mInterrupted && res)
 	{
-		LidarPointVector lpv;
-		if (res = DBPatchBufferer::loadPatches(patchIds, QString::number(mTask.longtitude(), 'f', 12), QString::number(mTask.latitude(), 'f', 12), &lpv))
+		// in the filtered mode only the points within range and time of the task cross the wire
+		PatchFilter filter;
+		if (mConfig->patchFetchMode() == PFM_FILTERED)
 		{
-			for (LidarPointVector::iterator it = lpv.begin(); !mInterrupted && it != lpv.end(); ++it)
-			{
-				LidarPoint & p = *it;
-				p.faceTo(mLPCenter, mTask.heading());
-				mDistSliceMap[p.R / DISTANCE_SLICE].push_back(p);
-			}
+			filter = PatchFilter(mTask.longtitude(), mTask.latitude(), mTask.timeStamp());
+			if (filter.isNull())
+				emit error(this, QString("WARNING: Region ID: %1 => Unknown time stamp format, patches are fetched unfiltered. %2").arg(id()).arg(mTask.timeStamp()));
+		}
+
+		PointBlockVector blocks;
+		PatchFetchStatistics stats;
+		DBPatchBufferer::addFocus(mTask.x(), mTask.y());
+		if (res = DBPatchBufferer::loadPatches(patchIds, filter, &blocks, &stats))
+		{
+			if (!filter.isNull())
+				emit progress(this, QString("Region ID: %1 => Patches fetched: %2, cached: %3, shared: %4, from disk: %5, rows: %6, culled by the filter: %7 rows, %8 KB")
+					.arg(id())
+					.arg(stats.patches)
+					.arg(stats.cachedPatches)
+					.arg(stats.sharedPatches)
+					.arg(stats.diskPatches)
+					.arg(stats.rows)
+					.arg(stats.culledRows)
+					.arg(stats.culledBytes() / 1024));
+
+			int count = 0;
+			for (PointBlockVector::iterator it = blocks.begin(); it != blocks.end(); ++it)
+				count += it->count();
+
+			mPoints.clear();
+			mPoints.reserve(count);
+			for (PointBlockVector::iterator it = blocks.begin(); !mInterrupted && it != blocks.end(); ++it)
+				mPoints.append(*it, mLPCenter, mTask.heading());
+
+			// slices beyond MAX_DISTANCE are never painted
+			if (!mInterrupted)
+				mDistBuckets.build(mPoints, DISTANCE_SLICE, (int)(MAX_DISTANCE / DISTANCE_SLICE));
 		}
 		else
 		{
@@ -362,14 +305,7 @@ bool DepthTaskWorker::loadPoints()
 	return res;
 }
 
-void DepthTaskWorker::holeFilter(cv::Mat & _image)
+void DepthTaskWorker::holeFilter(PanoramaBuffer & _image)
 {
-	for (int r = 100.0 * H / 180.0; !mInterrupted && r < _image.rows; r++)
-	{
-		for (int c = 0; !mInterrupted && c < _image.cols; c++)
-		{
-			if(_image.at<float>(r, c) == 0)
-				_image.at<float>(r, c) = averageDistance(_image, r, c, 4);
-		}
-	}
+	HoleFiller::fill(_image, 100.0 * H / 180.0, 4, mConfig->holeFillMode(), mInterrupted);
 }
\ No newline at end of file
@@ -5,6 +5,9 @@
 #include "ankadepthlibglobals.h"
 #include "depthconfiguration.h"
 #include "depthtask.h"
+#include "panoramabuffer.h"
+#include "projectedpoints.h"
+#include "distancebuckets.h"
 
 namespace AnkaDepthLib
 {
@@ -24,15 +27,15 @@ namespace AnkaDepthLib
 
 	private:
 		bool loadPoints();
-		void holeFilter(cv::Mat & _image);
+		void holeFilter(PanoramaBuffer & _image);
 
 		bool mInterrupted;
 		DepthTaskWorkerStatus mStatus;
 		DepthConfiguration * mConfig;
 		DepthTask mTask;
 		LidarPoint mLPCenter;
-		LidarPointVector mPoints;
-		LidarPointDistSliceMap mDistSliceMap;
+		ProjectedPoints mPoints;
+		DistanceBuckets mDistBuckets;
 		QString mOutPath;
 		double mCameraOffset;
 		double mHeadingOffset;
@@ -41,6 +44,7 @@ namespace AnkaDepthLib
 
 #pragma region Signals-Slots
 	signals:
+		void started(DepthTaskWorker * _taskWorker);
 		void finished(DepthTaskWorker * _taskWorker);
 		void progress(DepthTaskWorker * _taskWorker, QString _message);
 		void error(DepthTaskWorker * _taskWorker, QString _error);
@@ -0,0 +1,58 @@
+#include "distancebuckets.h"
+
+using namespace AnkaDepthLib;
+
+DistanceBuckets::DistanceBuckets()
+{
+	clear();
+}
+
+void DistanceBuckets::build(ProjectedPoints & _points, float _sliceWidth, int _slices)
+{
+	int n = _points.count(), s = 0;
+	const float * r = _points.r();
+
+	// first pass: the slice of every point, -1 for dropped ones, and the histogram
+	QVector<int> targets(n);
+	QVector<int> counts(_slices + 1, 0);
+	for (int i = 0; i < n; ++i)
+	{
+		s = r[i] > 0 ? (int)(r[i] / _sliceWidth) : -1;
+		if (s >= _slices)
+			s = -1;
+		targets[i] = s;
+		if (s >= 0)
+			++counts[s + 1];
+	}
+
+	// prefix sum into the slice offsets
+	mOffsets.resize(_slices + 1);
+	mOffsets[0] = 0;
+	for (s = 0; s < _slices; ++s)
+		mOffsets[s + 1] = mOffsets[s] + counts[s + 1];
+
+	// second pass: the slice becomes the target position, taken in index order so slices keep the loading order
+	QVector<int> next(mOffsets);
+	for (int i = 0; i < n; ++i)
+	{
+		if (targets[i] >= 0)
+			targets[i] = next[targets[i]]++;
+	}
+
+	_points.permute(targets.constData(), mOffsets[_slices]);
+}
+
+void DistanceBuckets::clear()
+{
+	mOffsets.fill(0, 1);
+}
+
+int DistanceBuckets::sliceCount() const
+{
+	return mOffsets.count() - 1;
+}
+
+int DistanceBuckets::count() const
+{
+	return mOffsets.last();
+}
\ No newline at end of file
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <QVector>
+#include "projectedpoints.h"
+
+namespace AnkaDepthLib
+{
+	// distance slices of a ProjectedPoints as ranges of one flat array: a histogram and a prefix sum reorder the points
+	// by slice in two passes, keeping their order within a slice, so a slice is read as a contiguous run of points
+	class DistanceBuckets
+	{
+	public:
+		DistanceBuckets();
+
+		// reorders _points by the slice (int)(r / _sliceWidth); points without a distance or beyond the last of
+		// _slices slices are dropped from _points in the same pass
+		void build(ProjectedPoints & _points, float _sliceWidth, int _slices);
+		void clear();
+
+		int sliceCount() const;
+		int count() const;
+
+		// the points of a slice are [begin(_slice), end(_slice)) of the reordered ProjectedPoints
+		inline int begin(int _slice) const { return mOffsets[_slice]; }
+		inline int end(int _slice) const { return mOffsets[_slice + 1]; }
+		inline bool isEmpty(int _slice) const { return mOffsets[_slice] == mOffsets[_slice + 1]; }
+
+	private:
+		QVector<int> mOffsets;
+	};
+}
\ No newline at end of file
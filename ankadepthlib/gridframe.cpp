@@ -0,0 +1,139 @@
+#include "gridframe.h"
+#include <QtEndian>
+#include <cstring>
+
+using namespace AnkaDepthLib;
+
+#pragma region Writer
+GridFrame::Writer::Writer(Type _type)
+{
+	// the payload length is filled in by frame()
+	mBuffer.resize(HeaderSize);
+	char * header = mBuffer.data();
+	qToLittleEndian<quint16>(Magic, header);
+	header[2] = (char)Version;
+	header[3] = (char)_type;
+	qToLittleEndian<quint32>(0, header + 4);
+}
+
+void GridFrame::Writer::writeInt32(qint32 _value)
+{
+	char bytes[4];
+	qToLittleEndian<qint32>(_value, bytes);
+	write(bytes, 4);
+}
+
+void GridFrame::Writer::writeDouble(double _value)
+{
+	quint64 bits = 0;
+	memcpy(&bits, &_value, sizeof(bits));
+	char bytes[8];
+	qToLittleEndian<quint64>(bits, bytes);
+	write(bytes, 8);
+}
+
+void GridFrame::Writer::writeString(const QString & _value)
+{
+	QByteArray utf8 = _value.toUtf8();
+	writeInt32(utf8.size());
+	write(utf8.constData(), utf8.size());
+}
+
+QByteArray GridFrame::Writer::frame()
+{
+	qToLittleEndian<quint32>((quint32)(mBuffer.size() - HeaderSize), mBuffer.data() + 4);
+	return mBuffer;
+}
+
+void GridFrame::Writer::write(const void * _data, int _size)
+{
+	mBuffer.append(static_cast<const char *>(_data), _size);
+}
+#pragma endregion
+
+#pragma region Reader
+GridFrame::Reader::Reader(const QByteArray & _frame, Type _type)
+	:
+	mFrame(_frame),
+	mPos(nullptr),
+	mEnd(nullptr),
+	mValid(false)
+{
+	if (mFrame.size() < HeaderSize)
+		return;
+
+	const char * header = mFrame.constData();
+	mValid =
+		qFromLittleEndian<quint16>(header) == Magic &&
+		(quint8)header[2] == Version &&
+		(quint8)header[3] == _type &&
+		qFromLittleEndian<quint32>(header + 4) == (quint32)(mFrame.size() - HeaderSize);
+	mPos = header + HeaderSize;
+	mEnd = header + mFrame.size();
+}
+
+bool GridFrame::Reader::isValid() const
+{
+	return mValid;
+}
+
+bool GridFrame::Reader::atEnd() const
+{
+	return !mValid || mPos == mEnd;
+}
+
+qint32 GridFrame::Reader::readInt32()
+{
+	const char * p = take(4);
+	return p ? qFromLittleEndian<qint32>(p) : 0;
+}
+
+double GridFrame::Reader::readDouble()
+{
+	const char * p = take(8);
+	if (!p)
+		return 0;
+
+	quint64 bits = qFromLittleEndian<quint64>(p);
+	double res = 0;
+	memcpy(&res, &bits, sizeof(res));
+	return res;
+}
+
+QString GridFrame::Reader::readString()
+{
+	qint32 size = readInt32();
+	const char * p = size >= 0 ? take(size) : nullptr;
+	if (!p)
+	{
+		mValid = false;
+		return QString();
+	}
+
+	return QString::fromUtf8(p, size);
+}
+
+const char * GridFrame::Reader::take(int _size)
+{
+	if (!mValid || mEnd - mPos < _size)
+	{
+		mValid = false;
+		return nullptr;
+	}
+
+	const char * res = mPos;
+	mPos += _size;
+	return res;
+}
+#pragma endregion
+
+QString GridFrame::toArgument(const QByteArray & _frame)
+{
+	// base64url without padding keeps clear of the command separators
+	return QString::fromLatin1(_frame.toBase64(QByteArray::Base64UrlEncoding | QByteArray::OmitTrailingEquals));
+}
+
+QByteArray GridFrame::fromArgument(const QString & _argument)
+{
+	return QByteArray::fromBase64(_argument.toLatin1(), QByteArray::Base64UrlEncoding | QByteArray::OmitTrailingEquals);
+}
\ No newline at end of file
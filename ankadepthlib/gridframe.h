@@ -0,0 +1,69 @@
+#pragma once
+
+#include <QString>
+#include <QByteArray>
+
+namespace AnkaDepthLib
+{
+	// versioned, length prefixed binary encoding of the per task grid messages: an 8 byte header (magic, version,
+	// type, payload length) and little endian fields, strings as a length and their UTF-8 bytes. the grid moves text
+	// lines, a frame travels as one base64url argument of a command and is read in place from the decoded bytes
+	class GridFrame
+	{
+	public:
+		static constexpr quint16 Magic = 0x4647; // "GF"
+		static constexpr quint8 Version = 1;
+
+		enum Type
+		{
+			GFT_TASKS = 1,		// a count, then that many DepthTasks
+			GFT_RESULTS = 2		// a count, then that many status and task id pairs
+		};
+
+		class Writer
+		{
+		public:
+			Writer(Type _type);
+
+			void writeInt32(qint32 _value);
+			void writeDouble(double _value);
+			void writeString(const QString & _value);
+
+			// the frame with its header filled in
+			QByteArray frame();
+
+		private:
+			void write(const void * _data, int _size);
+
+			QByteArray mBuffer;
+		};
+
+		class Reader
+		{
+		public:
+			// invalid unless _frame carries a whole frame of _type in this version
+			Reader(const QByteArray & _frame, Type _type);
+
+			bool isValid() const;
+			bool atEnd() const;
+
+			// reading past the payload makes the reader invalid and returns zeros and empty strings
+			qint32 readInt32();
+			double readDouble();
+			QString readString();
+
+		private:
+			const char * take(int _size);
+
+			QByteArray mFrame;
+			const char * mPos;
+			const char * mEnd;
+			bool mValid;
+		};
+
+		static QString toArgument(const QByteArray & _frame);
+		static QByteArray fromArgument(const QString & _argument);
+
+		static const int HeaderSize = 8;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,271 @@
+#include "groundregenerator.h"
+#include "parallelexecutor.h"
+#include <opencv2/core/hal/intrin.hpp>
+#include <cstring>
+
+using namespace AnkaDepthLib;
+
+QList<QSharedPointer<GroundRegenerator::RayTable>> GroundRegenerator::mRayTables;
+QList<GroundRegenerator::GroundMap> GroundRegenerator::mGroundMaps;
+QReadWriteLock GroundRegenerator::mRWLock;
+
+GroundRegenerator::GroundRegenerator()
+{
+}
+
+void GroundRegenerator::regenerate(PanoramaBuffer & _image, double _cameraHeight, double _heading, double _pitch, double _roll, double _angleQuantum, const bool & _interrupted)
+{
+	double pose[4] = { _cameraHeight, _heading, _pitch, _roll };
+	if (_angleQuantum > 0)
+	{
+		pose[0] = cvRound(pose[0] / GROUND_HEIGHT_QUANTUM) * GROUND_HEIGHT_QUANTUM;
+		for (int i = 1; i < 4; ++i)
+			pose[i] = cvRound(pose[i] / _angleQuantum) * _angleQuantum;
+	}
+
+	GroundMap map;
+	bool found = false;
+
+	mRWLock.lockForWrite();
+	for (int i = 0; !found && i < mGroundMaps.count(); ++i)
+	{
+		const GroundMap & m = mGroundMaps[i];
+		if (m.rows == _image.rows() && m.cols == _image.cols()
+			&& m.pose[0] == pose[0] && m.pose[1] == pose[1] && m.pose[2] == pose[2] && m.pose[3] == pose[3])
+		{
+			found = true;
+			map = m;
+			mGroundMaps.move(i, 0);
+		}
+	}
+	mRWLock.unlock();
+
+	if (!found)
+	{
+		if (!compute(*rayTable(_image.rows(), _image.cols()), pose, map, _interrupted))
+			return;
+
+		mRWLock.lockForWrite();
+		mGroundMaps.prepend(map);
+		while (mGroundMaps.count() > GROUND_CACHE_SIZE)
+			mGroundMaps.removeLast();
+		mRWLock.unlock();
+	}
+
+	ParallelExecutor::parallelFor(map.depth.rows, [&](int _begin, int _end)
+	{
+		float d = 0;
+		for (int r = _begin; !_interrupted && r < _end; ++r)
+		{
+			const float * src = map.depth.ptr<float>(r);
+			for (int tc = 0; tc < _image.tileCols(); ++tc)
+			{
+				float * dst = _image.row(map.top + r, tc);
+				for (int c = 0; c < _image.tileSize(); ++c)
+				{
+					if ((d = src[c]) > 0)
+						dst[c] = d;
+				}
+				src += _image.tileSize();
+			}
+		}
+	}, 16);
+}
+
+void GroundRegenerator::clearCache()
+{
+	mRWLock.lockForWrite();
+	mGroundMaps.clear();
+	mRWLock.unlock();
+}
+
+QSharedPointer<GroundRegenerator::RayTable> GroundRegenerator::rayTable(int _rows, int _cols)
+{
+	mRWLock.lockForRead();
+	for (int i = 0; i < mRayTables.count(); ++i)
+	{
+		if (mRayTables[i]->rows == _rows && mRayTables[i]->cols == _cols)
+		{
+			QSharedPointer<RayTable> res = mRayTables[i];
+			mRWLock.unlock();
+			return res;
+		}
+	}
+	mRWLock.unlock();
+
+	// same expressions as the original per-pixel loop so the rays are bit identical
+	QSharedPointer<RayTable> rays(new RayTable());
+	double
+		phiPerPix = 180.0 / _rows,
+		thetaPerPix = 360.0 / _cols,
+		theta = 0;
+
+	rays->rows = _rows;
+	rays->cols = _cols;
+	rays->angle.resize(_rows);
+	rays->sinPhi.resize(_rows);
+	rays->cosPhi.resize(_rows);
+	rays->cosPhiInv.resize(_rows);
+	for (int y = 0; y < _rows; ++y)
+	{
+		rays->angle[y] = y * phiPerPix;
+		rays->sinPhi[y] = sin(deg2rad(y * phiPerPix));
+		rays->cosPhi[y] = cos(deg2rad(y * phiPerPix));
+		rays->cosPhiInv[y] = cos(deg2rad(180.0 - y * phiPerPix));
+	}
+
+	rays->cosTheta.resize(_cols);
+	rays->sinTheta.resize(_cols);
+	rays->threshold.resize(_cols);
+	for (int x = 0; x < _cols; ++x)
+	{
+		theta = deg2rad(x * thetaPerPix);
+		rays->cosTheta[x] = cos(theta);
+		rays->sinTheta[x] = sin(theta);
+		rays->threshold[x] = GROUND_ASSERTION_MIN_ANGLE + std::abs(cos(theta)) * VISION_CURVE;
+	}
+
+	mRWLock.lockForWrite();
+	mRayTables.append(rays);
+	mRWLock.unlock();
+
+	return rays;
+}
+
+bool GroundRegenerator::compute(const RayTable & _rays, const double * _pose, GroundMap & _map, const bool & _interrupted)
+{
+	const cv::Matx33d rot = rotationMatrix(_pose[1], _pose[2], _pose[3]);
+	int
+		rows = _rays.rows,
+		cols = _rays.cols,
+		top = rows,
+		bottom = -1,
+		lastRow = rows - 1,
+		firstRow = lastRow;
+
+	// rows looking at the ground at all, the original loop runs from the bottom up to the horizon
+	while (firstRow - 1 > rows / 2.0 && _rays.angle[firstRow - 1] > GROUND_ASSERTION_MIN_ANGLE)
+		--firstRow;
+	if (_rays.angle[lastRow] <= GROUND_ASSERTION_MIN_ANGLE)
+		firstRow = rows;
+
+	// target pixel of every ray (-1 where the ray is not traced), computed row by row in parallel
+	cv::Mat targets(std::max(rows - firstRow, 0), cols, CV_32SC1);
+	ParallelExecutor::parallelFor(targets.rows, [&](int _begin, int _end)
+	{
+		const double
+			* cosTheta = _rays.cosTheta.constData(),
+			* sinTheta = _rays.sinTheta.constData(),
+			* threshold = _rays.threshold.constData();
+		double
+			a = 0,
+			b = 0,
+			d = 0,
+			x = 0,
+			y = 0,
+			z = 0,
+			theta = 0,
+			phi = 0;
+		cv::AutoBuffer<double> buffer(3 * cols);
+		double
+			* rx = buffer.data(),
+			* ry = rx + cols,
+			* rz = ry + cols;
+
+		for (int i = _begin; !_interrupted && i < _end; ++i)
+		{
+			int r = firstRow + i;
+			int * target = targets.ptr<int>(i);
+
+			// ray of every pixel in the row scaled to the ground, then rotated by the pose
+			d = _pose[0] / _rays.cosPhiInv[r];
+			a = d * _rays.sinPhi[r];
+			b = d * _rays.cosPhi[r];
+
+			double
+				bx = rot(0, 2) * b,
+				by = rot(1, 2) * b,
+				bz = rot(2, 2) * b;
+			int c = 0;
+#if CV_SIMD128_64F
+			cv::v_float64x2
+				va = cv::v_setall_f64(a),
+				r00 = cv::v_setall_f64(rot(0, 0)), r01 = cv::v_setall_f64(rot(0, 1)), vbx = cv::v_setall_f64(bx),
+				r10 = cv::v_setall_f64(rot(1, 0)), r11 = cv::v_setall_f64(rot(1, 1)), vby = cv::v_setall_f64(by),
+				r20 = cv::v_setall_f64(rot(2, 0)), r21 = cv::v_setall_f64(rot(2, 1)), vbz = cv::v_setall_f64(bz);
+			for (; c <= cols - 2; c += 2)
+			{
+				cv::v_float64x2
+					v0 = va * cv::v_load(cosTheta + c),
+					v1 = va * cv::v_load(sinTheta + c);
+				cv::v_store(rx + c, r00 * v0 + r01 * v1 + vbx);
+				cv::v_store(ry + c, r10 * v0 + r11 * v1 + vby);
+				cv::v_store(rz + c, r20 * v0 + r21 * v1 + vbz);
+			}
+#endif
+			for (; c < cols; ++c)
+			{
+				double
+					v0 = a * cosTheta[c],
+					v1 = a * sinTheta[c];
+				rx[c] = rot(0, 0) * v0 + rot(0, 1) * v1 + bx;
+				ry[c] = rot(1, 0) * v0 + rot(1, 1) * v1 + by;
+				rz[c] = rot(2, 0) * v0 + rot(2, 1) * v1 + bz;
+			}
+
+			// reprojection exactly as LidarPoint::faceTo and get2D_X/Y
+			for (c = 0; c < cols; ++c)
+			{
+				if (_rays.angle[r] <= threshold[c])
+				{
+					target[c] = -1;
+					continue;
+				}
+
+				x = rx[c];
+				y = ry[c];
+				z = rz[c];
+
+				theta = (360.0 - rad2deg(atan2(y, x))) + (360.0 - 90.0);
+				if (theta < 0.0)
+					theta += 360.0;
+				theta = fmod(theta, 360.0);
+
+				phi = rad2deg(atan2(sqrt((x * x) + (y * y)), z));
+				if (phi < 0.0)
+					phi += 180.0;
+				phi = fmod(phi, 180.0);
+
+				target[c] = (int)(rows * phi / 180.0) * cols + (int)(cols * theta / 360.0);
+			}
+		}
+	}, 8);
+
+	if (_interrupted)
+		return false;
+
+	// written in the original order, bottom row first, so overlapping rays keep the same winner
+	cv::Mat full(rows, cols, CV_32FC1, cv::Scalar(0));
+	float * dst = full.ptr<float>();
+	for (int i = targets.rows - 1; i >= 0; --i)
+	{
+		float d = _pose[0] / _rays.cosPhiInv[firstRow + i];
+		const int * target = targets.ptr<int>(i);
+		for (int c = 0; c < cols; ++c)
+		{
+			if (target[c] < 0)
+				continue;
+
+			dst[target[c]] = d;
+			top = std::min(top, target[c] / cols);
+			bottom = std::max(bottom, target[c] / cols);
+		}
+	}
+
+	_map.rows = rows;
+	_map.cols = cols;
+	memcpy(_map.pose, _pose, sizeof(_map.pose));
+	_map.top = bottom < top ? 0 : top;
+	_map.depth = bottom < top ? cv::Mat(0, cols, CV_32FC1) : full.rowRange(top, bottom + 1).clone();
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <QList>
+#include <QVector>
+#include <QReadWriteLock>
+#include <QSharedPointer>
+#include <opencv2/opencv.hpp>
+#include "ankadepthlibglobals.h"
+#include "panoramabuffer.h"
+
+namespace AnkaDepthLib
+{
+	// near-ground surface regeneration: every pixel looking at the ground below GROUND_ASSERTION_MIN_ANGLE is traced to a
+	// flat ground _cameraHeight below the camera, rotated by the camera pose and reprojected into the panorama
+	class GroundRegenerator
+	{
+	public:
+		// writes the ground of the pose into _image in the order of the original per-pixel loop (bottom row first); with
+		// _angleQuantum > 0 the angles are rounded to multiples of it (degrees) and the height to GROUND_HEIGHT_QUANTUM
+		// so consecutive frames with nearly the same pose reuse a cached ground map
+		static void regenerate(PanoramaBuffer & _image, double _cameraHeight, double _heading, double _pitch, double _roll, double _angleQuantum, const bool & _interrupted);
+
+		static void clearCache();
+
+	private:
+		GroundRegenerator();
+
+		// trigonometry of the pixel rays of one panorama resolution, per row and per column
+		class RayTable
+		{
+		public:
+			int rows;
+			int cols;
+			QVector<double> angle;
+			QVector<double> sinPhi;
+			QVector<double> cosPhi;
+			QVector<double> cosPhiInv;
+			QVector<double> cosTheta;
+			QVector<double> sinTheta;
+			QVector<double> threshold;
+		};
+
+		// depths written for a pose in the rows [top, top + depth.rows), 0 where the ground is not seen
+		class GroundMap
+		{
+		public:
+			int rows;
+			int cols;
+			double pose[4];
+			int top;
+			cv::Mat depth;
+		};
+
+		static QSharedPointer<RayTable> rayTable(int _rows, int _cols);
+		static bool compute(const RayTable & _rays, const double * _pose, GroundMap & _map, const bool & _interrupted);
+
+		static QList<QSharedPointer<RayTable>> mRayTables;
+		static QList<GroundMap> mGroundMaps;
+		static QReadWriteLock mRWLock;
+	};
+}
\ No newline at end of file
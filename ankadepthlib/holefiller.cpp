@@ -0,0 +1,167 @@
+#include "holefiller.h"
+#include "parallelexecutor.h"
+#include <cstring>
+
+using namespace AnkaDepthLib;
+
+HoleFiller::HoleFiller()
+{
+}
+
+void HoleFiller::fill(PanoramaBuffer & _image, int _firstRow, int _size, HoleFillMode _mode, const bool & _interrupted)
+{
+	if (_mode == HFM_SUMMED_AREA)
+		fillSummedArea(_image, _firstRow, _size, _interrupted);
+	else
+		fillScan(_image, _firstRow, _size, _interrupted);
+}
+
+void HoleFiller::fillScan(PanoramaBuffer & _image, int _firstRow, int _size, const bool & _interrupted)
+{
+	int
+		radius = _size / 2,
+		cols = _image.cols(),
+		tileSize = _image.tileSize();
+
+	cv::AutoBuffer<double> sums(cols + 2 * radius);
+	cv::AutoBuffer<int> counts(cols + 2 * radius);
+	memset(sums.data(), 0, (cols + 2 * radius) * sizeof(double));
+	memset(counts.data(), 0, (cols + 2 * radius) * sizeof(int));
+
+	for (int r = _firstRow - radius; r < _firstRow + radius; ++r)
+		accumulateRow(_image, r, 1, radius, sums.data(), counts.data());
+
+	for (int r = _firstRow; !_interrupted && r < _image.rows(); ++r)
+	{
+		accumulateRow(_image, r + radius, 1, radius, sums.data(), counts.data());
+		wrapColumns(cols, radius, sums.data(), counts.data());
+
+		for (int tc = 0; tc < _image.tileCols(); ++tc)
+		{
+			float * p = _image.row(r, tc);
+			for (int c = 0, x = tc * tileSize; c < tileSize; ++c, ++x)
+			{
+				if (p[c] != 0)
+					continue;
+
+				// the window of panorama column x starts at x in the padded sums
+				double sum = 0;
+				int count = 0;
+				for (int k = x; k <= x + 2 * radius; ++k)
+				{
+					sum += sums[k];
+					count += counts[k];
+				}
+
+				if (count > 0)
+				{
+					p[c] = (float)(sum / (double)count);
+
+					// the filled pixel is a neighbour of the ones after it, on both sides of the seam
+					sums[x + radius] += p[c];
+					++counts[x + radius];
+					if (x < radius)
+					{
+						sums[x + radius + cols] += p[c];
+						++counts[x + radius + cols];
+					}
+					else if (x >= cols - radius)
+					{
+						sums[x + radius - cols] += p[c];
+						++counts[x + radius - cols];
+					}
+				}
+			}
+		}
+
+		accumulateRow(_image, r - radius, -1, radius, sums.data(), counts.data());
+	}
+}
+
+void HoleFiller::fillSummedArea(PanoramaBuffer & _image, int _firstRow, int _size, const bool & _interrupted)
+{
+	int radius = _size / 2;
+	CV_Assert(radius <= _image.halo());
+
+	_image.syncHalo();
+	ParallelExecutor::parallelFor(_image.tileCount(), [&](int _begin, int _end)
+	{
+		cv::Mat tile, mask, sum, count;
+		for (int i = _begin; !_interrupted && i < _end; ++i)
+		{
+			cv::Rect rect = _image.tileRect(i);
+			if (rect.y + rect.height <= _firstRow)
+				continue;
+
+			// empty pixels add nothing to the sums, the mask counts the others (as 255 each)
+			tile = _image.tile(i);
+			mask = tile > 0;
+			cv::integral(mask, count, CV_32S);
+			if (count.at<int>(count.rows - 1, count.cols - 1) == 0)
+				continue;
+			cv::integral(tile, sum, CV_64F);
+
+			int h = _image.halo();
+			for (int r = std::max(_firstRow - rect.y, 0); r < rect.height; ++r)
+			{
+				int
+					y0 = r + h - radius,
+					y1 = r + h + radius + 1;
+				float * p = tile.ptr<float>(r + h) + h;
+				const double
+					* s0 = sum.ptr<double>(y0),
+					* s1 = sum.ptr<double>(y1);
+				const int
+					* n0 = count.ptr<int>(y0),
+					* n1 = count.ptr<int>(y1);
+
+				for (int c = 0; c < rect.width; ++c)
+				{
+					if (p[c] != 0)
+						continue;
+
+					int
+						x0 = c + h - radius,
+						x1 = c + h + radius + 1,
+						n = (n1[x1] - n0[x1] - n1[x0] + n0[x0]) / 255;
+
+					if (n > 0)
+						p[c] = (float)((s1[x1] - s0[x1] - s1[x0] + s0[x0]) / (double)n);
+				}
+			}
+		}
+	});
+}
+
+void HoleFiller::accumulateRow(PanoramaBuffer & _image, int _row, int _sign, int _radius, double * _sums, int * _counts)
+{
+	// the rows beyond the poles wrap to the other end of the image, like the row index of the original scan did
+	int
+		row = _row < 0 ? _row + _image.rows() : _row % _image.rows(),
+		tileSize = _image.tileSize();
+	for (int tc = 0; tc < _image.tileCols(); ++tc)
+	{
+		const float * p = _image.row(row, tc);
+		double * s = _sums + _radius + tc * tileSize;
+		int * n = _counts + _radius + tc * tileSize;
+		for (int c = 0; c < tileSize; ++c)
+		{
+			if (p[c] > 0)
+			{
+				s[c] += _sign * (double)p[c];
+				n[c] += _sign;
+			}
+		}
+	}
+}
+
+void HoleFiller::wrapColumns(int _cols, int _radius, double * _sums, int * _counts)
+{
+	for (int i = 0; i < _radius; ++i)
+	{
+		_sums[i] = _sums[_cols + i];
+		_counts[i] = _counts[_cols + i];
+		_sums[_radius + _cols + i] = _sums[_radius + i];
+		_counts[_radius + _cols + i] = _counts[_radius + i];
+	}
+}
\ No newline at end of file
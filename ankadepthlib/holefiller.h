@@ -0,0 +1,36 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include "ankadepthlibglobals.h"
+#include "panoramabuffer.h"
+
+namespace AnkaDepthLib
+{
+	// fills the empty pixels of a depth image with the average of the non-empty pixels in the square of
+	// 2 * (_size / 2) + 1 pixels around them, like averageDistance(_image, r, c, _size), at a cost per pixel that does
+	// not depend on the neighbourhood size
+	class HoleFiller
+	{
+	public:
+		// fills the rows from _firstRow down; _size / 2 must not exceed the buffer's halo
+		static void fill(PanoramaBuffer & _image, int _firstRow, int _size, HoleFillMode _mode, const bool & _interrupted);
+
+		// row-major and in place: a filled pixel counts as a neighbour of the pixels after it, and the rows beyond the
+		// poles wrap to the other end, exactly like the original per-pixel scan. running column sums keep the cost per
+		// pixel at 2 * (_size / 2) + 1 additions
+		static void fillScan(PanoramaBuffer & _image, int _firstRow, int _size, const bool & _interrupted);
+
+		// every hole sees only the pixels that were present before the pass, read from masked summed-area tables of
+		// each halo padded tile; independent of scan order, so the tiles are filled in parallel on the ParallelExecutor.
+		// the rows beyond the poles are empty here, the last rows see fewer neighbours than in the scan
+		static void fillSummedArea(PanoramaBuffer & _image, int _firstRow, int _size, const bool & _interrupted);
+
+	private:
+		HoleFiller();
+
+		// adds (_sign = 1) or removes (_sign = -1) a panorama row, wrapped past the poles, to the column sums, which
+		// hold _radius wrapped columns on both sides
+		static void accumulateRow(PanoramaBuffer & _image, int _row, int _sign, int _radius, double * _sums, int * _counts);
+		static void wrapColumns(int _cols, int _radius, double * _sums, int * _counts);
+	};
+}
\ No newline at end of file
@@ -23,9 +23,9 @@ namespace AnkaDepthLib
 
 		void faceTo(const LidarPoint & _other, double _heading = 0);
 
-		inline int get2D_X(double _width) { return (int)(_width * Theta / 360.0); }
+		inline int get2D_X(double _width) const { return (int)(_width * Theta / 360.0); }
 
-		inline int get2D_Y(double _height) { return (int)(_height * Phi / 180.0); }
+		inline int get2D_Y(double _height) const { return (int)(_height * Phi / 180.0); }
 
 		inline bool equals(const LidarPoint & _other) { return _other.X == X && _other.Y == Y && _other.Z == Z; }
 	};
@@ -0,0 +1,163 @@
+#include "occupancygrid.h"
+#include <cstring>
+
+using namespace AnkaDepthLib;
+
+OccupancyGrid::OccupancyGrid(int _rows, int _cols, int _tileSize)
+	:
+	mRows(_rows),
+	mCols(_cols),
+	mTileSize(_tileSize),
+	mTileRows((_rows + _tileSize - 1) / _tileSize),
+	mTileCols((_cols + _tileSize - 1) / _tileSize),
+	mMarkedCount(0)
+{
+	mTiles.fill(0, mTileRows * mTileCols);
+}
+
+bool OccupancyGrid::isEmpty() const
+{
+	return mMarkedCount == 0;
+}
+
+void OccupancyGrid::reset()
+{
+	if (mMarkedCount > 0)
+	{
+		mTiles.fill(0);
+		mMarkedCount = 0;
+	}
+}
+
+void OccupancyGrid::clearImage(cv::Mat & _image) const
+{
+	for (int tr = 0; mMarkedCount > 0 && tr < mTileRows; ++tr)
+	{
+		for (int tc = 0; tc < mTileCols; ++tc)
+		{
+			if (mTiles[tr * mTileCols + tc])
+				_image(cv::Rect(tc * mTileSize, tr * mTileSize, mTileSize, mTileSize) & cv::Rect(0, 0, mCols, mRows)) = 0;
+		}
+	}
+}
+
+QVector<cv::Rect> OccupancyGrid::regions(int _margin, bool _wrapCols) const
+{
+	QVector<cv::Rect> res;
+	if (mMarkedCount == 0)
+		return res;
+
+	// dilate the tile bitmap by the margin, rows first then columns; a partial last column tile is one more step across the seam
+	int m = (_margin + mTileSize - 1) / mTileSize;
+	int mCol = m + ((_wrapCols && mCols % mTileSize) ? 1 : 0);
+	QVector<uchar> rowPass(mTiles.count(), 0), dilated(mTiles.count(), 0);
+	for (int tr = 0; tr < mTileRows; ++tr)
+	{
+		uchar * row = rowPass.data() + tr * mTileCols;
+		for (int tc = 0; tc < mTileCols; ++tc)
+		{
+			if (!mTiles[tr * mTileCols + tc])
+				continue;
+
+			if (_wrapCols && 2 * mCol + 1 >= mTileCols)
+				memset(row, 1, mTileCols);
+			else if (_wrapCols)
+			{
+				for (int c = tc - mCol; c <= tc + mCol; ++c)
+					row[c < 0 ? c + mTileCols : (c >= mTileCols ? c - mTileCols : c)] = 1;
+			}
+			else
+			{
+				for (int c = std::max(tc - m, 0); c <= std::min(tc + m, mTileCols - 1); ++c)
+					row[c] = 1;
+			}
+		}
+	}
+
+	for (int tr = 0; tr < mTileRows; ++tr)
+	{
+		for (int tc = 0; tc < mTileCols; ++tc)
+		{
+			if (!rowPass[tr * mTileCols + tc])
+				continue;
+
+			for (int r = std::max(tr - m, 0); r <= std::min(tr + m, mTileRows - 1); ++r)
+				dilated[r * mTileCols + tc] = 1;
+		}
+	}
+
+	// horizontal runs of dilated tiles, merged with the identical run of the tile row above
+	QVector<cv::Rect> openRuns;
+	for (int tr = 0; tr < mTileRows; ++tr)
+	{
+		const uchar * row = dilated.constData() + tr * mTileCols;
+
+		// with wrapping, runs are scanned from an empty tile so a run crossing the seam stays in one piece
+		int first = 0, count = mTileCols;
+		if (_wrapCols)
+		{
+			while (first < mTileCols && row[first])
+				++first;
+
+			if (first == mTileCols)
+				first = count = 0;
+		}
+
+		QVector<cv::Rect> rowRuns;
+		if (_wrapCols && count == 0)
+			rowRuns.push_back(cv::Rect(0, tr, mTileCols, 1));
+
+		for (int i = 0; i < count; ++i)
+		{
+			if (!row[(first + i) % mTileCols])
+				continue;
+
+			int start = i;
+			while (i + 1 < count && row[(first + i + 1) % mTileCols])
+				++i;
+
+			rowRuns.push_back(cv::Rect((first + start) % mTileCols, tr, i - start + 1, 1));
+		}
+
+		for (int j = 0; j < rowRuns.count(); ++j)
+		{
+			cv::Rect & run = rowRuns[j];
+			for (int i = 0; i < openRuns.count(); ++i)
+			{
+				if (openRuns[i].x == run.x && openRuns[i].width == run.width)
+				{
+					run = openRuns[i];
+					run.height++;
+					openRuns.removeAt(i);
+					break;
+				}
+			}
+		}
+
+		// runs that did not continue into this row are complete
+		res += openRuns;
+		openRuns = rowRuns;
+	}
+	res += openRuns;
+
+	// tile units to pixels, the last tile row/column may be partial
+	for (int i = 0; i < res.count(); ++i)
+	{
+		cv::Rect & r = res[i];
+		int
+			top = r.y * mTileSize,
+			bottom = std::min((r.y + r.height) * mTileSize, mRows),
+			left = r.x * mTileSize,
+			lastCol = r.x + r.width - 1,
+			right = std::min((lastCol % mTileCols + 1) * mTileSize, mCols) + (lastCol / mTileCols) * mCols;
+
+		r = cv::Rect(left, top, right - left, bottom - top);
+	}
+
+	return res;
+}
+
+int OccupancyGrid::tileSize() const
+{
+	return mTileSize;
+}
\ No newline at end of file
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <QVector>
+#include <opencv2/opencv.hpp>
+#include "ankadepthlibglobals.h"
+
+namespace AnkaDepthLib
+{
+	// coarse tile bitmap of the pixels painted into an image, used to restrict full-frame passes to the dirty areas
+	class OccupancyGrid
+	{
+	public:
+		OccupancyGrid(int _rows, int _cols, int _tileSize = OCCUPANCY_TILE_SIZE);
+
+		inline void mark(int _row, int _col)
+		{
+			uchar & t = mTiles[(_row / mTileSize) * mTileCols + (_col / mTileSize)];
+			if (!t)
+			{
+				t = 1;
+				++mMarkedCount;
+			}
+		}
+
+		bool isEmpty() const;
+		void reset();
+
+		// zeroes the marked tiles of an image of the grid's size
+		void clearImage(cv::Mat & _image) const;
+
+		// pixel rectangles covering every pixel within _margin of a marked tile, clipped to the image rows; with _wrapCols
+		// the margin wraps around the 0/360 seam and a rectangle may run past the last column, continuing from column 0
+		QVector<cv::Rect> regions(int _margin, bool _wrapCols = false) const;
+
+		int tileSize() const;
+
+	private:
+		int mRows;
+		int mCols;
+		int mTileSize;
+		int mTileRows;
+		int mTileCols;
+		int mMarkedCount;
+		QVector<uchar> mTiles;
+	};
+}
\ No newline at end of file
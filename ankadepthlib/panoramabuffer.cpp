@@ -0,0 +1,181 @@
+#include "panoramabuffer.h"
+#include "parallelexecutor.h"
+
+using namespace AnkaDepthLib;
+
+PanoramaBuffer::PanoramaBuffer(int _rows, int _cols, int _tileSize, int _halo)
+	:
+	mRows(_rows),
+	mCols(_cols),
+	mTileSize(_tileSize),
+	mTileShift(0),
+	mTileMask(_tileSize - 1),
+	mHalo(_halo),
+	mTileRows(_rows / _tileSize),
+	mTileCols(_cols / _tileSize)
+{
+	// power of two tiles that divide the panorama keep pixel addressing to shifts and masks
+	CV_Assert(_tileSize > 0 && (_tileSize & (_tileSize - 1)) == 0);
+	CV_Assert(_rows % _tileSize == 0 && _cols % _tileSize == 0);
+	CV_Assert(_halo >= 0 && _halo <= _tileSize);
+
+	while ((1 << mTileShift) < _tileSize)
+		++mTileShift;
+
+	mTiles.reserve(mTileRows * mTileCols);
+	for (int i = 0; i < mTileRows * mTileCols; ++i)
+		mTiles.push_back(cv::Mat(mTileSize + 2 * mHalo, mTileSize + 2 * mHalo, CV_32FC1, cv::Scalar(0)));
+}
+
+int PanoramaBuffer::rows() const
+{
+	return mRows;
+}
+
+int PanoramaBuffer::cols() const
+{
+	return mCols;
+}
+
+int PanoramaBuffer::tileSize() const
+{
+	return mTileSize;
+}
+
+int PanoramaBuffer::halo() const
+{
+	return mHalo;
+}
+
+int PanoramaBuffer::tileRows() const
+{
+	return mTileRows;
+}
+
+int PanoramaBuffer::tileCols() const
+{
+	return mTileCols;
+}
+
+int PanoramaBuffer::tileCount() const
+{
+	return mTiles.count();
+}
+
+cv::Mat PanoramaBuffer::tile(int _tileRow, int _tileCol) const
+{
+	return mTiles[_tileRow * mTileCols + _tileCol];
+}
+
+cv::Mat PanoramaBuffer::tile(int _index) const
+{
+	return mTiles[_index];
+}
+
+cv::Mat PanoramaBuffer::interior(int _tileRow, int _tileCol) const
+{
+	return interior(_tileRow * mTileCols + _tileCol);
+}
+
+cv::Mat PanoramaBuffer::interior(int _index) const
+{
+	return mTiles[_index](cv::Rect(mHalo, mHalo, mTileSize, mTileSize));
+}
+
+cv::Mat PanoramaBuffer::window(int _index, int _margin) const
+{
+	CV_Assert(_margin >= 0 && _margin <= mHalo);
+	return mTiles[_index](cv::Rect(mHalo - _margin, mHalo - _margin, mTileSize + 2 * _margin, mTileSize + 2 * _margin));
+}
+
+cv::Rect PanoramaBuffer::tileRect(int _tileRow, int _tileCol) const
+{
+	return cv::Rect(_tileCol * mTileSize, _tileRow * mTileSize, mTileSize, mTileSize);
+}
+
+cv::Rect PanoramaBuffer::tileRect(int _index) const
+{
+	return tileRect(_index / mTileCols, _index % mTileCols);
+}
+
+void PanoramaBuffer::fill(float _value)
+{
+	for (int i = 0; i < mTiles.count(); ++i)
+		mTiles[i] = _value;
+}
+
+void PanoramaBuffer::syncHalo()
+{
+	if (mHalo == 0)
+		return;
+
+	// source/destination spans inside padded tiles for the neighbour before, at and after a tile along one axis
+	const int
+		dstStart[3] = { 0, mHalo, mHalo + mTileSize },
+		srcStart[3] = { mTileSize, mHalo, mHalo },
+		length[3] = { mHalo, mTileSize, mHalo };
+
+	// a tile only writes its own halo and only reads the interiors of its neighbours
+	ParallelExecutor::parallelFor(mTiles.count(), [&](int _begin, int _end)
+	{
+		for (int i = _begin; i < _end; ++i)
+		{
+			int
+				tr = i / mTileCols,
+				tc = i % mTileCols;
+			cv::Mat & dst = mTiles[i];
+			for (int dr = 0; dr < 3; ++dr)
+			{
+				int nr = tr + dr - 1;
+				for (int dc = 0; dc < 3; ++dc)
+				{
+					if (dr == 1 && dc == 1)
+						continue;
+
+					cv::Mat target = dst(cv::Rect(dstStart[dc], dstStart[dr], length[dc], length[dr]));
+
+					// beyond the poles there is nothing to see
+					if (nr < 0 || nr >= mTileRows)
+					{
+						target = 0;
+						continue;
+					}
+
+					int nc = tc + dc - 1;
+					nc = nc < 0 ? nc + mTileCols : (nc >= mTileCols ? nc - mTileCols : nc);
+					mTiles[nr * mTileCols + nc](cv::Rect(srcStart[dc], srcStart[dr], length[dc], length[dr])).copyTo(target);
+				}
+			}
+		}
+	});
+}
+
+void PanoramaBuffer::fromMat(const cv::Mat & _image)
+{
+	CV_Assert(_image.type() == CV_32FC1 && _image.rows == mRows && _image.cols == mCols);
+
+	for (int i = 0; i < mTiles.count(); ++i)
+		_image(tileRect(i)).copyTo(interior(i));
+}
+
+void PanoramaBuffer::toMat(cv::Mat & _image) const
+{
+	_image.create(mRows, mCols, CV_32FC1);
+
+	for (int i = 0; i < mTiles.count(); ++i)
+		interior(i).copyTo(_image(tileRect(i)));
+}
+
+void PanoramaBuffer::blendNonZero(const cv::Mat & _src, int _top, int _left)
+{
+	float v = 0;
+	for (int r = 0; r < _src.rows; ++r)
+	{
+		const float * s = _src.ptr<float>(r);
+		for (int c = 0; c < _src.cols; ++c)
+		{
+			if ((v = s[c]) > 0)
+				atWrapped(_top + r, _left + c) = v;
+		}
+	}
+}
\ No newline at end of file
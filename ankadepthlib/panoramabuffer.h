@@ -0,0 +1,86 @@
+#pragma once
+
+#include <QVector>
+#include <opencv2/opencv.hpp>
+#include "ankadepthlibglobals.h"
+
+namespace AnkaDepthLib
+{
+	// equirectangular CV_32FC1 depth image stored as square tiles, each surrounded by a halo of its neighbours' pixels;
+	// columns wrap around the 0/360 seam, rows beyond the poles read as empty (0). after syncHalo() a kernel of radius
+	// up to halo() can read the neighbours of any interior pixel of a tile without bounds or wrap checks
+	class PanoramaBuffer
+	{
+	public:
+		PanoramaBuffer(int _rows = (int)H, int _cols = (int)W, int _tileSize = PANORAMA_TILE_SIZE, int _halo = PANORAMA_HALO);
+
+		inline float & at(int _row, int _col)
+		{
+			return mTiles[(_row >> mTileShift) * mTileCols + (_col >> mTileShift)]
+				.ptr<float>((_row & mTileMask) + mHalo)[(_col & mTileMask) + mHalo];
+		}
+
+		inline float at(int _row, int _col) const
+		{
+			return mTiles[(_row >> mTileShift) * mTileCols + (_col >> mTileShift)]
+				.ptr<float>((_row & mTileMask) + mHalo)[(_col & mTileMask) + mHalo];
+		}
+
+		// column may lie up to one panorama width outside the image
+		inline float & atWrapped(int _row, int _col)
+		{
+			return at(_row, _col < 0 ? _col + mCols : (_col >= mCols ? _col - mCols : _col));
+		}
+
+		// interior row of a tile, _row is a panorama row
+		inline float * row(int _row, int _tileCol)
+		{
+			return mTiles[(_row >> mTileShift) * mTileCols + _tileCol].ptr<float>((_row & mTileMask) + mHalo) + mHalo;
+		}
+
+		int rows() const;
+		int cols() const;
+		int tileSize() const;
+		int halo() const;
+		int tileRows() const;
+		int tileCols() const;
+		int tileCount() const;
+
+		// padded tile, interior starts at (halo, halo)
+		cv::Mat tile(int _tileRow, int _tileCol) const;
+		cv::Mat tile(int _index) const;
+
+		// interior of a tile, sharing data with the buffer
+		cv::Mat interior(int _tileRow, int _tileCol) const;
+		cv::Mat interior(int _index) const;
+
+		// interior of a tile grown by _margin halo pixels on every side, _margin <= halo()
+		cv::Mat window(int _index, int _margin) const;
+
+		// position of a tile's interior in the panorama
+		cv::Rect tileRect(int _tileRow, int _tileCol) const;
+		cv::Rect tileRect(int _index) const;
+
+		void fill(float _value);
+
+		// refreshes every tile's halo from the interiors of its neighbours
+		void syncHalo();
+
+		void fromMat(const cv::Mat & _image);
+		void toMat(cv::Mat & _image) const;
+
+		// paints the non-empty pixels of _src with its top-left corner at (_top, _left); columns wrap around the seam
+		void blendNonZero(const cv::Mat & _src, int _top, int _left);
+
+	private:
+		int mRows;
+		int mCols;
+		int mTileSize;
+		int mTileShift;
+		int mTileMask;
+		int mHalo;
+		int mTileRows;
+		int mTileCols;
+		QVector<cv::Mat> mTiles;
+	};
+}
\ No newline at end of file
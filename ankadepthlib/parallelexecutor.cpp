@@ -0,0 +1,131 @@
+#include "parallelexecutor.h"
+#include <QThread>
+
+using namespace AnkaDepthLib;
+
+QThreadStorage<int> ParallelExecutor::mParallelism;
+QAtomicInt ParallelExecutor::mRunningTasks(0);
+
+ParallelExecutor::ParallelExecutor()
+{
+}
+
+void ParallelExecutor::setParallelism(int _parallelism)
+{
+	mParallelism.setLocalData(std::max(_parallelism, 0));
+}
+
+int ParallelExecutor::parallelism()
+{
+	if (!mParallelism.hasLocalData())
+		return 1;
+
+	int res = mParallelism.localData();
+	if (res == 0)
+	{
+		int cores = QThread::idealThreadCount();
+		int tasks = std::max(mRunningTasks.load(), 1);
+		res = (cores + tasks - 1) / tasks;
+	}
+
+	return std::max(res, 1);
+}
+
+void ParallelExecutor::taskStarted()
+{
+	mRunningTasks.ref();
+}
+
+void ParallelExecutor::taskFinished()
+{
+	mRunningTasks.deref();
+}
+
+void ParallelExecutor::parallelFor(int _count, const std::function<void(int, int)> & _body, int _grain)
+{
+	if (_count <= 0)
+		return;
+
+	_grain = std::max(_grain, 1);
+	int
+		chunks = (_count + _grain - 1) / _grain,
+		helpers = std::min(parallelism(), chunks) - 1;
+
+	if (helpers <= 0)
+	{
+		_body(0, _count);
+		return;
+	}
+
+	QSharedPointer<Loop> loop(new Loop(_count, _grain, _body));
+	for (int i = 0; i < helpers; ++i)
+		threadPool()->start(new Helper(loop));
+
+	loop->work();
+	loop->wait();
+}
+
+QThreadPool * ParallelExecutor::threadPool()
+{
+	// separate from the global pool which runs the tasks themselves
+	static QThreadPool pool;
+	static bool initialized = false;
+	static QMutex mutex;
+
+	QMutexLocker locker(&mutex);
+	if (!initialized)
+	{
+		pool.setMaxThreadCount(std::max(QThread::idealThreadCount() - 1, 1));
+		initialized = true;
+	}
+
+	return &pool;
+}
+
+#pragma region Loop
+ParallelExecutor::Loop::Loop(int _count, int _grain, const std::function<void(int, int)> & _body)
+	:
+	mBody(_body),
+	mCount(_count),
+	mGrain(_grain),
+	mChunks((_count + _grain - 1) / _grain),
+	mNext(0),
+	mDone(0)
+{
+}
+
+void ParallelExecutor::Loop::work()
+{
+	int chunk = 0;
+	while ((chunk = mNext.fetchAndAddRelaxed(1)) < mChunks)
+	{
+		mBody(chunk * mGrain, std::min((chunk + 1) * mGrain, mCount));
+
+		if (mDone.fetchAndAddOrdered(1) + 1 == mChunks)
+		{
+			QMutexLocker locker(&mMutex);
+			mFinished.wakeAll();
+		}
+	}
+}
+
+void ParallelExecutor::Loop::wait()
+{
+	QMutexLocker locker(&mMutex);
+	while (mDone.load() < mChunks)
+		mFinished.wait(&mMutex);
+}
+#pragma endregion
+
+#pragma region Helper
+ParallelExecutor::Helper::Helper(QSharedPointer<Loop> _loop)
+	: mLoop(_loop)
+{
+	setAutoDelete(true);
+}
+
+void ParallelExecutor::Helper::run()
+{
+	mLoop->work();
+}
+#pragma endregion
\ No newline at end of file
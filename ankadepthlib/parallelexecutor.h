@@ -0,0 +1,70 @@
+#pragma once
+
+#include <functional>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QThreadStorage>
+#include <QAtomicInt>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QSharedPointer>
+
+namespace AnkaDepthLib
+{
+	// shared helper pool for the data parallel stages of the depth tasks. the calling thread works on its own loop too and
+	// every thread claims the next chunk from an atomic counter, so a stage never waits for a busy pool: chunks nobody
+	// else picked up are simply run by the caller
+	class ParallelExecutor
+	{
+	public:
+		// degree of parallelism of the loops started from the calling thread, the caller included; 0 shares the cores
+		// evenly among the running tasks, threads that never set it (e.g. the helpers themselves) run loops serially
+		static void setParallelism(int _parallelism);
+		static int parallelism();
+
+		// running task count used by the automatic degree
+		static void taskStarted();
+		static void taskFinished();
+
+		// runs _body(begin, end) for [0, _count) in chunks of _grain and returns when every chunk is done
+		static void parallelFor(int _count, const std::function<void(int, int)> & _body, int _grain = 1);
+
+	private:
+		ParallelExecutor();
+
+		class Loop
+		{
+		public:
+			Loop(int _count, int _grain, const std::function<void(int, int)> & _body);
+
+			// claims and runs chunks until none is left
+			void work();
+			void wait();
+
+		private:
+			std::function<void(int, int)> mBody;
+			int mCount;
+			int mGrain;
+			int mChunks;
+			QAtomicInt mNext;
+			QAtomicInt mDone;
+			QMutex mMutex;
+			QWaitCondition mFinished;
+		};
+
+		class Helper : public QRunnable
+		{
+		public:
+			Helper(QSharedPointer<Loop> _loop);
+			void run() override;
+
+		private:
+			QSharedPointer<Loop> mLoop;
+		};
+
+		static QThreadPool * threadPool();
+
+		static QThreadStorage<int> mParallelism;
+		static QAtomicInt mRunningTasks;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,306 @@
+#include "patchcache.h"
+#include <algorithm>
+#include <vector>
+
+using namespace AnkaDepthLib;
+
+PatchCache::Pending::Pending()
+	:
+	finished(false),
+	ok(false)
+{
+}
+
+PatchCache::Shard::Shard()
+	:
+	policy(PatchEvictionPolicy::create(PCP_LRU)),
+	bytes(0)
+{
+}
+
+PatchCache::Shard::~Shard()
+{
+	delete policy;
+}
+
+void PatchCache::Shard::evict(qint64 _budget)
+{
+	while (bytes > _budget && !blocks.isEmpty())
+	{
+		QString key = policy->victim();
+		QHash<QString, PointBlock>::iterator it = blocks.find(key);
+		if (key.isEmpty() || it == blocks.end())
+			break;
+
+		// the tasks holding the block keep it alive, the cache only drops its reference
+		bytes -= it->footprint();
+		blocks.erase(it);
+	}
+}
+
+PatchCache::PatchCache(int _shardCount)
+	: mBudget(0)
+{
+	for (int i = 0; i < std::max(_shardCount, 1); ++i)
+		mShards.push_back(new Shard());
+}
+
+PatchCache::~PatchCache()
+{
+	qDeleteAll(mShards);
+}
+
+void PatchCache::setBudget(qint64 _bytes)
+{
+	mBudget.storeRelease(std::max<qint64>(_bytes, 0));
+
+	qint64 budget = shardBudget();
+	for (QVector<Shard *>::iterator it = mShards.begin(); it != mShards.end(); ++it)
+	{
+		QMutexLocker locker(&(*it)->mutex);
+		(*it)->policy->setBudget(budget);
+		(*it)->evict(budget);
+	}
+}
+
+qint64 PatchCache::budget() const
+{
+	return mBudget.loadAcquire();
+}
+
+void PatchCache::setPolicy(PatchCachePolicy _policy)
+{
+	QVector<QPointF> focus;
+	{
+		QMutexLocker locker(&mFocusMutex);
+		focus = mFocus;
+	}
+
+	qint64 budget = shardBudget();
+	for (QVector<Shard *>::iterator it = mShards.begin(); it != mShards.end(); ++it)
+	{
+		QMutexLocker locker(&(*it)->mutex);
+		delete (*it)->policy;
+		(*it)->policy = PatchEvictionPolicy::create(_policy);
+		(*it)->policy->setBudget(budget);
+		(*it)->policy->setFocus(focus);
+		for (QHash<QString, PointBlock>::iterator block = (*it)->blocks.begin(); block != (*it)->blocks.end(); )
+		{
+			// the policy looks at the points, handles whose bytes the arena reclaimed meanwhile are dropped instead
+			PointBlock pinned = block.value().pinned();
+			if (!pinned.isValid())
+			{
+				(*it)->bytes -= block->footprint();
+				block = (*it)->blocks.erase(block);
+				continue;
+			}
+
+			(*it)->policy->inserted(block.key(), pinned);
+			++block;
+		}
+	}
+}
+
+void PatchCache::addFocus(double _x, double _y)
+{
+	QVector<QPointF> focus;
+	{
+		QMutexLocker locker(&mFocusMutex);
+		mFocus.push_back(QPointF(_x, _y));
+		if (mFocus.count() > PATCH_CACHE_FOCUS_POINTS)
+			mFocus.remove(0);
+		focus = mFocus;
+	}
+
+	for (QVector<Shard *>::iterator it = mShards.begin(); it != mShards.end(); ++it)
+	{
+		QMutexLocker locker(&(*it)->mutex);
+		(*it)->policy->setFocus(focus);
+	}
+}
+
+bool PatchCache::get(const QString & _key, const Loader & _loader, PointBlock & _block, bool * _loaded)
+{
+	QSharedPointer<Pending> pending;
+	Claim claimed = claim(_key, _block, pending);
+	if (_loaded)
+		*_loaded = claimed == LOAD;
+
+	if (claimed == HIT)
+		return true;
+	if (claimed == WAIT)
+		return wait(pending, _block);
+
+	PointBlock block;
+	bool ok = _loader(block);
+	finish(_key, pending, ok, block);
+
+	_block = block;
+	return ok;
+}
+
+bool PatchCache::getAll(const QStringList & _keys, const BatchLoader & _loader, PointBlockVector & _blocks, QVector<bool> * _loaded)
+{
+	int count = _keys.count();
+	_blocks = PointBlockVector(count);
+	if (_loaded)
+		*_loaded = QVector<bool>(count, false);
+
+	// the loads are claimed before any of them starts, so a batch never waits on a key it is to load itself
+	QVector<QSharedPointer<Pending>> pending(count);
+	QVector<int> loads, waits;
+	for (int i = 0; i < count; ++i)
+	{
+		Claim claimed = claim(_keys[i], _blocks[i], pending[i]);
+		if (claimed == LOAD)
+			loads.push_back(i);
+		else if (claimed == WAIT)
+			waits.push_back(i);
+	}
+
+	std::vector<char> ok(count, 1), delivered(count, 0);
+	if (!loads.isEmpty())
+	{
+		// each key is delivered by one thread, their slots of the vectors are theirs alone
+		PointBlock * blocks = _blocks.data();
+		_loader(loads, [&](int _index, bool _ok, const PointBlock & _block)
+		{
+			if (delivered[_index])
+				return;
+			delivered[_index] = 1;
+			ok[_index] = _ok;
+			blocks[_index] = _block;
+			finish(_keys[_index], pending[_index], _ok, _block);
+		});
+
+		for (QVector<int>::const_iterator it = loads.constBegin(); it != loads.constEnd(); ++it)
+		{
+			if (!delivered[*it])
+			{
+				ok[*it] = 0;
+				finish(_keys[*it], pending[*it], false, PointBlock());
+			}
+			if (_loaded)
+				(*_loaded)[*it] = true;
+		}
+	}
+
+	for (QVector<int>::const_iterator it = waits.constBegin(); it != waits.constEnd(); ++it)
+		ok[*it] = wait(pending[*it], _blocks[*it]);
+
+	return std::find(ok.begin(), ok.end(), 0) == ok.end();
+}
+
+bool PatchCache::contains(const QString & _key) const
+{
+	Shard * shard = shardOf(_key);
+	QMutexLocker locker(&shard->mutex);
+	return shard->blocks.contains(_key);
+}
+
+int PatchCache::count() const
+{
+	int res = 0;
+	for (QVector<Shard *>::const_iterator it = mShards.constBegin(); it != mShards.constEnd(); ++it)
+	{
+		QMutexLocker locker(&(*it)->mutex);
+		res += (*it)->blocks.count();
+	}
+	return res;
+}
+
+qint64 PatchCache::bytes() const
+{
+	qint64 res = 0;
+	for (QVector<Shard *>::const_iterator it = mShards.constBegin(); it != mShards.constEnd(); ++it)
+	{
+		QMutexLocker locker(&(*it)->mutex);
+		res += (*it)->bytes;
+	}
+	return res;
+}
+
+void PatchCache::clear()
+{
+	// loads in flight still hand their block to their waiters and cache it
+	for (QVector<Shard *>::iterator it = mShards.begin(); it != mShards.end(); ++it)
+	{
+		QMutexLocker locker(&(*it)->mutex);
+		(*it)->blocks.clear();
+		(*it)->policy->clear();
+		(*it)->bytes = 0;
+	}
+}
+
+PatchCache::Shard * PatchCache::shardOf(const QString & _key) const
+{
+	return mShards[qHash(_key) % (uint)mShards.count()];
+}
+
+PatchCache::Claim PatchCache::claim(const QString & _key, PointBlock & _block, QSharedPointer<Pending> & _pending)
+{
+	Shard * shard = shardOf(_key);
+	QMutexLocker locker(&shard->mutex);
+	QHash<QString, PointBlock>::iterator it = shard->blocks.find(_key);
+	if (it != shard->blocks.end())
+	{
+		// a handle whose bytes the arena reclaimed is a miss
+		_block = it.value().pinned();
+		if (_block.isValid())
+		{
+			shard->policy->accessed(_key);
+			return HIT;
+		}
+
+		shard->bytes -= it->footprint();
+		shard->blocks.erase(it);
+		shard->policy->removed(_key);
+	}
+
+	_pending = shard->pending.value(_key);
+	if (!_pending.isNull())
+		return WAIT;
+
+	_pending = QSharedPointer<Pending>(new Pending());
+	shard->pending.insert(_key, _pending);
+	return LOAD;
+}
+
+void PatchCache::finish(const QString & _key, const QSharedPointer<Pending> & _pending, bool _ok, const PointBlock & _block)
+{
+	Shard * shard = shardOf(_key);
+	{
+		QMutexLocker locker(&shard->mutex);
+		shard->pending.remove(_key);
+		if (_ok)
+		{
+			// the policy sees the points of the block, the cache keeps what it needs to pin them again
+			PointBlock cached = _block.cached();
+			shard->blocks.insert(_key, cached);
+			shard->bytes += cached.footprint();
+			shard->policy->inserted(_key, _block);
+			shard->evict(shardBudget());
+		}
+	}
+
+	QMutexLocker locker(&_pending->mutex);
+	_pending->block = _block;
+	_pending->ok = _ok;
+	_pending->finished = true;
+	_pending->done.wakeAll();
+}
+
+bool PatchCache::wait(const QSharedPointer<Pending> & _pending, PointBlock & _block)
+{
+	QMutexLocker locker(&_pending->mutex);
+	while (!_pending->finished)
+		_pending->done.wait(&_pending->mutex);
+
+	_block = _pending->block;
+	return _pending->ok;
+}
+
+qint64 PatchCache::shardBudget() const
+{
+	return budget() / mShards.count();
+}
\ No newline at end of file
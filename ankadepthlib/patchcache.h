@@ -0,0 +1,111 @@
+#pragma once
+
+#include <functional>
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QVector>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QSharedPointer>
+#include <QAtomicInteger>
+#include <QPointF>
+#include "ankadepthlibglobals.h"
+#include "pointblock.h"
+#include "patchevictionpolicy.h"
+
+namespace AnkaDepthLib
+{
+	// the process's patch cache: blocks by key in hash indexed shards with their own locks, and single flight loads.
+	// the first thread asking for a missing key runs the loader without any lock held, the threads asking meanwhile
+	// sleep on that key's pending load and share its result instead of polling or loading it again. the blocks handed
+	// out share their bytes with the cache, and each shard evicts down to its part of a byte budget by its policy. blocks
+	// of the host's SharedPatchArena are kept as handles charged by their footprint, pinned again when handed out and
+	// missed once the arena reclaimed their bytes
+	class PatchCache
+	{
+	public:
+		typedef std::function<bool(PointBlock &)> Loader;
+
+		// hands the block of the _index'th key of a batch to the cache, from any thread and once per key
+		typedef std::function<void(int _index, bool _ok, const PointBlock & _block)> Delivery;
+		// loads the keys at _indices and delivers each as soon as it has it; keys never delivered count as failed
+		typedef std::function<void(const QVector<int> & _indices, const Delivery & _deliver)> BatchLoader;
+
+		PatchCache(int _shardCount = PATCH_CACHE_SHARDS);
+		~PatchCache();
+
+		// bytes kept over all shards, split evenly between them
+		void setBudget(qint64 _bytes);
+		qint64 budget() const;
+
+		// the policy of every shard, the cached blocks are handed over to it in no particular order
+		void setPolicy(PatchCachePolicy _policy);
+
+		// position of a task using the cache, the last PATCH_CACHE_FOCUS_POINTS ones guide the trajectory policy
+		void addFocus(double _x, double _y);
+
+		// the cached block of _key, else the result of the load of whoever asked first; _loaded tells whether this
+		// call ran _loader. failed loads are not cached, the next request tries again
+		bool get(const QString & _key, const Loader & _loader, PointBlock & _block, bool * _loaded = nullptr);
+
+		// get for a set of keys: the missing ones nobody else is loading go to one _loader call, then the ones other
+		// threads are loading are waited for. _blocks is in the order of _keys, with invalid blocks for failed loads
+		bool getAll(const QStringList & _keys, const BatchLoader & _loader, PointBlockVector & _blocks, QVector<bool> * _loaded = nullptr);
+
+		bool contains(const QString & _key) const;
+		int count() const;
+		qint64 bytes() const;
+		void clear();
+
+	private:
+		class Pending
+		{
+		public:
+			Pending();
+
+			QMutex mutex;
+			QWaitCondition done;
+			bool finished;
+			bool ok;
+			PointBlock block;
+		};
+
+		class Shard
+		{
+		public:
+			Shard();
+			~Shard();
+
+			// drops blocks by the policy until the shard fits _budget; under the lock
+			void evict(qint64 _budget);
+
+			mutable QMutex mutex;
+			QHash<QString, PointBlock> blocks;
+			QHash<QString, QSharedPointer<Pending>> pending;
+			PatchEvictionPolicy * policy;
+			qint64 bytes;
+		};
+
+		enum Claim
+		{
+			HIT,
+			LOAD,
+			WAIT
+		};
+
+		// the cached block, or the pending load of _key, created if this call is the first to miss it
+		Claim claim(const QString & _key, PointBlock & _block, QSharedPointer<Pending> & _pending);
+		// caches a successful load and wakes the threads waiting for it
+		void finish(const QString & _key, const QSharedPointer<Pending> & _pending, bool _ok, const PointBlock & _block);
+		static bool wait(const QSharedPointer<Pending> & _pending, PointBlock & _block);
+
+		Shard * shardOf(const QString & _key) const;
+		qint64 shardBudget() const;
+
+		QVector<Shard *> mShards;
+		QAtomicInteger<qint64> mBudget;
+		QMutex mFocusMutex;
+		QVector<QPointF> mFocus;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,361 @@
+#include "patchdiskcache.h"
+#include "ankadepthlibglobals.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDateTime>
+#include <QCryptographicHash>
+#include <cstring>
+
+using namespace AnkaDepthLib;
+
+#define PATCH_DISK_CACHE_SUFFIX	".apc"
+#define PATCH_DISK_CACHE_LOCK	"slot.lock"
+
+PatchDiskCache::PatchDiskCache()
+	:
+	mBudget(0),
+	mBytes(0),
+	mTick(0),
+	mQueued(0),
+	mSlotLock(nullptr)
+{
+	mWriter.setMaxThreadCount(1);
+}
+
+PatchDiskCache::~PatchDiskCache()
+{
+	// the jobs point back here
+	close();
+}
+
+bool PatchDiskCache::open(const QString & _dir, qint64 _budgetBytes)
+{
+	close();
+	if (_dir.isEmpty() || _budgetBytes <= 0)
+		return false;
+
+	// the manager hands every worker of a host the same directory; a process takes the first slot no live process
+	// holds, the lock of a dead one is stale, so a restarted worker finds the files a worker before it left
+	QDir dir;
+	QLockFile * lock = nullptr;
+	for (int slot = 0; !lock && slot < PATCH_DISK_CACHE_SLOTS; ++slot)
+	{
+		dir = QDir(QDir(_dir).filePath(QString("slot%1").arg(slot)));
+		if (!dir.exists() && !dir.mkpath("."))
+			return false;
+
+		lock = new QLockFile(dir.filePath(PATCH_DISK_CACHE_LOCK));
+		lock->setStaleLockTime(0);
+		if (!lock->tryLock(0))
+		{
+			delete lock;
+			lock = nullptr;
+		}
+	}
+	if (!lock)
+		return false;
+
+	// the files are indexed oldest first, so the modification times carry the recency over from the last run
+	QFileInfoList files = dir.entryInfoList(QStringList() << QString("*%1").arg(PATCH_DISK_CACHE_SUFFIX), QDir::Files, QDir::Time | QDir::Reversed);
+
+	QMutexLocker locker(&mMutex);
+	mSlotLock = lock;
+	mDir = dir.absolutePath();
+	mBudget = _budgetBytes;
+	for (QFileInfoList::iterator it = files.begin(); it != files.end(); ++it)
+	{
+		Entry entry;
+		entry.size = it->size();
+		entry.tick = ++mTick;
+		mEntries.insert(it->fileName(), entry);
+		mRecency.insert(entry.tick, it->fileName());
+		mBytes += entry.size;
+	}
+	evict();
+
+	return true;
+}
+
+void PatchDiskCache::close()
+{
+	flush();
+
+	QMutexLocker locker(&mMutex);
+	mDir.clear();
+	mBudget = 0;
+	mBytes = 0;
+	mEntries.clear();
+	mRecency.clear();
+	mPending.clear();
+
+	delete mSlotLock;
+	mSlotLock = nullptr;
+}
+
+bool PatchDiskCache::isOpen() const
+{
+	QMutexLocker locker(&mMutex);
+	return !mDir.isEmpty();
+}
+
+PointBlock PatchDiskCache::load(const QString & _key)
+{
+	QString name = fileName(_key), path;
+	{
+		QMutexLocker locker(&mMutex);
+		if (mDir.isEmpty() || !mEntries.contains(name))
+			return PointBlock();
+		path = QDir(mDir).filePath(name);
+	}
+
+	QFile * file = new QFile(path);
+	uchar * map = nullptr;
+	qint64 size = 0;
+	if (file->open(QIODevice::ReadOnly))
+	{
+		size = file->size();
+		map = size >= HeaderSize ? file->map(0, size) : nullptr;
+	}
+
+	// a file that does not match its header, a foreign key with the same hash or a bad checksum is dropped
+	PointBlock block;
+	if (map)
+	{
+		const FileHeader * header = reinterpret_cast<const FileHeader *>(map);
+		bool sized = header->keySize < (quint32)size && header->payloadSize < (quint64)size;
+		qint64 offset = sized ? payloadOffset(header->keySize) : 0;
+		bool valid =
+			sized &&
+			header->magic == Magic &&
+			header->version == Version &&
+			offset + (qint64)header->payloadSize == size &&
+			QString::fromUtf8(reinterpret_cast<const char *>(map + HeaderSize), header->keySize) == _key &&
+			checksum(reinterpret_cast<const char *>(map + offset), header->payloadSize) == header->checksum;
+
+		if (valid)
+		{
+			// the storage owns the file and its mapping from here on
+			block = PointBlock(QSharedPointer<PointBlockStorage>(new PointBlockMappedStorage(file, map, offset, header->payloadSize)));
+			file = nullptr;
+		}
+		else
+			file->unmap(map);
+	}
+
+	if (file)
+	{
+		file->close();
+		delete file;
+	}
+
+	if (!block.isValid())
+	{
+		QMutexLocker locker(&mMutex);
+		remove(name);
+		return PointBlock();
+	}
+
+	{
+		QMutexLocker locker(&mMutex);
+		touch(name, size);
+	}
+
+	// a new modification time orders the file by its last use when the next run indexes the directory
+	QFile stamp(path);
+	if (stamp.open(QIODevice::ReadWrite))
+		stamp.setFileTime(QDateTime::currentDateTimeUtc(), QFileDevice::FileModificationTime);
+
+	return block;
+}
+
+bool PatchDiskCache::store(const QString & _key, const PointBlock & _block)
+{
+	QString name = fileName(_key), path;
+	QByteArray key = _key.toUtf8();
+	qint64
+		payloadSize = _block.byteSize(),
+		offset = payloadOffset(key.size());
+	{
+		QMutexLocker locker(&mMutex);
+		if (mDir.isEmpty() || !_block.isValid() || offset + payloadSize > mBudget)
+			return false;
+		path = QDir(mDir).filePath(name);
+	}
+
+	FileHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = Magic;
+	header.version = Version;
+	header.payloadSize = payloadSize;
+	header.checksum = checksum(_block.storage()->data(), payloadSize);
+	header.keySize = key.size();
+
+	// written aside and renamed over the old file, so a crash never leaves a half written patch behind
+	QSaveFile file(path);
+	if (!file.open(QIODevice::WriteOnly))
+		return false;
+
+	key.append(QByteArray(offset - HeaderSize - key.size(), 0));
+	if (file.write(reinterpret_cast<const char *>(&header), sizeof(header)) != sizeof(header) ||
+		file.write(key) != key.size() ||
+		file.write(_block.storage()->data(), payloadSize) != payloadSize ||
+		!file.commit())
+		return false;
+
+	QMutexLocker locker(&mMutex);
+	drop(name);
+	touch(name, offset + payloadSize);
+	evict();
+
+	return true;
+}
+
+void PatchDiskCache::post(const QString & _key, const PointBlock & _block)
+{
+	{
+		QMutexLocker locker(&mMutex);
+		if (mDir.isEmpty() || !_block.isValid() || mQueued + _block.byteSize() > ((qint64)PATCH_DISK_CACHE_QUEUE_MB << 20))
+			return;
+		mQueued += _block.byteSize();
+	}
+
+	mWriter.start(new Job(this, _key, _block));
+}
+
+void PatchDiskCache::flush()
+{
+	mWriter.waitForDone();
+}
+
+qint64 PatchDiskCache::bytes() const
+{
+	QMutexLocker locker(&mMutex);
+	return mBytes;
+}
+
+int PatchDiskCache::fileCount() const
+{
+	QMutexLocker locker(&mMutex);
+	return mEntries.count();
+}
+
+QString PatchDiskCache::directory() const
+{
+	QMutexLocker locker(&mMutex);
+	return mDir;
+}
+
+quint64 PatchDiskCache::checksum(const char * _data, qint64 _size)
+{
+	// fletcher style running sums of the 32 bit words, the tail bytes are added one by one
+	quint64 a = 1, b = 0;
+	quint32 word = 0;
+	qint64 words = _size / 4, i = 0;
+	for (; i < words; ++i)
+	{
+		memcpy(&word, _data + i * 4, 4);
+		a += word;
+		b += a;
+	}
+	for (i *= 4; i < _size; ++i)
+	{
+		a += (quint8)_data[i];
+		b += a;
+	}
+
+	return (b << 32) ^ a ^ ((quint64)_size << 48);
+}
+
+QString PatchDiskCache::fileName(const QString & _key)
+{
+	return QString::fromLatin1(QCryptographicHash::hash(_key.toUtf8(), QCryptographicHash::Sha1).toHex()) + PATCH_DISK_CACHE_SUFFIX;
+}
+
+qint64 PatchDiskCache::payloadOffset(int _keySize)
+{
+	// the payload starts 8 byte aligned like the blocks of the memory cache
+	return HeaderSize + ((_keySize + 7) & ~7);
+}
+
+void PatchDiskCache::touch(const QString & _name, qint64 _size)
+{
+	QHash<QString, Entry>::iterator it = mEntries.find(_name);
+	if (it == mEntries.end())
+	{
+		Entry entry;
+		entry.size = _size;
+		entry.tick = 0;
+		it = mEntries.insert(_name, entry);
+		mBytes += _size;
+	}
+	else
+		mRecency.remove(it->tick);
+
+	it->tick = ++mTick;
+	mRecency.insert(it->tick, _name);
+}
+
+void PatchDiskCache::drop(const QString & _name)
+{
+	// a file written over the one waiting for removal replaced it
+	if (mPending.contains(_name))
+		mBytes -= mPending.take(_name);
+
+	QHash<QString, Entry>::iterator it = mEntries.find(_name);
+	if (it == mEntries.end())
+		return;
+
+	mRecency.remove(it->tick);
+	mBytes -= it->size;
+	mEntries.erase(it);
+}
+
+void PatchDiskCache::remove(const QString & _name)
+{
+	QHash<QString, Entry>::iterator it = mEntries.find(_name);
+	if (it != mEntries.end())
+	{
+		mRecency.remove(it->tick);
+		mPending.insert(_name, it->size);
+		mEntries.erase(it);
+	}
+
+	// a file still mapped by a block cannot be removed on every platform, it stays counted until it can
+	QString path = QDir(mDir).filePath(_name);
+	if (mPending.contains(_name) && (QFile::remove(path) || !QFile::exists(path)))
+		mBytes -= mPending.take(_name);
+}
+
+void PatchDiskCache::evict()
+{
+	// the files whose removal failed before go first, their blocks may be gone by now
+	if (mBytes > mBudget)
+	{
+		QList<QString> pending = mPending.keys();
+		for (QList<QString>::const_iterator it = pending.constBegin(); it != pending.constEnd(); ++it)
+			remove(*it);
+	}
+
+	while (mBytes > mBudget && !mRecency.isEmpty())
+		remove(mRecency.first());
+}
+
+#pragma region Job
+PatchDiskCache::Job::Job(PatchDiskCache * _cache, const QString & _key, const PointBlock & _block)
+	:
+	mCache(_cache),
+	mKey(_key),
+	mBlock(_block)
+{
+	setAutoDelete(true);
+}
+
+void PatchDiskCache::Job::run()
+{
+	mCache->store(mKey, mBlock);
+
+	QMutexLocker locker(&mCache->mMutex);
+	mCache->mQueued -= mBlock.byteSize();
+}
+#pragma endregion
\ No newline at end of file
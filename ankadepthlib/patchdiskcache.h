@@ -0,0 +1,119 @@
+#pragma once
+
+#include <QString>
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QLockFile>
+#include <QRunnable>
+#include <QThreadPool>
+#include "pointblock.h"
+
+namespace AnkaDepthLib
+{
+	// second tier of the patch cache on the worker's local disk, kept across restarts and reprocess runs. every cached
+	// patch is one file named after the hash of its key: a header with the key, size and checksum of the payload,
+	// then the packed PointBlock, which is read back through a memory map without copying. the files beyond the
+	// byte budget are evicted least recently used first. the workers of a host share the configured directory, each
+	// process keeps its files and its budget in a slot subdirectory it holds locked. the fetches post their patches to
+	// a writer thread of the cache, they do not wait for the disk
+	class PatchDiskCache
+	{
+	public:
+		PatchDiskCache();
+		~PatchDiskCache();
+
+		// takes the first free slot of _dir and indexes its cache files, creating them if needed; an empty directory, a
+		// zero budget or no free slot disables the cache
+		bool open(const QString & _dir, qint64 _budgetBytes);
+		// writes the stores posted so far first
+		void close();
+		bool isOpen() const;
+
+		// the block stored under _key mapped from its file, an invalid block if there is none; a damaged file is removed
+		PointBlock load(const QString & _key);
+
+		// writes the block under _key, replacing what was stored there, and evicts down to the budget
+		bool store(const QString & _key, const PointBlock & _block);
+
+		// queues the store on the writer thread, the block is shared and not copied; dropped while the blocks waiting
+		// add up to PATCH_DISK_CACHE_QUEUE_MB
+		void post(const QString & _key, const PointBlock & _block);
+
+		// returns once the stores posted so far are written
+		void flush();
+
+		qint64 bytes() const;
+		int fileCount() const;
+
+		// the slot directory holding the files, empty while closed
+		QString directory() const;
+
+		// name of the file of a key within the directory
+		static QString fileName(const QString & _key);
+
+		// checksum of the payloads, word wise so a file of a few megabytes is checked at memory speed
+		static quint64 checksum(const char * _data, qint64 _size);
+
+	private:
+		static constexpr quint32 Magic = 0x43504e41; // "ANPC"
+		static constexpr quint32 Version = 1;
+		static constexpr int HeaderSize = 64;
+
+		class FileHeader
+		{
+		public:
+			quint32 magic;
+			quint32 version;
+			quint64 payloadSize;
+			quint64 checksum;
+			quint32 keySize;
+			char reserved[PatchDiskCache::HeaderSize - 28];
+		};
+
+		class Entry
+		{
+		public:
+			qint64 size;
+			quint64 tick;
+		};
+
+		class Job : public QRunnable
+		{
+		public:
+			Job(PatchDiskCache * _cache, const QString & _key, const PointBlock & _block);
+			void run() override;
+
+		private:
+			PatchDiskCache * mCache;
+			QString mKey;
+			PointBlock mBlock;
+		};
+
+		static qint64 payloadOffset(int _keySize);
+
+		// adds a file to the index or marks it as the most recently used
+		void touch(const QString & _name, qint64 _size);
+
+		// takes a file out of the index and the byte count, e.g. before it is written over
+		void drop(const QString & _name);
+
+		// takes a file out of the index and deletes it, or keeps it pending while the deletion fails
+		void remove(const QString & _name);
+		void evict();
+
+		mutable QMutex mMutex;
+		QString mDir;
+		qint64 mBudget;
+		qint64 mBytes;
+		quint64 mTick;
+		QHash<QString, Entry> mEntries;
+		QMap<quint64, QString> mRecency;	// ticks of the entries, least recently used first
+		QHash<QString, qint64> mPending;	// sizes of the files out of the index that could not be deleted yet
+		qint64 mQueued;						// bytes of the blocks posted and not written yet
+		QLockFile * mSlotLock;				// held while the slot is open
+
+		// one thread, the stores are written in the order they were posted
+		QThreadPool mWriter;
+	};
+}
\ No newline at end of file
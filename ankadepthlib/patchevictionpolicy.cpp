@@ -0,0 +1,311 @@
+#include "patchevictionpolicy.h"
+#include <cmath>
+#include <limits>
+
+using namespace AnkaDepthLib;
+
+#pragma region PatchEvictionPolicy
+PatchEvictionPolicy::PatchEvictionPolicy()
+	: mBudget(0)
+{
+}
+
+PatchEvictionPolicy::~PatchEvictionPolicy()
+{
+}
+
+PatchEvictionPolicy * PatchEvictionPolicy::create(PatchCachePolicy _policy)
+{
+	switch (_policy)
+	{
+	case PCP_ARC:
+		return new ArcEvictionPolicy();
+	case PCP_TRAJECTORY:
+		return new TrajectoryEvictionPolicy();
+	default:
+		return new LruEvictionPolicy();
+	}
+}
+
+void PatchEvictionPolicy::setBudget(qint64 _bytes)
+{
+	mBudget = _bytes;
+}
+
+void PatchEvictionPolicy::setFocus(const QVector<QPointF> & _focus)
+{
+	Q_UNUSED(_focus);
+}
+#pragma endregion
+
+#pragma region LruEvictionPolicy
+LruEvictionPolicy::LruEvictionPolicy()
+	: mTick(0)
+{
+}
+
+void LruEvictionPolicy::inserted(const QString & _key, const PointBlock & _block)
+{
+	Q_UNUSED(_block);
+	accessed(_key);
+}
+
+void LruEvictionPolicy::accessed(const QString & _key)
+{
+	QHash<QString, quint64>::iterator it = mTicks.find(_key);
+	if (it != mTicks.end())
+		mRecency.remove(it.value());
+	else
+		it = mTicks.insert(_key, 0);
+
+	it.value() = ++mTick;
+	mRecency.insert(mTick, _key);
+}
+
+void LruEvictionPolicy::removed(const QString & _key)
+{
+	QHash<QString, quint64>::iterator it = mTicks.find(_key);
+	if (it == mTicks.end())
+		return;
+
+	mRecency.remove(it.value());
+	mTicks.erase(it);
+}
+
+void LruEvictionPolicy::clear()
+{
+	mTicks.clear();
+	mRecency.clear();
+}
+
+QString LruEvictionPolicy::victim()
+{
+	if (mRecency.isEmpty())
+		return QString();
+
+	QString key = mRecency.first();
+	removed(key);
+	return key;
+}
+#pragma endregion
+
+#pragma region ArcEvictionPolicy
+ArcEvictionPolicy::List::List()
+	:
+	bytes(0),
+	mTick(0)
+{
+}
+
+bool ArcEvictionPolicy::List::contains(const QString & _key) const
+{
+	return mTicks.contains(_key);
+}
+
+void ArcEvictionPolicy::List::push(const QString & _key, qint64 _size)
+{
+	remove(_key);
+	mTicks.insert(_key, ++mTick);
+	mOrder.insert(mTick, qMakePair(_key, _size));
+	bytes += _size;
+}
+
+qint64 ArcEvictionPolicy::List::remove(const QString & _key)
+{
+	QHash<QString, quint64>::iterator it = mTicks.find(_key);
+	if (it == mTicks.end())
+		return 0;
+
+	qint64 size = mOrder.take(it.value()).second;
+	mTicks.erase(it);
+	bytes -= size;
+	return size;
+}
+
+QString ArcEvictionPolicy::List::popOldest(qint64 * _size)
+{
+	if (mOrder.isEmpty())
+		return QString();
+
+	QString key = mOrder.first().first;
+	qint64 size = remove(key);
+	if (_size)
+		*_size = size;
+	return key;
+}
+
+bool ArcEvictionPolicy::List::isEmpty() const
+{
+	return mOrder.isEmpty();
+}
+
+void ArcEvictionPolicy::List::clear()
+{
+	mTicks.clear();
+	mOrder.clear();
+	bytes = 0;
+}
+
+ArcEvictionPolicy::ArcEvictionPolicy()
+	: mTarget(0)
+{
+}
+
+void ArcEvictionPolicy::inserted(const QString & _key, const PointBlock & _block)
+{
+	qint64 size = _block.footprint();
+
+	// a ghost hit: the list it was evicted from was too short, its share grows by the ratio of the ghost lists
+	if (mRecentGhosts.contains(_key))
+	{
+		qint64 delta = size * std::max<qint64>(1, mFrequentGhosts.bytes / std::max<qint64>(mRecentGhosts.bytes, 1));
+		mTarget = std::min(mBudget, mTarget + delta);
+		mRecentGhosts.remove(_key);
+		mFrequent.push(_key, size);
+	}
+	else if (mFrequentGhosts.contains(_key))
+	{
+		qint64 delta = size * std::max<qint64>(1, mRecentGhosts.bytes / std::max<qint64>(mFrequentGhosts.bytes, 1));
+		mTarget = std::max<qint64>(0, mTarget - delta);
+		mFrequentGhosts.remove(_key);
+		mFrequent.push(_key, size);
+	}
+	else
+		mRecent.push(_key, size);
+
+	trimGhosts();
+}
+
+void ArcEvictionPolicy::accessed(const QString & _key)
+{
+	qint64 size = mRecent.contains(_key) ? mRecent.remove(_key) : mFrequent.remove(_key);
+	mFrequent.push(_key, size);
+}
+
+void ArcEvictionPolicy::removed(const QString & _key)
+{
+	mRecent.remove(_key);
+	mFrequent.remove(_key);
+}
+
+void ArcEvictionPolicy::clear()
+{
+	mRecent.clear();
+	mFrequent.clear();
+	mRecentGhosts.clear();
+	mFrequentGhosts.clear();
+	mTarget = 0;
+}
+
+QString ArcEvictionPolicy::victim()
+{
+	// the blocks used once go while they hold more than their share, the evicted key is remembered as a ghost
+	bool recent = !mRecent.isEmpty() && (mRecent.bytes > mTarget || mFrequent.isEmpty());
+	List & list = recent ? mRecent : mFrequent;
+	List & ghosts = recent ? mRecentGhosts : mFrequentGhosts;
+	if (list.isEmpty())
+		return QString();
+
+	qint64 size = 0;
+	QString key = list.popOldest(&size);
+	ghosts.push(key, size);
+	trimGhosts();
+	return key;
+}
+
+void ArcEvictionPolicy::trimGhosts()
+{
+	// the ghosts remember about one budget of evicted blocks
+	while (mRecentGhosts.bytes + mFrequentGhosts.bytes > mBudget && !(mRecentGhosts.isEmpty() && mFrequentGhosts.isEmpty()))
+		(mRecentGhosts.bytes >= mFrequentGhosts.bytes ? mRecentGhosts : mFrequentGhosts).popOldest();
+}
+#pragma endregion
+
+#pragma region TrajectoryEvictionPolicy
+TrajectoryEvictionPolicy::TrajectoryEvictionPolicy()
+	: mTick(0)
+{
+}
+
+void TrajectoryEvictionPolicy::setFocus(const QVector<QPointF> & _focus)
+{
+	mFocus = _focus;
+}
+
+void TrajectoryEvictionPolicy::inserted(const QString & _key, const PointBlock & _block)
+{
+	// the middle of the block's extent stands for the patch
+	double
+		minX = std::numeric_limits<double>::max(), maxX = -minX,
+		minY = minX, maxY = -minX;
+	const float
+		* x = _block.x(),
+		* y = _block.y();
+	for (int i = 0; i < _block.count(); ++i)
+	{
+		minX = std::min<double>(minX, x[i]);
+		maxX = std::max<double>(maxX, x[i]);
+		minY = std::min<double>(minY, y[i]);
+		maxY = std::max<double>(maxY, y[i]);
+	}
+
+	Entry entry;
+	entry.x = _block.originX() + (_block.count() > 0 ? (minX + maxX) / 2 : 0);
+	entry.y = _block.originY() + (_block.count() > 0 ? (minY + maxY) / 2 : 0);
+	entry.tick = ++mTick;
+	mEntries.insert(_key, entry);
+}
+
+void TrajectoryEvictionPolicy::accessed(const QString & _key)
+{
+	QHash<QString, Entry>::iterator it = mEntries.find(_key);
+	if (it != mEntries.end())
+		it->tick = ++mTick;
+}
+
+void TrajectoryEvictionPolicy::removed(const QString & _key)
+{
+	mEntries.remove(_key);
+}
+
+void TrajectoryEvictionPolicy::clear()
+{
+	mEntries.clear();
+}
+
+QString TrajectoryEvictionPolicy::victim()
+{
+	// a scan over the shard, a few hundred blocks at most against a database fetch making room necessary
+	QHash<QString, Entry>::const_iterator victim = mEntries.constEnd();
+	double victimDistance = 0;
+	for (QHash<QString, Entry>::const_iterator it = mEntries.constBegin(); it != mEntries.constEnd(); ++it)
+	{
+		// blocks within reach of a focus are all alike, only their last use orders them
+		double distance = distanceToFocus(it.value());
+		if (distance <= PATCH_CACHE_FOCUS_REACH)
+			distance = 0;
+
+		if (victim == mEntries.constEnd() || distance > victimDistance || (distance == victimDistance && it->tick < victim->tick))
+		{
+			victim = it;
+			victimDistance = distance;
+		}
+	}
+
+	if (victim == mEntries.constEnd())
+		return QString();
+
+	QString key = victim.key();
+	mEntries.remove(key);
+	return key;
+}
+
+double TrajectoryEvictionPolicy::distanceToFocus(const Entry & _entry) const
+{
+	// without a focus every block is in reach, which makes this least recently used
+	double res = mFocus.isEmpty() ? 0 : std::numeric_limits<double>::max();
+	for (QVector<QPointF>::const_iterator it = mFocus.constBegin(); it != mFocus.constEnd(); ++it)
+		res = std::min(res, std::hypot(_entry.x - it->x(), _entry.y - it->y()));
+	return res;
+}
+#pragma endregion
\ No newline at end of file
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <QString>
+#include <QHash>
+#include <QMap>
+#include <QVector>
+#include <QPair>
+#include <QPointF>
+#include "ankadepthlibglobals.h"
+#include "pointblock.h"
+
+namespace AnkaDepthLib
+{
+	// decides which block of a PatchCache shard goes when the shard is over its byte budget. the shard calls it under
+	// its lock for every insert, hit and removal, so implementations need no locking of their own
+	class PatchEvictionPolicy
+	{
+	public:
+		virtual ~PatchEvictionPolicy();
+
+		static PatchEvictionPolicy * create(PatchCachePolicy _policy);
+
+		// bytes of the shard, for policies that size their history by it
+		virtual void setBudget(qint64 _bytes);
+
+		// recent positions of the tasks using the cache, for policies that keep blocks by their place
+		virtual void setFocus(const QVector<QPointF> & _focus);
+
+		virtual void inserted(const QString & _key, const PointBlock & _block) = 0;
+		virtual void accessed(const QString & _key) = 0;
+		virtual void removed(const QString & _key) = 0;
+		virtual void clear() = 0;
+
+		// the block to evict next, forgotten by the policy; an empty key if it holds none
+		virtual QString victim() = 0;
+
+	protected:
+		PatchEvictionPolicy();
+
+		qint64 mBudget;
+	};
+
+	// least recently used first
+	class LruEvictionPolicy : public PatchEvictionPolicy
+	{
+	public:
+		LruEvictionPolicy();
+
+		void inserted(const QString & _key, const PointBlock & _block) override;
+		void accessed(const QString & _key) override;
+		void removed(const QString & _key) override;
+		void clear() override;
+		QString victim() override;
+
+	private:
+		QHash<QString, quint64> mTicks;
+		QMap<quint64, QString> mRecency;
+		quint64 mTick;
+	};
+
+	// adaptive replacement: blocks used once and blocks used again are kept apart, and the ghost keys of the evicted
+	// ones move the split towards whichever list would have hit. a sweep of patches read once, e.g. a reprocess run
+	// crossing the area, then cannot push out the patches every pass over the area reuses
+	class ArcEvictionPolicy : public PatchEvictionPolicy
+	{
+	public:
+		ArcEvictionPolicy();
+
+		void inserted(const QString & _key, const PointBlock & _block) override;
+		void accessed(const QString & _key) override;
+		void removed(const QString & _key) override;
+		void clear() override;
+		QString victim() override;
+
+	private:
+		// keys with their sizes in recency order, oldest first
+		class List
+		{
+		public:
+			List();
+
+			bool contains(const QString & _key) const;
+			void push(const QString & _key, qint64 _size);
+			qint64 remove(const QString & _key);
+			QString popOldest(qint64 * _size = nullptr);
+			bool isEmpty() const;
+			void clear();
+
+			qint64 bytes;
+
+		private:
+			QHash<QString, quint64> mTicks;
+			QMap<quint64, QPair<QString, qint64>> mOrder;
+			quint64 mTick;
+		};
+
+		void trimGhosts();
+
+		List mRecent;		// cached, used once
+		List mFrequent;		// cached, used again
+		List mRecentGhosts;
+		List mFrequentGhosts;
+		qint64 mTarget;		// bytes of mRecent aimed at
+	};
+
+	// blocks far from where the tasks are now go first, nearest of the focus points being what counts; among the
+	// blocks still in reach of the focus the least recently used one goes
+	class TrajectoryEvictionPolicy : public PatchEvictionPolicy
+	{
+	public:
+		TrajectoryEvictionPolicy();
+
+		void setFocus(const QVector<QPointF> & _focus) override;
+
+		void inserted(const QString & _key, const PointBlock & _block) override;
+		void accessed(const QString & _key) override;
+		void removed(const QString & _key) override;
+		void clear() override;
+		QString victim() override;
+
+	private:
+		class Entry
+		{
+		public:
+			double x;
+			double y;
+			quint64 tick;
+		};
+
+		double distanceToFocus(const Entry & _entry) const;
+
+		QHash<QString, Entry> mEntries;
+		QVector<QPointF> mFocus;
+		quint64 mTick;
+	};
+}
\ No newline at end of file
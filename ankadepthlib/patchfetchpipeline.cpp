@@ -0,0 +1,104 @@
+#include "patchfetchpipeline.h"
+#include "ankadepthlibglobals.h"
+#include <QThread>
+
+using namespace AnkaDepthLib;
+
+PatchFetchPipeline::PatchFetchPipeline(PatchFetchPriority _priority)
+	:
+	mOutstanding(0),
+	mPriority(_priority)
+{
+}
+
+PatchFetchPipeline::~PatchFetchPipeline()
+{
+	// the jobs point back here
+	wait();
+}
+
+void PatchFetchPipeline::fetch(const std::function<void()> & _job)
+{
+	start(connectionPool(), _job);
+}
+
+void PatchFetchPipeline::decode(const std::function<void()> & _job)
+{
+	start(decodePool(), _job);
+}
+
+void PatchFetchPipeline::wait()
+{
+	QMutexLocker locker(&mMutex);
+	while (mOutstanding > 0)
+		mIdle.wait(&mMutex);
+}
+
+void PatchFetchPipeline::start(QThreadPool * _pool, const std::function<void()> & _job)
+{
+	// counted before it is queued, so a fetch job's decodes keep the pipeline busy past the fetch job's own end
+	{
+		QMutexLocker locker(&mMutex);
+		++mOutstanding;
+	}
+
+	_pool->start(new Job(this, _job), (int)mPriority);
+}
+
+void PatchFetchPipeline::finished()
+{
+	QMutexLocker locker(&mMutex);
+	if (--mOutstanding == 0)
+		mIdle.wakeAll();
+}
+
+QThreadPool * PatchFetchPipeline::connectionPool()
+{
+	// separate from the global pool which runs the tasks and from the executor's which runs their loops; its threads
+	// never expire, they hold the pooled connections
+	static QThreadPool pool;
+	static bool initialized = false;
+	static QMutex mutex;
+
+	QMutexLocker locker(&mutex);
+	if (!initialized)
+	{
+		pool.setMaxThreadCount(PATCH_FETCH_CONNECTIONS);
+		pool.setExpiryTimeout(-1);
+		initialized = true;
+	}
+
+	return &pool;
+}
+
+QThreadPool * PatchFetchPipeline::decodePool()
+{
+	static QThreadPool pool;
+	static bool initialized = false;
+	static QMutex mutex;
+
+	QMutexLocker locker(&mutex);
+	if (!initialized)
+	{
+		pool.setMaxThreadCount(std::max(QThread::idealThreadCount(), 1));
+		initialized = true;
+	}
+
+	return &pool;
+}
+
+#pragma region Job
+PatchFetchPipeline::Job::Job(PatchFetchPipeline * _pipeline, const std::function<void()> & _body)
+	:
+	mPipeline(_pipeline),
+	mBody(_body)
+{
+	setAutoDelete(true);
+}
+
+void PatchFetchPipeline::Job::run()
+{
+	mBody();
+	mPipeline->finished();
+}
+#pragma endregion
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <functional>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QMutex>
+#include <QWaitCondition>
+#include "ankadepthlibglobals.h"
+
+namespace AnkaDepthLib
+{
+	// runs the batches of a patch fetch on connection threads and the decoding of what they receive on decode threads,
+	// so packing and projecting the patches of one batch overlaps the round trips of the next. both pools belong to the
+	// process, the connection pool caps the database connections of all of its tasks together; the jobs of a pipeline
+	// queue at its priority, ahead of every job of a lower one
+	class PatchFetchPipeline
+	{
+	public:
+		PatchFetchPipeline(PatchFetchPriority _priority = PFP_TASK);
+		~PatchFetchPipeline();
+
+		// queues _job on a connection thread
+		void fetch(const std::function<void()> & _job);
+
+		// queues _job on a decode thread, e.g. from a fetch job for every patch it has received
+		void decode(const std::function<void()> & _job);
+
+		// returns once every queued job, and every job those queued, is done
+		void wait();
+
+	private:
+		class Job : public QRunnable
+		{
+		public:
+			Job(PatchFetchPipeline * _pipeline, const std::function<void()> & _body);
+			void run() override;
+
+		private:
+			PatchFetchPipeline * mPipeline;
+			std::function<void()> mBody;
+		};
+
+		void start(QThreadPool * _pool, const std::function<void()> & _job);
+		void finished();
+
+		static QThreadPool * connectionPool();
+		static QThreadPool * decodePool();
+
+		QMutex mMutex;
+		QWaitCondition mIdle;
+		int mOutstanding;
+		PatchFetchPriority mPriority;
+	};
+}
\ No newline at end of file
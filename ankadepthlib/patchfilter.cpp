@@ -0,0 +1,96 @@
+#include "patchfilter.h"
+#include <QDateTime>
+#include "transversemercator.h"
+
+using namespace AnkaDepthLib;
+
+PatchFilter::PatchFilter()
+	:
+	mNull(true),
+	mLon(0),
+	mLat(0),
+	mLonRadius(0),
+	mLatRadius(0)
+{
+}
+
+PatchFilter::PatchFilter(double _lon, double _lat, const QString & _timeStamp)
+	: PatchFilter()
+{
+	// the task stamp is a wall clock time, read and written back without any time zone conversion
+	QString iso = _timeStamp.trimmed();
+	iso.replace(' ', 'T');
+	QDateTime time = QDateTime::fromString(iso, Qt::ISODate);
+	if (!time.isValid())
+		return;
+	time.setTimeSpec(Qt::UTC);
+
+	qint64 msecs = time.toMSecsSinceEpoch();
+	msecs = (qint64)std::floor((double)msecs / PATCH_FILTER_TIME_STEP + 0.5) * PATCH_FILTER_TIME_STEP;
+
+	mLon = std::floor(_lon / PATCH_FILTER_CELL + 0.5) * PATCH_FILTER_CELL;
+	mLat = std::floor(_lat / PATCH_FILTER_CELL + 0.5) * PATCH_FILTER_CELL;
+	TransverseMercator::degreesPerMetre(mLat, mLonRadius, mLatRadius);
+	mLonRadius *= radius();
+	mLatRadius *= radius();
+	mTimeStamp = QDateTime::fromMSecsSinceEpoch(msecs, Qt::UTC).toString("yyyy-MM-dd hh:mm:ss.zzz");
+	mNull = false;
+}
+
+bool PatchFilter::isNull() const
+{
+	return mNull;
+}
+
+double PatchFilter::lon() const
+{
+	return mLon;
+}
+
+double PatchFilter::lat() const
+{
+	return mLat;
+}
+
+double PatchFilter::radius() const
+{
+	return MAX_DISTANCE + PATCH_FILTER_MARGIN;
+}
+
+double PatchFilter::lonMin() const
+{
+	return mLon - mLonRadius;
+}
+
+double PatchFilter::lonMax() const
+{
+	return mLon + mLonRadius;
+}
+
+double PatchFilter::latMin() const
+{
+	return mLat - mLatRadius;
+}
+
+double PatchFilter::latMax() const
+{
+	return mLat + mLatRadius;
+}
+
+QString PatchFilter::timeStamp() const
+{
+	return mTimeStamp;
+}
+
+double PatchFilter::timeWindow() const
+{
+	return PATCH_FILTER_TIME_WINDOW;
+}
+
+QString PatchFilter::key() const
+{
+	if (mNull)
+		return QString();
+
+	return QString("%1,%2,%3").arg(mLon, 0, 'f', 4).arg(mLat, 0, 'f', 4).arg(mTimeStamp);
+}
\ No newline at end of file
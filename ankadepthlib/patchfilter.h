@@ -0,0 +1,43 @@
+#pragma once
+
+#include <QString>
+#include "ankadepthlibglobals.h"
+
+namespace AnkaDepthLib
+{
+	// range and time window of the points a task needs from its patches. the centre is snapped to a PATCH_FILTER_CELL
+	// grid and the time to PATCH_FILTER_TIME_STEP, with the radius and window widened to cover the snapping, so nearby
+	// and consecutive panoramas ask for the same filtered view of a patch and share it in the cache
+	class PatchFilter
+	{
+	public:
+		// a null filter, the whole patch is fetched
+		PatchFilter();
+		PatchFilter(double _lon, double _lat, const QString & _timeStamp);
+
+		bool isNull() const;
+
+		double lon() const;
+		double lat() const;
+		double radius() const;
+
+		// geographic box that holds the radius around the centre, for filtering the patch's coordinates on the server
+		double lonMin() const;
+		double lonMax() const;
+		double latMin() const;
+		double latMax() const;
+		QString timeStamp() const;
+		double timeWindow() const;
+
+		// part of the patch cache key, empty for a null filter
+		QString key() const;
+
+	private:
+		bool mNull;
+		double mLon;
+		double mLat;
+		double mLonRadius;
+		double mLatRadius;
+		QString mTimeStamp;
+	};
+}
\ No newline at end of file
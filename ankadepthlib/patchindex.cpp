@@ -0,0 +1,333 @@
+#include "patchindex.h"
+#include "dbconnectionpool.h"
+#include "patchdiskcache.h"
+#include <QFile>
+#include <QSaveFile>
+#include <QDateTime>
+#include <QSqlQuery>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+
+using namespace AnkaDepthLib;
+
+PatchIndex::PatchIndex()
+	:
+	mRows(0),
+	mMaxId(0),
+	mReady(false),
+	mGeneration(0)
+{
+	mPool.setMaxThreadCount(1);
+}
+
+PatchIndex::~PatchIndex()
+{
+	// the job points back here
+	mPool.waitForDone();
+}
+
+void PatchIndex::reset(const TransverseMercator & _projection)
+{
+	restart(_projection);
+}
+
+void PatchIndex::prepare(const QString & _path, const TransverseMercator & _projection)
+{
+	// the table scan takes a while on a large pc_table, the candidates come from the database meanwhile
+	mPool.start(new Job(this, restart(_projection), _path, _projection));
+}
+
+void PatchIndex::add(int _id, double _lonMin, double _lonMax, double _latMin, double _latMax, double _time)
+{
+	QWriteLocker locker(&mLock);
+	mEntries.push_back(entryOf(mProjection, _id, _lonMin, _lonMax, _latMin, _latMax, _time));
+	insert(mCells, mEntries.last(), mEntries.count() - 1);
+	mReady = true;
+}
+
+bool PatchIndex::build(const TransverseMercator & _projection)
+{
+	return scan(restart(_projection), _projection);
+}
+
+bool PatchIndex::save(const QString & _path) const
+{
+	QReadLocker locker(&mLock);
+	if (!mReady || _path.isEmpty())
+		return false;
+
+	qint64 bytes = (qint64)mEntries.count() * sizeof(Entry);
+	Header header;
+	header.magic = Magic;
+	header.version = Version;
+	header.srid = mProjection.srid();
+	header.count = mEntries.count();
+	header.rows = mRows;
+	header.maxId = mMaxId;
+	header.checksum = PatchDiskCache::checksum(reinterpret_cast<const char *>(mEntries.constData()), bytes);
+
+	// the cells are rebuilt on load, the entries are the whole snapshot
+	QSaveFile file(_path);
+	return
+		file.open(QIODevice::WriteOnly) &&
+		file.write(reinterpret_cast<const char *>(&header), sizeof(header)) == sizeof(header) &&
+		file.write(reinterpret_cast<const char *>(mEntries.constData()), bytes) == bytes &&
+		file.commit();
+}
+
+bool PatchIndex::load(const QString & _path, const TransverseMercator & _projection)
+{
+	return read(restart(_projection), _path, _projection);
+}
+
+bool PatchIndex::isReady() const
+{
+	QReadLocker locker(&mLock);
+	return mReady;
+}
+
+int PatchIndex::count() const
+{
+	QReadLocker locker(&mLock);
+	return mEntries.count();
+}
+
+QVector<int> PatchIndex::candidates(double _x, double _y, double _radius, double _time, int _limit) const
+{
+	QReadLocker locker(&mLock);
+
+	// every entry of the cells under the circle's box, once
+	QVector<int> indices;
+	int
+		cxMin = (int)std::floor((_x - _radius) / PATCH_INDEX_CELL),
+		cxMax = (int)std::floor((_x + _radius) / PATCH_INDEX_CELL),
+		cyMin = (int)std::floor((_y - _radius) / PATCH_INDEX_CELL),
+		cyMax = (int)std::floor((_y + _radius) / PATCH_INDEX_CELL);
+	for (int cx = cxMin; cx <= cxMax; ++cx)
+		for (int cy = cyMin; cy <= cyMax; ++cy)
+		{
+			QHash<qint64, QVector<int>>::const_iterator it = mCells.constFind(cellKey(cx, cy));
+			if (it != mCells.constEnd())
+				indices += it.value();
+		}
+	std::sort(indices.begin(), indices.end());
+	indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+
+	// the box against the circle by the distance to its nearest point, then the time window
+	QVector<int> res;
+	for (QVector<int>::const_iterator it = indices.constBegin(); it != indices.constEnd(); ++it)
+	{
+		const Entry & entry = mEntries[*it];
+		double
+			dx = std::max(std::max(entry.xMin - _x, _x - entry.xMax), 0.0),
+			dy = std::max(std::max(entry.yMin - _y, _y - entry.yMax), 0.0);
+		if (dx * dx + dy * dy <= _radius * _radius && std::abs(entry.time - _time) < PATCH_TIME_WINDOW)
+			res.push_back(entry.id);
+	}
+
+	std::sort(res.begin(), res.end());
+	if (_limit >= 0 && res.count() > _limit)
+		res.resize(_limit);
+	return res;
+}
+
+double PatchIndex::secondsOf(const QString & _timeStamp)
+{
+	// like PatchFilter: a wall clock, read without any time zone conversion
+	QString iso = _timeStamp.trimmed();
+	iso.replace(' ', 'T');
+	QDateTime time = QDateTime::fromString(iso, Qt::ISODate);
+	if (!time.isValid())
+		return std::numeric_limits<double>::quiet_NaN();
+	time.setTimeSpec(Qt::UTC);
+
+	return time.toMSecsSinceEpoch() / 1000.0;
+}
+
+bool PatchIndex::tableState(qint64 & _rows, qint64 & _maxId)
+{
+	QSqlQuery query;
+	bool res =
+		DBConnectionPool::exec(DBR_POINT_CLOUD, "patch_index_state", "SELECT count(*), coalesce(max(id), 0) FROM pc_table", QVariantList(), query) &&
+		query.next();
+	if (res)
+	{
+		_rows = query.value(0).toLongLong();
+		_maxId = query.value(1).toLongLong();
+	}
+	query.finish();
+	return res;
+}
+
+qint64 PatchIndex::cellKey(int _cx, int _cy)
+{
+	return ((qint64)_cx << 32) | (quint32)_cy;
+}
+
+PatchIndex::Entry PatchIndex::entryOf(const TransverseMercator & _projection, int _id, double _lonMin, double _lonMax, double _latMin, double _latMax, double _time)
+{
+	// the box of the projected corners holds the projected patch box, curved by a few millimetres at this size
+	double
+		lon[4] = { _lonMin, _lonMax, _lonMin, _lonMax },
+		lat[4] = { _latMin, _latMin, _latMax, _latMax },
+		x[4], y[4];
+	_projection.forward(lon, lat, 4, x, y);
+
+	Entry res;
+	res.id = _id;
+	res.reserved = 0;
+	res.xMin = *std::min_element(x, x + 4);
+	res.xMax = *std::max_element(x, x + 4);
+	res.yMin = *std::min_element(y, y + 4);
+	res.yMax = *std::max_element(y, y + 4);
+	res.time = _time;
+	return res;
+}
+
+void PatchIndex::insert(QHash<qint64, QVector<int>> & _cells, const Entry & _entry, int _index)
+{
+	int
+		cxMin = (int)std::floor(_entry.xMin / PATCH_INDEX_CELL),
+		cxMax = (int)std::floor(_entry.xMax / PATCH_INDEX_CELL),
+		cyMin = (int)std::floor(_entry.yMin / PATCH_INDEX_CELL),
+		cyMax = (int)std::floor(_entry.yMax / PATCH_INDEX_CELL);
+	for (int cx = cxMin; cx <= cxMax; ++cx)
+		for (int cy = cyMin; cy <= cyMax; ++cy)
+			_cells[cellKey(cx, cy)].push_back(_index);
+}
+
+quint64 PatchIndex::restart(const TransverseMercator & _projection)
+{
+	QWriteLocker locker(&mLock);
+	mProjection = _projection;
+	mEntries.clear();
+	mCells.clear();
+	mRows = 0;
+	mMaxId = 0;
+	mReady = false;
+	return ++mGeneration;
+}
+
+bool PatchIndex::scan(quint64 _generation, const TransverseMercator & _projection)
+{
+	qint64 rows = 0, maxId = 0;
+	if (!tableState(rows, maxId))
+		return false;
+
+	// the bounds and times the candidate query computes per task, once for every patch; patches whose file name has
+	// no date never match it and are left out
+	static const QString qStr = "\
+		SELECT\
+		id,\
+		PC_PatchMin(pa, 'x'),\
+		PC_PatchMax(pa, 'x'),\
+		PC_PatchMin(pa, 'y'),\
+		PC_PatchMax(pa, 'y'),\
+		((PC_PatchMax(pa, 'gpstime') + PC_PatchMin(pa, 'gpstime')) / 2.0) / 1000000,\
+		(SELECT regexp_matches(filename, '(20[0-9]{2}.[0-9]{2}.[0-9]{2})', 'g'))[1]\
+		FROM pc_table\
+		";
+
+	QSqlQuery query;
+	if (!DBConnectionPool::exec(DBR_POINT_CLOUD, "patch_index", qStr, QVariantList(), query))
+		return false;
+
+	QVector<Entry> entries;
+	while (query.next())
+	{
+		// the date's separators are whatever the file name has
+		QString date = query.value(6).toString();
+		if (date.length() != 10)
+			continue;
+		date[4] = '-';
+		date[7] = '-';
+		double day = secondsOf(date + " 00:00:00");
+		if (std::isnan(day))
+			continue;
+
+		entries.push_back(entryOf(_projection,
+			query.value(0).toInt(),
+			query.value(1).toDouble(),
+			query.value(2).toDouble(),
+			query.value(3).toDouble(),
+			query.value(4).toDouble(),
+			day + query.value(5).toDouble()));
+	}
+	query.finish();
+
+	return publish(_generation, entries, rows, maxId);
+}
+
+bool PatchIndex::read(quint64 _generation, const QString & _path, const TransverseMercator & _projection)
+{
+	QFile file(_path);
+	if (_path.isEmpty() || !file.open(QIODevice::ReadOnly))
+		return false;
+
+	QByteArray data = file.readAll();
+	file.close();
+	if (data.size() < (int)sizeof(Header))
+		return false;
+
+	// the file itself first, the table is asked only for a whole snapshot of this zone
+	Header header;
+	memcpy(&header, data.constData(), sizeof(header));
+	const char * payload = data.constData() + sizeof(Header);
+	qint64 bytes = (qint64)header.count * sizeof(Entry);
+	qint64 rows = 0, maxId = 0;
+	bool valid =
+		header.magic == Magic &&
+		header.version == Version &&
+		header.srid == _projection.srid() &&
+		header.count >= 0 &&
+		data.size() == (qint64)sizeof(Header) + bytes &&
+		PatchDiskCache::checksum(payload, bytes) == header.checksum &&
+		tableState(rows, maxId) &&
+		header.rows == rows &&
+		header.maxId == maxId;
+	if (!valid)
+		return false;
+
+	QVector<Entry> entries(header.count);
+	memcpy(entries.data(), payload, (size_t)bytes);
+	return publish(_generation, entries, rows, maxId);
+}
+
+bool PatchIndex::publish(quint64 _generation, QVector<Entry> & _entries, qint64 _rows, qint64 _maxId)
+{
+	QHash<qint64, QVector<int>> cells;
+	for (int i = 0; i < _entries.count(); ++i)
+		insert(cells, _entries[i], i);
+
+	QWriteLocker locker(&mLock);
+	if (_generation != mGeneration)
+		return false;
+
+	mEntries.swap(_entries);
+	mCells.swap(cells);
+	mRows = _rows;
+	mMaxId = _maxId;
+	mReady = true;
+	return true;
+}
+
+#pragma region Job
+PatchIndex::Job::Job(PatchIndex * _index, quint64 _generation, const QString & _path, const TransverseMercator & _projection)
+	:
+	mIndex(_index),
+	mGeneration(_generation),
+	mPath(_path),
+	mProjection(_projection)
+{
+	setAutoDelete(true);
+}
+
+void PatchIndex::Job::run()
+{
+	// the snapshot while pc_table is unchanged, otherwise the table, snapshotted for the next start
+	if (!mIndex->read(mGeneration, mPath, mProjection) && mIndex->scan(mGeneration, mProjection))
+		mIndex->save(mPath);
+}
+#pragma endregion
\ No newline at end of file
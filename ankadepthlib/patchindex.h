@@ -0,0 +1,122 @@
+#pragma once
+
+#include <QString>
+#include <QHash>
+#include <QVector>
+#include <QReadWriteLock>
+#include <QRunnable>
+#include <QThreadPool>
+#include "ankadepthlibglobals.h"
+#include "transversemercator.h"
+
+namespace AnkaDepthLib
+{
+	// the worker's copy of what the candidate patch query asks pc_table for: every patch's bounding box and mean time,
+	// bucketed by its UTM box in a PATCH_INDEX_CELL grid. built once per configuration from the table, or read back
+	// from a snapshot taken of it while the table still has the same rows. build and load fill the entries and the grid
+	// aside and swap them in whole, a query sees either no index or all of it
+	class PatchIndex
+	{
+	public:
+		static constexpr quint32 Magic = 0x49504e41; // "ANPI"
+		static constexpr quint32 Version = 2;
+
+		PatchIndex();
+		~PatchIndex();
+
+		// empties the index for patches projected to _projection's zone, a load or build still running is discarded
+		void reset(const TransverseMercator & _projection);
+
+		// empties the index and loads the snapshot at _path, or builds the index and snapshots it there, on a thread
+		// of its own; the index is not ready until then
+		void prepare(const QString & _path, const TransverseMercator & _projection);
+
+		// a patch with its geographic bounds and its mean time in seconds of the wall clock, for an index filled by
+		// hand; it is ready with its first patch
+		void add(int _id, double _lonMin, double _lonMax, double _latMin, double _latMax, double _time);
+
+		// reads every patch from pc_table over the calling thread's pooled connection
+		bool build(const TransverseMercator & _projection);
+
+		// the snapshot carries the table state it was built from and a checksum of its entries, load refuses it for
+		// another state or zone and when the entries do not match the checksum
+		bool save(const QString & _path) const;
+		bool load(const QString & _path, const TransverseMercator & _projection);
+
+		bool isReady() const;
+		int count() const;
+
+		// the candidate patch query: ids of the patches whose box comes within _radius metres of (_x, _y) and whose
+		// mean time is less than PATCH_TIME_WINDOW seconds from _time, lowest ids first, at most _limit of them
+		QVector<int> candidates(double _x, double _y, double _radius, double _time, int _limit) const;
+
+		// the wall clock of a task stamp in seconds, without a time zone like the dates of the patch files; NaN if the
+		// stamp cannot be read
+		static double secondsOf(const QString & _timeStamp);
+
+		// row count and highest id of pc_table, which a snapshot has to match
+		static bool tableState(qint64 & _rows, qint64 & _maxId);
+
+	private:
+		class Entry
+		{
+		public:
+			qint32 id;
+			qint32 reserved;
+			double xMin;
+			double xMax;
+			double yMin;
+			double yMax;
+			double time;
+		};
+
+		class Header
+		{
+		public:
+			quint32 magic;
+			quint32 version;
+			qint32 srid;
+			qint32 count;
+			qint64 rows;
+			qint64 maxId;
+			quint64 checksum;
+		};
+
+		class Job : public QRunnable
+		{
+		public:
+			Job(PatchIndex * _index, quint64 _generation, const QString & _path, const TransverseMercator & _projection);
+			void run() override;
+
+		private:
+			PatchIndex * mIndex;
+			quint64 mGeneration;
+			QString mPath;
+			TransverseMercator mProjection;
+		};
+
+		static qint64 cellKey(int _cx, int _cy);
+		static Entry entryOf(const TransverseMercator & _projection, int _id, double _lonMin, double _lonMax, double _latMin, double _latMax, double _time);
+		static void insert(QHash<qint64, QVector<int>> & _cells, const Entry & _entry, int _index);
+
+		// empties the index and starts a new generation of it, returned
+		quint64 restart(const TransverseMercator & _projection);
+
+		// the build and the load of a generation; neither swaps its entries in once another generation has started
+		bool scan(quint64 _generation, const TransverseMercator & _projection);
+		bool read(quint64 _generation, const QString & _path, const TransverseMercator & _projection);
+		bool publish(quint64 _generation, QVector<Entry> & _entries, qint64 _rows, qint64 _maxId);
+
+		TransverseMercator mProjection;
+		QVector<Entry> mEntries;
+		QHash<qint64, QVector<int>> mCells;
+		qint64 mRows;
+		qint64 mMaxId;
+		bool mReady;
+		quint64 mGeneration;
+		mutable QReadWriteLock mLock;
+
+		// one thread, the preparations run in the order they were asked for
+		QThreadPool mPool;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,262 @@
+#include "patchprefetcher.h"
+#include "dbpatchbufferer.h"
+#include "patchfilter.h"
+#include "patchindex.h"
+#include <QDateTime>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace AnkaDepthLib;
+
+PatchPrefetcher::Frame::Frame()
+	:
+	taskId(0),
+	lon(0),
+	lat(0),
+	x(0),
+	y(0),
+	time(std::numeric_limits<double>::quiet_NaN())
+{
+}
+
+PatchPrefetcher::PatchPrefetcher()
+	:
+	mConfig(nullptr),
+	mFrames(0),
+	mConcurrency(1),
+	mRunning(0)
+{
+	// the candidate queries run over the pool threads' own connections, kept for as long as the threads
+	mPool.setMaxThreadCount(mConcurrency);
+	mPool.setExpiryTimeout(-1);
+}
+
+PatchPrefetcher::~PatchPrefetcher()
+{
+	// the jobs point back here
+	clear();
+}
+
+void PatchPrefetcher::configure(DepthConfiguration * _config)
+{
+	QMutexLocker locker(&mMutex);
+	mConfig = _config;
+	mFrames = std::max(mConfig->patchPrefetchFrames(), 0);
+	mConcurrency = std::max(mConfig->patchPrefetchConcurrency(), 1);
+	mPool.setMaxThreadCount(mConcurrency);
+
+	// the frames waiting were extrapolated and filtered under the previous configuration
+	mWaiting.clear();
+	mDrives.clear();
+}
+
+void PatchPrefetcher::schedule(DepthTask & _task)
+{
+	Frame frame = frameOf(_task);
+
+	QMutexLocker locker(&mMutex);
+	if (!mConfig || mFrames <= 0)
+		return;
+
+	// the queued tasks' own frames go ahead of every extrapolated one, in the order the tasks came
+	int at = 0;
+	while (at < mWaiting.count() && mWaiting[at].taskId > 0)
+		++at;
+	mWaiting.insert(at, frame);
+
+	// the filtered views of a frame are keyed by the task's own position, extrapolated frames only pay off for
+	// whole patches
+	if (mConfig->patchFetchMode() == PFM_FULL)
+	{
+		Drive & drive = mDrives[frame.drive];
+		QVector<Frame> ahead = extrapolate(drive.last, frame, mFrames);
+		drive.last = frame;
+
+		if (!ahead.isEmpty())
+		{
+			// the drive's frames still waiting are replaced by the ones stepped on from its latest position, and
+			// positions loaded before are skipped: at a steady pace the same frames come out again
+			for (QList<Frame>::iterator it = mWaiting.begin(); it != mWaiting.end();)
+			{
+				if (it->taskId == 0 && it->drive == frame.drive)
+					it = mWaiting.erase(it);
+				else
+					++it;
+			}
+
+			double tolerance = std::hypot(ahead.first().x - frame.x, ahead.first().y - frame.y) / 2.0;
+			for (QVector<Frame>::const_iterator it = ahead.constBegin(); it != ahead.constEnd(); ++it)
+			{
+				bool covered = false;
+				for (QVector<QPointF>::const_iterator point = drive.covered.constBegin(); !covered && point != drive.covered.constEnd(); ++point)
+					covered = std::hypot(point->x() - it->x, point->y() - it->y) < tolerance;
+				if (!covered)
+					mWaiting.push_back(*it);
+			}
+
+			// at most a window of extrapolated frames waits per drive, the furthest ahead go first
+			int extrapolated = 0;
+			for (QList<Frame>::const_iterator it = mWaiting.constBegin(); it != mWaiting.constEnd(); ++it)
+				extrapolated += it->taskId == 0 && it->drive == frame.drive;
+			for (int i = mWaiting.count() - 1; i >= 0 && extrapolated > mFrames; --i)
+			{
+				if (mWaiting[i].taskId == 0 && mWaiting[i].drive == frame.drive)
+				{
+					mWaiting.removeAt(i);
+					--extrapolated;
+				}
+			}
+		}
+	}
+
+	dispatch();
+}
+
+void PatchPrefetcher::started(int _taskId)
+{
+	QMutexLocker locker(&mMutex);
+	for (QList<Frame>::iterator it = mWaiting.begin(); it != mWaiting.end(); ++it)
+	{
+		if (it->taskId == _taskId)
+		{
+			mWaiting.erase(it);
+			break;
+		}
+	}
+}
+
+void PatchPrefetcher::clear()
+{
+	QMutexLocker locker(&mMutex);
+	mWaiting.clear();
+	mDrives.clear();
+	while (mRunning > 0)
+		mIdle.wait(&mMutex);
+}
+
+int PatchPrefetcher::waiting() const
+{
+	QMutexLocker locker(&mMutex);
+	return mWaiting.count();
+}
+
+int PatchPrefetcher::running() const
+{
+	QMutexLocker locker(&mMutex);
+	return mRunning;
+}
+
+PatchPrefetcher::Frame PatchPrefetcher::frameOf(DepthTask & _task)
+{
+	Frame frame;
+	frame.taskId = _task.id();
+	frame.drive = QString("%1/%2").arg(_task.parentDir()).arg(_task.subDir());
+	frame.lon = _task.longtitude();
+	frame.lat = _task.latitude();
+	frame.x = _task.x();
+	frame.y = _task.y();
+	frame.timeStamp = _task.timeStamp();
+	frame.time = PatchIndex::secondsOf(frame.timeStamp);
+	return frame;
+}
+
+QVector<PatchPrefetcher::Frame> PatchPrefetcher::extrapolate(const Frame & _previous, const Frame & _last, int _count)
+{
+	QVector<Frame> res;
+	if (_previous.taskId <= 0 || _previous.taskId == _last.taskId || _previous.drive != _last.drive)
+		return res;
+
+	// the worker's next frame of the drive is as far on as its last one was from the one before: a run of the drive
+	// comes frame by frame, a worker sharing the drive with others gets every few frames, either way along it
+	double
+		dLon = _last.lon - _previous.lon,
+		dLat = _last.lat - _previous.lat,
+		dx = _last.x - _previous.x,
+		dy = _last.y - _previous.y,
+		dt = _last.time - _previous.time,
+		step = std::hypot(dx, dy);
+	if (std::isnan(dt) || dt == 0 || !(step > 0) || step > PATCH_PREFETCH_MAX_STEP)
+		return res;
+
+	for (int i = 1; i <= _count; ++i)
+	{
+		Frame frame = _last;
+		frame.taskId = 0;
+		frame.lon += dLon * i;
+		frame.lat += dLat * i;
+		frame.x += dx * i;
+		frame.y += dy * i;
+		frame.time += dt * i;
+		frame.timeStamp = QDateTime::fromMSecsSinceEpoch((qint64)std::llround(frame.time * 1000.0), Qt::UTC).toString("yyyy-MM-dd HH:mm:ss.zzz");
+		res.push_back(frame);
+	}
+
+	return res;
+}
+
+void PatchPrefetcher::dispatch()
+{
+	while (mRunning < mConcurrency && !mWaiting.isEmpty())
+	{
+		Frame frame = mWaiting.takeFirst();
+		if (frame.taskId == 0)
+		{
+			QVector<QPointF> & covered = mDrives[frame.drive].covered;
+			covered.push_back(QPointF(frame.x, frame.y));
+			if (covered.count() > mFrames * 2)
+				covered.remove(0);
+		}
+
+		++mRunning;
+		mPool.start(new Job(this, frame));
+	}
+}
+
+void PatchPrefetcher::finished()
+{
+	QMutexLocker locker(&mMutex);
+	--mRunning;
+	dispatch();
+	if (mRunning == 0)
+		mIdle.wakeAll();
+}
+
+void PatchPrefetcher::load(const Frame & _frame)
+{
+	DepthConfiguration * config = nullptr;
+	{
+		QMutexLocker locker(&mMutex);
+		config = mConfig;
+	}
+	if (!config)
+		return;
+
+	// what DepthTaskWorker::loadPoints would ask for; frames it would turn down for too few patches load nothing
+	QVector<int> patchIds;
+	if (!DBPatchBufferer::candidatePatches(_frame.lon, _frame.lat, _frame.timeStamp, config->patchLimit(), patchIds) ||
+		patchIds.count() < config->patchThreshold())
+		return;
+
+	PatchFilter filter;
+	if (_frame.taskId > 0 && config->patchFetchMode() == PFM_FILTERED)
+		filter = PatchFilter(_frame.lon, _frame.lat, _frame.timeStamp);
+
+	DBPatchBufferer::loadPatches(patchIds, filter, nullptr, nullptr, PFP_PREFETCH);
+}
+
+#pragma region Job
+PatchPrefetcher::Job::Job(PatchPrefetcher * _prefetcher, const Frame & _frame)
+	:
+	mPrefetcher(_prefetcher),
+	mFrame(_frame)
+{
+	setAutoDelete(true);
+}
+
+void PatchPrefetcher::Job::run()
+{
+	mPrefetcher->load(mFrame);
+	mPrefetcher->finished();
+}
+#pragma endregion
\ No newline at end of file
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <QString>
+#include <QList>
+#include <QHash>
+#include <QVector>
+#include <QPointF>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QMutex>
+#include <QWaitCondition>
+#include "ankadepthlibglobals.h"
+#include "depthconfiguration.h"
+#include "depthtask.h"
+
+namespace AnkaDepthLib
+{
+	// loads the patches of the frames a worker is about to render before they reach a thread: the tasks it has queued
+	// and, when whole patches are fetched, the next frames of each drive stepped on from its last two. the loads go
+	// through the patch cache, so a task arriving while its frame is being prefetched waits for that load instead of
+	// starting its own. they run on a pool of their own, capped apart from the tasks, and their batches wait for a fetch
+	// connection behind those of the tasks
+	class PatchPrefetcher
+	{
+	public:
+		// where a frame is and when, with the id of its task or 0 for an extrapolated one
+		class Frame
+		{
+		public:
+			Frame();
+
+			int taskId;
+			QString drive;
+			double lon;
+			double lat;
+			double x;
+			double y;
+			double time;
+			QString timeStamp;
+		};
+
+		PatchPrefetcher();
+		~PatchPrefetcher();
+
+		// the frames extrapolated ahead of each drive and the loads running at once; zero frames turns it off
+		void configure(DepthConfiguration * _config);
+
+		// a task queued on the worker: its own frame is prefetched, and the drive it is on is extrapolated past it
+		void schedule(DepthTask & _task);
+
+		// the task reached a thread and loads its own patches, its frame is dropped if it is still waiting
+		void started(int _taskId);
+
+		// drops the waiting frames and the drives, and returns once the loads in flight are done
+		void clear();
+
+		int waiting() const;
+		int running() const;
+
+		static Frame frameOf(DepthTask & _task);
+
+		// the _count frames after _last on the drive through _previous and _last, the two the worker got of it last, as
+		// far apart in space and time as those two; the task ids do not matter, a Hilbert run may walk a drive against
+		// them. none if they are on different drives, at the same time, or further apart than PATCH_PREFETCH_MAX_STEP
+		static QVector<Frame> extrapolate(const Frame & _previous, const Frame & _last, int _count);
+
+	private:
+		class Drive
+		{
+		public:
+			Frame last;		// the drive's frame the worker got last
+			QVector<QPointF> covered;	// extrapolated positions already queued, the latest last
+		};
+
+		class Job : public QRunnable
+		{
+		public:
+			Job(PatchPrefetcher * _prefetcher, const Frame & _frame);
+			void run() override;
+
+		private:
+			PatchPrefetcher * mPrefetcher;
+			Frame mFrame;
+		};
+
+		// hands waiting frames to the pool up to the concurrency; under the mutex
+		void dispatch();
+		void finished();
+
+		// the candidate patches of the frame through the cache, with the filter its task would use
+		void load(const Frame & _frame);
+
+		mutable QMutex mMutex;
+		QWaitCondition mIdle;
+		QThreadPool mPool;
+		QList<Frame> mWaiting;
+		QHash<QString, Drive> mDrives;
+		DepthConfiguration * mConfig;
+		int mFrames;
+		int mConcurrency;
+		int mRunning;
+	};
+}
\ No newline at end of file
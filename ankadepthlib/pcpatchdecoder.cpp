@@ -0,0 +1,260 @@
+#include "pcpatchdecoder.h"
+#include <QXmlStreamReader>
+#include <QtEndian>
+#include <QVector>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+using namespace AnkaDepthLib;
+
+// endian byte, pcid, compression and point count
+#define PC_WKB_HEADER_SIZE	13
+#define PC_NONE				0
+
+PcPatchDecoder::Dimension::Dimension()
+	:
+	position(0),
+	byteOffset(-1),
+	size(0),
+	interpretation(UNKNOWN),
+	scale(1),
+	offset(0)
+{
+}
+
+PcPatchDecoder::PcPatchDecoder()
+	:
+	mValid(false),
+	mPcid(0),
+	mSrid(0),
+	mPointSize(0)
+{
+}
+
+PcPatchDecoder::PcPatchDecoder(int _pcid, int _srid, const QString & _schema)
+	: PcPatchDecoder()
+{
+	mPcid = _pcid;
+	mSrid = _srid;
+
+	QVector<Dimension> dims;
+	Dimension dim;
+	bool inDimension = false;
+	QXmlStreamReader xml(_schema);
+	while (!xml.atEnd())
+	{
+		xml.readNext();
+		if (xml.isStartElement())
+		{
+			QStringRef name = xml.name();
+			if (name == QLatin1String("dimension"))
+			{
+				dim = Dimension();
+				inDimension = true;
+			}
+			else if (inDimension && name == QLatin1String("position"))
+				dim.position = xml.readElementText().toInt();
+			else if (inDimension && name == QLatin1String("size"))
+				dim.size = xml.readElementText().toInt();
+			else if (inDimension && name == QLatin1String("name"))
+				dim.name = xml.readElementText().trimmed();
+			else if (inDimension && name == QLatin1String("interpretation"))
+				dim.interpretation = interpretationOf(xml.readElementText().trimmed());
+			else if (inDimension && name == QLatin1String("scale"))
+				dim.scale = xml.readElementText().toDouble();
+			else if (inDimension && name == QLatin1String("offset"))
+				dim.offset = xml.readElementText().toDouble();
+		}
+		else if (xml.isEndElement() && xml.name() == QLatin1String("dimension"))
+		{
+			dims.push_back(dim);
+			inDimension = false;
+		}
+	}
+	if (xml.hasError() || dims.isEmpty())
+		return;
+
+	// the dimensions are packed in position order without padding
+	std::sort(dims.begin(), dims.end(), [](const Dimension & _l, const Dimension & _r) { return _l.position < _r.position; });
+	for (QVector<Dimension>::iterator it = dims.begin(); it != dims.end(); ++it)
+	{
+		if (it->size <= 0)
+			return;
+
+		it->byteOffset = mPointSize;
+		mPointSize += it->size;
+
+		if (it->name.compare("X", Qt::CaseInsensitive) == 0)
+			mX = *it;
+		else if (it->name.compare("Y", Qt::CaseInsensitive) == 0)
+			mY = *it;
+		else if (it->name.compare("Z", Qt::CaseInsensitive) == 0)
+			mZ = *it;
+		else if (it->name.compare("GpsTime", Qt::CaseInsensitive) == 0)
+			mTime = *it;
+		else if (it->name.compare("Intensity", Qt::CaseInsensitive) == 0)
+			mIntensity = *it;
+	}
+
+	mValid = isReadable(mX) && isReadable(mY) && isReadable(mZ) && isReadable(mTime) && isReadable(mIntensity);
+}
+
+bool PcPatchDecoder::isValid() const
+{
+	return mValid;
+}
+
+int PcPatchDecoder::pcid() const
+{
+	return mPcid;
+}
+
+int PcPatchDecoder::srid() const
+{
+	return mSrid;
+}
+
+int PcPatchDecoder::pointSize() const
+{
+	return mPointSize;
+}
+
+int PcPatchDecoder::pcidOf(const QByteArray & _wkb)
+{
+	if (_wkb.size() < PC_WKB_HEADER_SIZE)
+		return -1;
+
+	const char * p = _wkb.constData();
+	return (int)(p[0] ? qFromLittleEndian<quint32>(p + 1) : qFromBigEndian<quint32>(p + 1));
+}
+
+int PcPatchDecoder::pointCountOf(const QByteArray & _wkb)
+{
+	if (_wkb.size() < PC_WKB_HEADER_SIZE)
+		return -1;
+
+	const char * p = _wkb.constData();
+	return (int)(p[0] ? qFromLittleEndian<quint32>(p + 9) : qFromBigEndian<quint32>(p + 9));
+}
+
+bool PcPatchDecoder::decode(const QByteArray & _wkb, const TransverseMercator & _projection, PointBlockBuilder & _builder) const
+{
+	if (!mValid || _wkb.size() < PC_WKB_HEADER_SIZE)
+		return false;
+
+	const char * p = _wkb.constData();
+	bool bigEndian = p[0] == 0;
+	quint32
+		pcid = bigEndian ? qFromBigEndian<quint32>(p + 1) : qFromLittleEndian<quint32>(p + 1),
+		compression = bigEndian ? qFromBigEndian<quint32>(p + 5) : qFromLittleEndian<quint32>(p + 5),
+		count = bigEndian ? qFromBigEndian<quint32>(p + 9) : qFromLittleEndian<quint32>(p + 9);
+
+	if ((int)pcid != mPcid || compression != PC_NONE || _wkb.size() < PC_WKB_HEADER_SIZE + (qint64)count * mPointSize)
+		return false;
+
+	// geographic coordinates are projected here, coordinates of the target zone are taken as they are
+	bool geographic = mSrid == 4326;
+	if (!geographic && mSrid != _projection.srid())
+		return false;
+
+	// the coordinates are gathered first so they are projected in one batch
+	QVector<double> x((int)count), y((int)count);
+	p += PC_WKB_HEADER_SIZE;
+	const char * points = p;
+	for (quint32 i = 0; i < count; ++i, p += mPointSize)
+	{
+		x[i] = read(p, mX, bigEndian);
+		y[i] = read(p, mY, bigEndian);
+	}
+	if (geographic)
+		_projection.forward(x.constData(), y.constData(), x.count(), x.data(), y.data());
+
+	p = points;
+	for (quint32 i = 0; i < count; ++i, p += mPointSize)
+		_builder.append(x[i], y[i], read(p, mZ, bigEndian), std::llround(read(p, mTime, bigEndian)), (int)read(p, mIntensity, bigEndian));
+
+	return true;
+}
+
+double PcPatchDecoder::read(const char * _point, const Dimension & _dim, bool _bigEndian)
+{
+	const char * p = _point + _dim.byteOffset;
+	double v = 0;
+	switch (_dim.interpretation)
+	{
+	case INT8:
+		v = *reinterpret_cast<const qint8 *>(p);
+		break;
+	case UINT8:
+		v = *reinterpret_cast<const quint8 *>(p);
+		break;
+	case INT16:
+		v = _bigEndian ? qFromBigEndian<qint16>(p) : qFromLittleEndian<qint16>(p);
+		break;
+	case UINT16:
+		v = _bigEndian ? qFromBigEndian<quint16>(p) : qFromLittleEndian<quint16>(p);
+		break;
+	case INT32:
+		v = _bigEndian ? qFromBigEndian<qint32>(p) : qFromLittleEndian<qint32>(p);
+		break;
+	case UINT32:
+		v = _bigEndian ? qFromBigEndian<quint32>(p) : qFromLittleEndian<quint32>(p);
+		break;
+	case INT64:
+		v = (double)(_bigEndian ? qFromBigEndian<qint64>(p) : qFromLittleEndian<qint64>(p));
+		break;
+	case UINT64:
+		v = (double)(_bigEndian ? qFromBigEndian<quint64>(p) : qFromLittleEndian<quint64>(p));
+		break;
+	case FLOAT:
+	{
+		quint32 bits = _bigEndian ? qFromBigEndian<quint32>(p) : qFromLittleEndian<quint32>(p);
+		float f = 0;
+		memcpy(&f, &bits, sizeof(f));
+		v = f;
+		break;
+	}
+	case DOUBLE:
+	{
+		quint64 bits = _bigEndian ? qFromBigEndian<quint64>(p) : qFromLittleEndian<quint64>(p);
+		memcpy(&v, &bits, sizeof(v));
+		break;
+	}
+	default:
+		break;
+	}
+
+	return v * _dim.scale + _dim.offset;
+}
+
+bool PcPatchDecoder::isReadable(const Dimension & _dim)
+{
+	static const int sizes[] = { 1, 1, 2, 2, 4, 4, 8, 8, 4, 8, 0 };
+	return _dim.byteOffset >= 0 && _dim.interpretation != UNKNOWN && _dim.size == sizes[_dim.interpretation];
+}
+
+PcPatchDecoder::Interpretation PcPatchDecoder::interpretationOf(const QString & _name)
+{
+	if (_name == "int8_t")
+		return INT8;
+	if (_name == "uint8_t")
+		return UINT8;
+	if (_name == "int16_t")
+		return INT16;
+	if (_name == "uint16_t")
+		return UINT16;
+	if (_name == "int32_t")
+		return INT32;
+	if (_name == "uint32_t")
+		return UINT32;
+	if (_name == "int64_t")
+		return INT64;
+	if (_name == "uint64_t")
+		return UINT64;
+	if (_name == "float")
+		return FLOAT;
+	if (_name == "double")
+		return DOUBLE;
+	return UNKNOWN;
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <QString>
+#include <QByteArray>
+#include "pointblock.h"
+#include "transversemercator.h"
+
+namespace AnkaDepthLib
+{
+	// reads the points of an uncompressed pgpointcloud patch (the WKB of PC_Uncompress) with the layout of its
+	// pointcloud_formats schema, instead of exploding the patch into rows on the database server
+	class PcPatchDecoder
+	{
+	public:
+		// an invalid decoder
+		PcPatchDecoder();
+
+		// the schema document and srid of a pointcloud_formats row; valid if it has readable X, Y, Z, GpsTime and
+		// Intensity dimensions
+		PcPatchDecoder(int _pcid, int _srid, const QString & _schema);
+
+		bool isValid() const;
+		int pcid() const;
+		int srid() const;
+		int pointSize() const;
+
+		// header fields of a patch WKB, -1 if it is too short
+		static int pcidOf(const QByteArray & _wkb);
+		static int pointCountOf(const QByteArray & _wkb);
+
+		// appends the points of an uncompressed patch to _builder in UTM coordinates of _projection; the schema's
+		// coordinates must be geographic (4326) or already of the projection's zone
+		bool decode(const QByteArray & _wkb, const TransverseMercator & _projection, PointBlockBuilder & _builder) const;
+
+	private:
+		enum Interpretation
+		{
+			INT8,
+			UINT8,
+			INT16,
+			UINT16,
+			INT32,
+			UINT32,
+			INT64,
+			UINT64,
+			FLOAT,
+			DOUBLE,
+			UNKNOWN
+		};
+
+		class Dimension
+		{
+		public:
+			Dimension();
+
+			int position;
+			int byteOffset;
+			int size;
+			Interpretation interpretation;
+			double scale;
+			double offset;
+			QString name;
+		};
+
+		// scaled value of a dimension of the point at _point
+		static double read(const char * _point, const Dimension & _dim, bool _bigEndian);
+		static Interpretation interpretationOf(const QString & _name);
+
+		// a dimension of the schema with a known interpretation of the right size
+		static bool isReadable(const Dimension & _dim);
+
+		bool mValid;
+		int mPcid;
+		int mSrid;
+		int mPointSize;
+		Dimension mX;
+		Dimension mY;
+		Dimension mZ;
+		Dimension mTime;
+		Dimension mIntensity;
+	};
+}
\ No newline at end of file
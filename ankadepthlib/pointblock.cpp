@@ -0,0 +1,247 @@
+#include "pointblock.h"
+#include <climits>
+#include <cstring>
+
+using namespace AnkaDepthLib;
+
+#pragma region PointBlockStorage
+PointBlockStorage::~PointBlockStorage()
+{
+}
+
+QSharedPointer<PointBlockStorage> PointBlockStorage::cached(const QSharedPointer<PointBlockStorage> & _self) const
+{
+	return _self;
+}
+
+QSharedPointer<PointBlockStorage> PointBlockStorage::pinned(const QSharedPointer<PointBlockStorage> & _self) const
+{
+	return _self;
+}
+
+qint64 PointBlockStorage::footprint() const
+{
+	return size();
+}
+
+PointBlockHeapStorage::PointBlockHeapStorage(const QByteArray & _data)
+	: mData(_data)
+{
+}
+
+const char * PointBlockHeapStorage::data() const
+{
+	return mData.constData();
+}
+
+qint64 PointBlockHeapStorage::size() const
+{
+	return mData.size();
+}
+
+PointBlockMappedStorage::PointBlockMappedStorage(QFile * _file, uchar * _map, qint64 _offset, qint64 _size)
+	:
+	mFile(_file),
+	mMap(_map),
+	mOffset(_offset),
+	mSize(_size)
+{
+}
+
+PointBlockMappedStorage::~PointBlockMappedStorage()
+{
+	mFile->unmap(mMap);
+	mFile->close();
+	delete mFile;
+}
+
+const char * PointBlockMappedStorage::data() const
+{
+	return reinterpret_cast<const char *>(mMap + mOffset);
+}
+
+qint64 PointBlockMappedStorage::size() const
+{
+	return mSize;
+}
+#pragma endregion
+
+#pragma region PointBlock
+PointBlock::PointBlock()
+	:
+	mHeader(nullptr),
+	mX(nullptr),
+	mY(nullptr),
+	mZ(nullptr),
+	mTime(nullptr),
+	mIntensity(nullptr)
+{
+}
+
+PointBlock::PointBlock(QSharedPointer<PointBlockStorage> _storage)
+	: PointBlock()
+{
+	if (_storage.isNull() || _storage->size() < HeaderSize)
+		return;
+
+	const Header * header = reinterpret_cast<const Header *>(_storage->data());
+	if (header->magic != Magic || _storage->size() < byteSize(header->count))
+		return;
+
+	int n = header->count;
+	const char * arrays = _storage->data() + HeaderSize;
+	mStorage = _storage;
+	mHeader = header;
+	mX = reinterpret_cast<const float *>(arrays);
+	mY = mX + n;
+	mZ = mY + n;
+	mTime = reinterpret_cast<const qint32 *>(mZ + n);
+	mIntensity = reinterpret_cast<const quint16 *>(mTime + n);
+}
+
+bool PointBlock::isValid() const
+{
+	return mHeader != nullptr;
+}
+
+int PointBlock::count() const
+{
+	return mHeader ? mHeader->count : 0;
+}
+
+double PointBlock::originX() const
+{
+	return mHeader ? mHeader->originX : 0;
+}
+
+double PointBlock::originY() const
+{
+	return mHeader ? mHeader->originY : 0;
+}
+
+double PointBlock::originZ() const
+{
+	return mHeader ? mHeader->originZ : 0;
+}
+
+qint64 PointBlock::timeOrigin() const
+{
+	return mHeader ? mHeader->timeOrigin : 0;
+}
+
+LidarPoint PointBlock::point(int _index) const
+{
+	return LidarPoint(
+		mHeader->originX + mX[_index],
+		mHeader->originY + mY[_index],
+		mHeader->originZ + mZ[_index],
+		mHeader->timeOrigin + mTime[_index],
+		mIntensity[_index]
+	);
+}
+
+qint64 PointBlock::byteSize() const
+{
+	return byteSize(count());
+}
+
+QSharedPointer<PointBlockStorage> PointBlock::storage() const
+{
+	return mStorage;
+}
+
+PointBlock PointBlock::cached() const
+{
+	if (mStorage.isNull())
+		return *this;
+
+	QSharedPointer<PointBlockStorage> storage = mStorage->cached(mStorage);
+	return storage == mStorage ? *this : PointBlock(storage);
+}
+
+PointBlock PointBlock::pinned() const
+{
+	if (mStorage.isNull())
+		return *this;
+
+	QSharedPointer<PointBlockStorage> storage = mStorage->pinned(mStorage);
+	if (storage.isNull())
+		return PointBlock();
+	return storage == mStorage ? *this : PointBlock(storage);
+}
+
+qint64 PointBlock::footprint() const
+{
+	return mStorage.isNull() ? 0 : mStorage->footprint();
+}
+
+qint64 PointBlock::byteSize(int _count)
+{
+	// padded to 8 bytes so packed blocks can follow each other
+	qint64 size = HeaderSize + (qint64)_count * (3 * sizeof(float) + sizeof(qint32) + sizeof(quint16));
+	return (size + 7) & ~(qint64)7;
+}
+#pragma endregion
+
+#pragma region PointBlockBuilder
+PointBlockBuilder::PointBlockBuilder(int _reserve)
+	:
+	mHasOrigin(false),
+	mTimeOrigin(0)
+{
+	mOrigin[0] = mOrigin[1] = mOrigin[2] = 0;
+
+	mX.reserve(_reserve);
+	mY.reserve(_reserve);
+	mZ.reserve(_reserve);
+	mTime.reserve(_reserve);
+	mIntensity.reserve(_reserve);
+}
+
+void PointBlockBuilder::append(double _x, double _y, double _z, qint64 _time, int _intensity)
+{
+	if (!mHasOrigin)
+	{
+		mOrigin[0] = _x;
+		mOrigin[1] = _y;
+		mOrigin[2] = _z;
+		mTimeOrigin = _time;
+		mHasOrigin = true;
+	}
+
+	// a patch spans metres and seconds: float offsets keep micrometres, int32 keeps the gps time ticks
+	mX.push_back((float)(_x - mOrigin[0]));
+	mY.push_back((float)(_y - mOrigin[1]));
+	mZ.push_back((float)(_z - mOrigin[2]));
+	mTime.push_back((qint32)std::max(std::min(_time - mTimeOrigin, (qint64)INT_MAX), (qint64)INT_MIN));
+	mIntensity.push_back((quint16)std::max(std::min(_intensity, 65535), 0));
+}
+
+int PointBlockBuilder::count() const
+{
+	return mX.count();
+}
+
+PointBlock PointBlockBuilder::build() const
+{
+	int n = mX.count();
+	QByteArray data(PointBlock::byteSize(n), 0);
+
+	PointBlock::Header * header = reinterpret_cast<PointBlock::Header *>(data.data());
+	header->magic = PointBlock::Magic;
+	header->count = n;
+	header->originX = mOrigin[0];
+	header->originY = mOrigin[1];
+	header->originZ = mOrigin[2];
+	header->timeOrigin = mTimeOrigin;
+
+	char * p = data.data() + PointBlock::HeaderSize;
+	memcpy(p, mX.constData(), n * sizeof(float));
+	memcpy(p += n * sizeof(float), mY.constData(), n * sizeof(float));
+	memcpy(p += n * sizeof(float), mZ.constData(), n * sizeof(float));
+	memcpy(p += n * sizeof(float), mTime.constData(), n * sizeof(qint32));
+	memcpy(p += n * sizeof(qint32), mIntensity.constData(), n * sizeof(quint16));
+
+	return PointBlock(QSharedPointer<PointBlockStorage>(new PointBlockHeapStorage(data)));
+}
+#pragma endregion
\ No newline at end of file
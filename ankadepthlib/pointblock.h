@@ -0,0 +1,145 @@
+#pragma once
+
+#include <QVector>
+#include <QByteArray>
+#include <QSharedPointer>
+#include <QFile>
+#include "lidarpoint.h"
+
+namespace AnkaDepthLib
+{
+	// packed bytes of a point block, shared by every copy of the block
+	class PointBlockStorage
+	{
+	public:
+		virtual ~PointBlockStorage();
+		virtual const char * data() const = 0;
+		virtual qint64 size() const = 0;
+
+		// what a cache keeps of the bytes and what a reader holds while using them, _self both times unless the bytes
+		// live somewhere that reclaims them: then the cache keeps a handle and the reader a pinned view, null once the
+		// bytes are gone
+		virtual QSharedPointer<PointBlockStorage> cached(const QSharedPointer<PointBlockStorage> & _self) const;
+		virtual QSharedPointer<PointBlockStorage> pinned(const QSharedPointer<PointBlockStorage> & _self) const;
+		// bytes of this process held by the storage
+		virtual qint64 footprint() const;
+	};
+
+	class PointBlockHeapStorage : public PointBlockStorage
+	{
+	public:
+		PointBlockHeapStorage(const QByteArray & _data);
+		const char * data() const override;
+		qint64 size() const override;
+
+	private:
+		QByteArray mData;
+	};
+
+	// bytes of a memory mapped file, unmapped and closed with the last block using them
+	class PointBlockMappedStorage : public PointBlockStorage
+	{
+	public:
+		// takes the open file and its mapping; the block bytes are _size bytes at _offset of the mapping
+		PointBlockMappedStorage(QFile * _file, uchar * _map, qint64 _offset, qint64 _size);
+		~PointBlockMappedStorage();
+		const char * data() const override;
+		qint64 size() const override;
+
+	private:
+		QFile * mFile;
+		uchar * mMap;
+		qint64 mOffset;
+		qint64 mSize;
+	};
+
+	// structure-of-arrays patch of lidar points in a single buffer: a fixed header with the block origin, then float
+	// offsets from the origin for x, y and z, int32 time offsets and uint16 intensities. 18 bytes per point instead of
+	// the 64 of a LidarPoint, and copies share the buffer instead of duplicating it
+	class PointBlock
+	{
+	public:
+		static constexpr quint32 Magic = 0x4b424e41; // "ANBK"
+		static constexpr int HeaderSize = 64;
+
+		PointBlock();
+
+		// wraps a packed buffer, e.g. from PointBlockBuilder or a cache file; invalid if the header does not match its size
+		PointBlock(QSharedPointer<PointBlockStorage> _storage);
+
+		bool isValid() const;
+		int count() const;
+
+		double originX() const;
+		double originY() const;
+		double originZ() const;
+		qint64 timeOrigin() const;
+
+		inline const float * x() const { return mX; }
+		inline const float * y() const { return mY; }
+		inline const float * z() const { return mZ; }
+		inline const qint32 * timeOffsets() const { return mTime; }
+		inline const quint16 * intensities() const { return mIntensity; }
+
+		LidarPoint point(int _index) const;
+
+		qint64 byteSize() const;
+		QSharedPointer<PointBlockStorage> storage() const;
+
+		// the block as a cache keeps it, only its footprint may be asked for until it is pinned again
+		PointBlock cached() const;
+		// the block as a reader uses it, invalid if the bytes of a cached handle were reclaimed
+		PointBlock pinned() const;
+		// what a cache charges for the block
+		qint64 footprint() const;
+
+		static qint64 byteSize(int _count);
+
+	private:
+		class Header
+		{
+		public:
+			quint32 magic;
+			quint32 count;
+			double originX;
+			double originY;
+			double originZ;
+			qint64 timeOrigin;
+			char reserved[PointBlock::HeaderSize - 40];
+		};
+
+		QSharedPointer<PointBlockStorage> mStorage;
+		const Header * mHeader;
+		const float * mX;
+		const float * mY;
+		const float * mZ;
+		const qint32 * mTime;
+		const quint16 * mIntensity;
+
+		friend class PointBlockBuilder;
+	};
+
+	// collects the rows of a patch query and packs them into a PointBlock, the first point becomes the origin
+	class PointBlockBuilder
+	{
+	public:
+		PointBlockBuilder(int _reserve = 0);
+
+		void append(double _x, double _y, double _z, qint64 _time, int _intensity);
+		int count() const;
+
+		PointBlock build() const;
+
+	private:
+		bool mHasOrigin;
+		double mOrigin[3];
+		qint64 mTimeOrigin;
+		QVector<float> mX;
+		QVector<float> mY;
+		QVector<float> mZ;
+		QVector<qint32> mTime;
+		QVector<quint16> mIntensity;
+	};
+
+	typedef QVector<PointBlock> PointBlockVector;
+}
\ No newline at end of file
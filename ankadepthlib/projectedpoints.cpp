@@ -0,0 +1,66 @@
+#include "projectedpoints.h"
+#include "ankadepthlibglobals.h"
+#include "sphericalprojector.h"
+
+using namespace AnkaDepthLib;
+
+ProjectedPoints::ProjectedPoints()
+{
+}
+
+void ProjectedPoints::clear()
+{
+	mR.clear();
+	mX.clear();
+	mY.clear();
+}
+
+void ProjectedPoints::reserve(int _count)
+{
+	mR.reserve(_count);
+	mX.reserve(_count);
+	mY.reserve(_count);
+}
+
+void ProjectedPoints::append(const PointBlock & _block, const LidarPoint & _center, double _heading)
+{
+	int n = _block.count(), o = mR.count();
+	mR.resize(o + n);
+	mX.resize(o + n);
+	mY.resize(o + n);
+
+	SphericalProjector::project(_block, _center, _heading, (int)W, (int)H, mR.data() + o, mX.data() + o, mY.data() + o);
+}
+
+void ProjectedPoints::permute(const int * _targets, int _count)
+{
+	QVector<float> r(_count);
+	QVector<int> x(_count), y(_count);
+	const float * srcR = mR.constData();
+	const int * srcX = mX.constData(), * srcY = mY.constData();
+	float * dstR = r.data();
+	int * dstX = x.data(), * dstY = y.data();
+	for (int i = 0, t = 0; i < mR.count(); ++i)
+	{
+		if ((t = _targets[i]) < 0)
+			continue;
+
+		dstR[t] = srcR[i];
+		dstX[t] = srcX[i];
+		dstY[t] = srcY[i];
+	}
+
+	mR.swap(r);
+	mX.swap(x);
+	mY.swap(y);
+}
+
+int ProjectedPoints::count() const
+{
+	return mR.count();
+}
+
+qint64 ProjectedPoints::byteSize() const
+{
+	return (qint64)mR.count() * (sizeof(float) + 2 * sizeof(int));
+}
\ No newline at end of file
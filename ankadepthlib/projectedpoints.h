@@ -0,0 +1,38 @@
+#pragma once
+
+#include <QVector>
+#include "lidarpoint.h"
+#include "pointblock.h"
+
+namespace AnkaDepthLib
+{
+	// per task scratch: distance and panorama pixel of the points of a set of point blocks as seen from the task's centre,
+	// stored as separate arrays; the blocks themselves stay shared and untouched
+	class ProjectedPoints
+	{
+	public:
+		ProjectedPoints();
+
+		void clear();
+		void reserve(int _count);
+
+		// appends the points of _block the way LidarPoint::faceTo(_center, _heading) and get2D_X/get2D_Y project them
+		// onto the W x H panorama, through the SphericalProjector
+		void append(const PointBlock & _block, const LidarPoint & _center, double _heading);
+
+		// moves point i to _targets[i] of arrays of _count points, points with a negative target are dropped
+		void permute(const int * _targets, int _count);
+
+		int count() const;
+		qint64 byteSize() const;
+
+		inline const float * r() const { return mR.constData(); }
+		inline const int * x() const { return mX.constData(); }
+		inline const int * y() const { return mY.constData(); }
+
+	private:
+		QVector<float> mR;
+		QVector<int> mX;
+		QVector<int> mY;
+	};
+}
\ No newline at end of file
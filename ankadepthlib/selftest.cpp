@@ -0,0 +1,1441 @@
+#include "selftest.h"
+#include "ankadepthlibglobals.h"
+#include "closingfilter.h"
+#include "panoramabuffer.h"
+#include "holefiller.h"
+#include "groundregenerator.h"
+#include "parallelexecutor.h"
+#include "pointblock.h"
+#include "projectedpoints.h"
+#include "sphericalprojector.h"
+#include "distancebuckets.h"
+#include "transversemercator.h"
+#include "pcpatchdecoder.h"
+#include "patchdiskcache.h"
+#include "sharedpatcharena.h"
+#include "patchcache.h"
+#include "patchfetchpipeline.h"
+#include "patchevictionpolicy.h"
+#include "patchindex.h"
+#include "patchprefetcher.h"
+#include "taskrunscheduler.h"
+#include "gridframe.h"
+#include "timerwheel.h"
+#include "depthtask.h"
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <QMap>
+#include <QPoint>
+#include <QSet>
+#include <QScopedPointer>
+#include <QThread>
+
+using namespace AnkaDepthLib;
+
+namespace
+{
+	// UTM zone 35N references: the origin, the meridian arc to 45 degrees and points across the zone, which two
+	// independent series (Krueger and Redfearn) agree on within half a millimetre
+	const double TMReferences[][4] =
+	{
+		{ 27.0, 0.0, 500000.0000, 0.0000 },
+		{ 27.0, 45.0, 500000.0000, 4982950.4002 },
+		{ 28.9784, 41.0082, 666370.5050, 4541552.4872 },
+		{ 26.5, 39.75, 457164.8119, 4400129.7793 },
+		{ 29.9, 36.2, 760742.5067, 4010030.9000 },
+		{ 24.1, 42.0, 259818.0048, 4653845.2766 },
+		{ 30.0, 40.0, 756099.6480, 4432069.0569 }
+	};
+
+	// block of a few points around a UTM position
+	PointBlock blockAt(double _x, double _y, int _count)
+	{
+		PointBlockBuilder builder(_count);
+		for (int i = 0; i < _count; ++i)
+			builder.append(_x + i, _y - i, 100.0, 0, 0);
+		return builder.build();
+	}
+
+	// block of _count points scattered over the range around a UTM position within a minute of drive time
+	PointBlock randomBlock(cv::RNG & _rng, int _count)
+	{
+		PointBlockBuilder builder(_count);
+		for (int i = 0; i < _count; ++i)
+			builder.append(
+				500000.0 + _rng.uniform(-MAX_DISTANCE, MAX_DISTANCE),
+				4500000.0 + _rng.uniform(-MAX_DISTANCE, MAX_DISTANCE),
+				1000.0 + _rng.uniform(-5.0, 5.0),
+				1565000000000LL + _rng.uniform(0, 60000000),
+				_rng.uniform(0, 65536));
+		return builder.build();
+	}
+
+	// sparse depth image resembling a single distance slice
+	cv::Mat sparseDepthImage(int _rows, int _cols, double _density, cv::RNG & _rng)
+	{
+		cv::Mat img(_rows, _cols, CV_32FC1, cv::Scalar(0));
+		int count = (int)(_rows * _cols * _density);
+		for (int i = 0; i < count; ++i)
+			img.at<float>(_rng.uniform(0, _rows), _rng.uniform(0, _cols)) = _rng.uniform(0.5f, MAX_DISTANCE);
+		return img;
+	}
+}
+
+SelfTest::SelfTest()
+{
+}
+
+bool SelfTest::run(QStringList & _report)
+{
+	bool res = true;
+	res &= closingFilter(_report);
+	res &= panoramaBuffer(_report);
+	res &= holeFiller(_report);
+	res &= groundRegenerator(_report);
+	res &= parallelExecutor(_report);
+	res &= pointBlock(_report);
+	res &= sphericalProjector(_report);
+	res &= distanceBuckets(_report);
+	res &= transverseMercator(_report);
+	res &= pcPatchDecoder(_report);
+	res &= patchDiskCache(_report);
+	res &= sharedPatchArena(_report);
+	res &= patchCache(_report);
+	res &= patchEvictionPolicy(_report);
+	res &= patchIndex(_report);
+	res &= patchPrefetcher(_report);
+	res &= taskRunScheduler(_report);
+	res &= gridFrame(_report);
+	res &= timerWheel(_report);
+	return res;
+}
+
+bool SelfTest::closingFilter(QStringList & _report)
+{
+	bool res = true;
+	cv::RNG rng(0x414e4b41);
+	cv::TickMeter tm;
+	cv::Mat img = sparseDepthImage((int)H / 2, (int)W / 2, 0.002, rng);
+
+	// every kernel size the slice loop uses, from the farthest slice to the nearest
+	for (int sz = 1; sz <= 13; sz += 2)
+	{
+		cv::Mat ref, out;
+
+		tm.reset();
+		tm.start();
+		cv::morphologyEx(img, ref, cv::MORPH_CLOSE, cv::Mat::ones(sz, sz, CV_32FC1), cv::Point(-1, -1), sz);
+		tm.stop();
+		double tRef = tm.getTimeMilli();
+
+		tm.reset();
+		tm.start();
+		ClosingFilter::close(img, out, ClosingFilter::equivalentRadius(sz, sz), false);
+		tm.stop();
+		double tOut = tm.getTimeMilli();
+
+		bool exact = cv::norm(ref, out, cv::NORM_INF) == 0;
+		res &= exact;
+		_report << QString("ClosingFilter sz=%1: %2, morphologyEx %3 ms, ClosingFilter %4 ms")
+			.arg(sz)
+			.arg(exact ? "exact" : "MISMATCH")
+			.arg(tRef, 0, 'f', 2)
+			.arg(tOut, 0, 'f', 2);
+	}
+
+	// wrapped closing must match the centre of the image tiled three times side by side
+	int radius = ClosingFilter::equivalentRadius(13, 13);
+	cv::Mat tiled, ref, out;
+	cv::hconcat(std::vector<cv::Mat>{ img, img, img }, tiled);
+	ClosingFilter::close(tiled, ref, radius, false);
+	ClosingFilter::close(img, out, radius, true);
+
+	bool exact = cv::norm(ref.colRange(img.cols, 2 * img.cols), out, cv::NORM_INF) == 0;
+	res &= exact;
+	_report << QString("ClosingFilter seam wrap: %1").arg(exact ? "exact" : "MISMATCH");
+
+	return res;
+}
+
+bool SelfTest::panoramaBuffer(QStringList & _report)
+{
+	cv::RNG rng(0x414e4b41);
+	cv::Mat img = sparseDepthImage((int)H, (int)W, 0.01, rng), back;
+	PanoramaBuffer buffer;
+	buffer.fromMat(img);
+	buffer.toMat(back);
+
+	bool roundTrip = cv::norm(img, back, cv::NORM_INF) == 0;
+	_report << QString("PanoramaBuffer round trip: %1").arg(roundTrip ? "exact" : "MISMATCH");
+
+	// columns wrap around the seam, rows beyond the poles are empty
+	int h = buffer.halo();
+	cv::Mat padded;
+	cv::copyMakeBorder(img, padded, h, h, h, h, cv::BORDER_WRAP);
+	padded.rowRange(0, h) = 0;
+	padded.rowRange(padded.rows - h, padded.rows) = 0;
+
+	cv::TickMeter tm;
+	tm.start();
+	buffer.syncHalo();
+	tm.stop();
+
+	bool halo = true;
+	for (int i = 0; halo && i < buffer.tileCount(); ++i)
+	{
+		cv::Rect rect = buffer.tileRect(i);
+		halo = cv::norm(padded(cv::Rect(rect.x, rect.y, rect.width + 2 * h, rect.height + 2 * h)), buffer.tile(i), cv::NORM_INF) == 0;
+	}
+	_report << QString("PanoramaBuffer halo: %1, syncHalo %2 ms").arg(halo ? "exact" : "MISMATCH").arg(tm.getTimeMilli(), 0, 'f', 2);
+
+	return roundTrip && halo;
+}
+
+bool SelfTest::holeFiller(QStringList & _report)
+{
+	bool res = true, interrupted = false;
+	cv::RNG rng(0x414e4b41);
+	cv::TickMeter tm;
+	int firstRow = 100.0 * H / 180.0, size = 4;
+
+	// sparse far field up to the poles; the scan wraps the last rows' neighbours to the top rows like the original one
+	cv::Mat img = sparseDepthImage((int)H, (int)W, 0.05, rng);
+
+	// reference scan: in place and row-major
+	cv::Mat scanRef = img.clone();
+	tm.start();
+	for (int r = firstRow; r < scanRef.rows; r++)
+	{
+		for (int c = 0; c < scanRef.cols; c++)
+		{
+			if (scanRef.at<float>(r, c) == 0)
+				scanRef.at<float>(r, c) = averageDistance(scanRef, r, c, size);
+		}
+	}
+	tm.stop();
+	double tRef = tm.getTimeMilli();
+
+	// reference without order dependence: every hole from the original image only, with empty rows past the poles
+	cv::Mat areaRef = img.clone(), poles;
+	cv::copyMakeBorder(img, poles, size / 2, size / 2, 0, 0, cv::BORDER_CONSTANT, cv::Scalar(0));
+	for (int r = firstRow; r < areaRef.rows; r++)
+	{
+		for (int c = 0; c < areaRef.cols; c++)
+		{
+			if (img.at<float>(r, c) == 0)
+				areaRef.at<float>(r, c) = averageDistance(poles, r + size / 2, c, size);
+		}
+	}
+
+	PanoramaBuffer buffer;
+	cv::Mat out;
+
+	buffer.fromMat(img);
+	tm.reset();
+	tm.start();
+	HoleFiller::fillScan(buffer, firstRow, size, interrupted);
+	tm.stop();
+	buffer.toMat(out);
+	bool exact = cv::norm(scanRef, out, cv::NORM_INF) == 0;
+	res &= exact;
+	_report << QString("HoleFiller scan: %1, averageDistance %2 ms, HoleFiller %3 ms")
+		.arg(exact ? "exact" : "MISMATCH")
+		.arg(tRef, 0, 'f', 2)
+		.arg(tm.getTimeMilli(), 0, 'f', 2);
+
+	buffer.fromMat(img);
+	tm.reset();
+	tm.start();
+	HoleFiller::fillSummedArea(buffer, firstRow, size, interrupted);
+	tm.stop();
+	buffer.toMat(out);
+	double err = cv::norm(areaRef, out, cv::NORM_INF);
+	res &= err < 1e-4;
+	_report << QString("HoleFiller summed-area: max error %1, HoleFiller %2 ms")
+		.arg(err, 0, 'g', 3)
+		.arg(tm.getTimeMilli(), 0, 'f', 2);
+
+	return res;
+}
+
+bool SelfTest::groundRegenerator(QStringList & _report)
+{
+	bool interrupted = false;
+	cv::TickMeter tm;
+	double
+		camHeight = DEFAULT_CAM_OFFSET,
+		heading = 180.0 + 0.8,
+		pitch = 1.3,
+		roll = -0.6,
+		phiPerPix = 180.0 / H,
+		thetaPerPix = 360.0 / W;
+	LidarPoint center(500000.0, 4500000.0, 1000.0);
+
+	// the original loop, in a UTM sized frame
+	cv::Mat ref((int)H, (int)W, CV_32FC1, cv::Scalar(0));
+	cv::Mat rotMat = rotationMatrix(heading, pitch, roll);
+	tm.start();
+	for (double y = H - 1.0; y > H / 2.0; y--)
+	{
+		double
+			phiInv = deg2rad(180.0 - y * phiPerPix),
+			phi = deg2rad(y * phiPerPix);
+		float d = camHeight / cos(phiInv);
+		for (double x = 0; x < W; x++)
+		{
+			double theta = deg2rad(x * thetaPerPix);
+			if (y * phiPerPix > (GROUND_ASSERTION_MIN_ANGLE + abs(cos(theta)) * VISION_CURVE))
+			{
+				cv::Mat rotated = rotMat * (
+					cv::Mat_<double>(3, 1) <<
+					camHeight / cos(phiInv) * sin(phi) * cos(theta),
+					camHeight / cos(phiInv) * sin(phi) * sin(theta),
+					camHeight / cos(phiInv) * cos(phi)
+					);
+				LidarPoint p(rotated.at<double>(0) + center.X, rotated.at<double>(1) + center.Y, rotated.at<double>(2) + center.Z);
+				p.faceTo(center);
+				ref.at<float>(p.get2D_Y(H), p.get2D_X(W)) = d;
+			}
+		}
+	}
+	tm.stop();
+	double tRef = tm.getTimeMilli();
+
+	PanoramaBuffer buffer;
+	cv::Mat out;
+	GroundRegenerator::clearCache();
+	tm.reset();
+	tm.start();
+	GroundRegenerator::regenerate(buffer, camHeight, heading, pitch, roll, 0, interrupted);
+	tm.stop();
+	double tCold = tm.getTimeMilli();
+
+	buffer.fill(0);
+	tm.reset();
+	tm.start();
+	GroundRegenerator::regenerate(buffer, camHeight, heading, pitch, roll, 0, interrupted);
+	tm.stop();
+	buffer.toMat(out);
+
+	// the original reprojects through UTM coordinates, whose rounding may move a pixel sitting exactly on a border
+	int
+		written = cv::countNonZero(ref),
+		mismatch = cv::countNonZero(ref != out);
+	bool res = mismatch <= written / 10000;
+	_report << QString("GroundRegenerator: %1 of %2 pixels differ, original %3 ms, GroundRegenerator %4 ms, cached %5 ms")
+		.arg(mismatch)
+		.arg(written)
+		.arg(tRef, 0, 'f', 2)
+		.arg(tCold, 0, 'f', 2)
+		.arg(tm.getTimeMilli(), 0, 'f', 2);
+
+	GroundRegenerator::clearCache();
+	return res;
+}
+
+bool SelfTest::parallelExecutor(QStringList & _report)
+{
+	bool interrupted = false;
+	cv::RNG rng(0x414e4b41);
+	cv::TickMeter tm;
+	int threads = QThread::idealThreadCount();
+
+	ParallelExecutor::setParallelism(threads);
+	QVector<int> hits(100003, 0);
+	ParallelExecutor::parallelFor(hits.count(), [&](int _begin, int _end)
+	{
+		for (int i = _begin; i < _end; ++i)
+			++hits[i];
+	}, 97);
+	bool once = hits.count(1) == hits.count();
+	_report << QString("ParallelExecutor coverage: %1").arg(once ? "exact" : "MISMATCH");
+
+	// summed-area hole filling, serial and on every core
+	cv::Mat img = sparseDepthImage((int)H, (int)W, 0.05, rng), serial, parallel;
+	PanoramaBuffer buffer;
+	double t[2] = { 0, 0 };
+	for (int i = 0; i < 2; ++i)
+	{
+		ParallelExecutor::setParallelism(i == 0 ? 1 : threads);
+		buffer.fromMat(img);
+		tm.reset();
+		tm.start();
+		HoleFiller::fillSummedArea(buffer, (int)(100.0 * H / 180.0), 4, interrupted);
+		tm.stop();
+		t[i] = tm.getTimeMilli();
+		buffer.toMat(i == 0 ? serial : parallel);
+	}
+	ParallelExecutor::setParallelism(1);
+
+	bool exact = cv::norm(serial, parallel, cv::NORM_INF) == 0;
+	_report << QString("ParallelExecutor hole filling: %1, 1 thread %2 ms, %3 threads %4 ms")
+		.arg(exact ? "exact" : "MISMATCH")
+		.arg(t[0], 0, 'f', 2)
+		.arg(threads)
+		.arg(t[1], 0, 'f', 2);
+
+	return once && exact;
+}
+
+bool SelfTest::pointBlock(QStringList & _report)
+{
+	cv::RNG rng(0x414e4b41);
+	LidarPoint center(500000.0, 4500000.0, 1000.0);
+	double heading = 37.5;
+	int count = 100000;
+
+	// a patch around the centre, in UTM sized coordinates
+	LidarPointVector points;
+	PointBlockBuilder builder(count);
+	for (int i = 0; i < count; ++i)
+	{
+		LidarPoint p(
+			center.X + rng.uniform(-MAX_DISTANCE, MAX_DISTANCE),
+			center.Y + rng.uniform(-MAX_DISTANCE, MAX_DISTANCE),
+			center.Z + rng.uniform(-5.0, 5.0),
+			1565000000000LL + rng.uniform(0, 60000000),
+			rng.uniform(0, 65536)
+		);
+		points.push_back(p);
+		builder.append(p.X, p.Y, p.Z, p.Time, p.Intensity);
+	}
+	PointBlock block = builder.build();
+
+	double err = 0;
+	bool exact = block.count() == count;
+	for (int i = 0; exact && i < count; ++i)
+	{
+		LidarPoint p = block.point(i);
+		err = std::max(err, std::max(std::abs(p.X - points[i].X), std::max(std::abs(p.Y - points[i].Y), std::abs(p.Z - points[i].Z))));
+		exact = p.Time == points[i].Time && p.Intensity == points[i].Intensity;
+	}
+	bool roundTrip = exact && err < 1e-4;
+	_report << QString("PointBlock round trip: max position error %1 m, %2 bytes per point instead of %3")
+		.arg(err, 0, 'g', 3)
+		.arg(block.byteSize() / (double)count, 0, 'f', 2)
+		.arg(sizeof(LidarPoint));
+
+	// pixels may only differ where a point sits on a pixel border within the float precision and the atan2 error
+	ProjectedPoints projected;
+	projected.append(block, center, heading);
+	int mismatch = 0;
+	for (int i = 0; i < count; ++i)
+	{
+		LidarPoint & p = points[i];
+		p.faceTo(center, heading);
+		if (p.get2D_X(W) != projected.x()[i] || p.get2D_Y(H) != projected.y()[i])
+			++mismatch;
+	}
+	bool pixels = mismatch <= count / 200;
+	_report << QString("ProjectedPoints: %1 of %2 pixels differ from faceTo").arg(mismatch).arg(count);
+
+	return roundTrip && pixels;
+}
+
+bool SelfTest::sphericalProjector(QStringList & _report)
+{
+	cv::RNG rng(0x414e4b41);
+	cv::TickMeter tm;
+	LidarPoint center(500000.0, 4500000.0, 1000.0);
+	double heading = 212.25;
+	int count = 1000000;
+
+	// the approximation over a full turn, against half a pixel of the panorama
+	double err = 0, halfPixel = 0.5 * 360.0 / W;
+	for (int i = 0; i < 3600000; ++i)
+	{
+		double a = deg2rad(i / 10000.0 - 180.0);
+		float x = (float)(17.3 * cos(a)), y = (float)(17.3 * sin(a));
+		double e = std::abs(SphericalProjector::atan2Deg(y, x) - rad2deg(atan2((double)y, (double)x)));
+		err = std::max(err, std::min(e, 360.0 - e));
+	}
+	bool bounded = err < halfPixel;
+	_report << QString("SphericalProjector atan2: max error %1 degrees, half a pixel is %2").arg(err, 0, 'g', 3).arg(halfPixel, 0, 'g', 3);
+
+	// a panorama worth of points, with some on the axes and the seam
+	LidarPointVector points;
+	PointBlockBuilder builder(count);
+	for (int i = 0; i < count; ++i)
+	{
+		LidarPoint p(
+			center.X + (i % 97 == 0 ? 0.0 : rng.uniform(-MAX_DISTANCE, MAX_DISTANCE)),
+			center.Y + (i % 89 == 0 ? 0.0 : rng.uniform(-MAX_DISTANCE, MAX_DISTANCE)),
+			center.Z + rng.uniform(-5.0, 5.0)
+		);
+		points.push_back(p);
+		builder.append(p.X, p.Y, p.Z, p.Time, p.Intensity);
+	}
+	PointBlock block = builder.build();
+
+	QVector<int> refX(count), refY(count);
+	tm.reset();
+	tm.start();
+	for (int i = 0; i < count; ++i)
+	{
+		LidarPoint & p = points[i];
+		p.faceTo(center, heading);
+		refX[i] = p.get2D_X(W);
+		refY[i] = p.get2D_Y(H);
+	}
+	tm.stop();
+	double tRef = tm.getTimeMilli();
+
+	// every kernel the CPU can run: at most one pixel off, and only on pixel borders; the vector kernels give exactly
+	// the scalar kernel's distances and pixels
+	bool res = bounded;
+	QVector<float> r(count), scalarR;
+	QVector<int> x(count), y(count), scalarX, scalarY;
+	for (int l = SPL_SCALAR; l <= SphericalProjector::level(); ++l)
+	{
+		tm.reset();
+		tm.start();
+		SphericalProjector::project(block, center, heading, (int)W, (int)H, r.data(), x.data(), y.data(), (SphericalProjectorLevel)l);
+		tm.stop();
+
+		int mismatch = 0, maxOff = 0;
+		for (int i = 0; i < count; ++i)
+		{
+			int dx = std::abs(x[i] - refX[i]), dy = std::abs(y[i] - refY[i]);
+			dx = std::min(dx, (int)W - dx);
+			if (dx + dy > 0)
+				++mismatch;
+			maxOff = std::max(maxOff, std::max(dx, dy));
+		}
+
+		if (l == SPL_SCALAR)
+		{
+			scalarR = r;
+			scalarX = x;
+			scalarY = y;
+		}
+		bool same = r == scalarR && x == scalarX && y == scalarY;
+
+		bool ok = maxOff <= 1 && mismatch <= count / 200 && same;
+		res &= ok;
+		_report << QString("SphericalProjector %1: %2, %3 of %4 pixels off by one, %5 the scalar kernel, faceTo %6 ms, batch %7 ms")
+			.arg(SphericalProjector::levelName((SphericalProjectorLevel)l))
+			.arg(ok ? "ok" : "MISMATCH")
+			.arg(mismatch)
+			.arg(count)
+			.arg(same ? "same as" : "differs from")
+			.arg(tRef, 0, 'f', 2)
+			.arg(tm.getTimeMilli(), 0, 'f', 2);
+	}
+
+	return res;
+}
+
+bool SelfTest::distanceBuckets(QStringList & _report)
+{
+	cv::RNG rng(0x414e4b41);
+	cv::TickMeter tm;
+	LidarPoint center(500000.0, 4500000.0, 1000.0);
+	int count = 2000000, slices = (int)(MAX_DISTANCE / DISTANCE_SLICE);
+
+	// about a fifth of the points lie beyond MAX_DISTANCE, and some on the centre
+	PointBlockBuilder builder(count);
+	for (int i = 0; i < count; ++i)
+	{
+		if (i % 1000 == 0)
+			builder.append(center.X, center.Y, center.Z, 0, 0);
+		else
+			builder.append(center.X + rng.uniform(-MAX_DISTANCE, MAX_DISTANCE), center.Y + rng.uniform(-MAX_DISTANCE, MAX_DISTANCE), center.Z + rng.uniform(-5.0, 5.0), 0, 0);
+	}
+	PointBlock block = builder.build();
+
+	ProjectedPoints points;
+	points.append(block, center, 0);
+	QVector<float> r(count);
+	QVector<int> x(count), y(count);
+	std::copy(points.r(), points.r() + count, r.begin());
+	std::copy(points.x(), points.x() + count, x.begin());
+	std::copy(points.y(), points.y() + count, y.begin());
+
+	// the map of index vectors the buckets replace
+	tm.reset();
+	tm.start();
+	QMap<int, QVector<int>> map;
+	for (int i = 0; i < count; ++i)
+		map[r[i] / DISTANCE_SLICE].push_back(i);
+	tm.stop();
+	double tRef = tm.getTimeMilli();
+
+	DistanceBuckets buckets;
+	tm.reset();
+	tm.start();
+	buckets.build(points, DISTANCE_SLICE, slices);
+	tm.stop();
+
+	// every painted slice holds the same points in the same order
+	bool exact = buckets.sliceCount() == slices && points.count() == buckets.count();
+	for (int s = 0; exact && s < slices; ++s)
+	{
+		QVector<int> expected;
+		for (int i : map.value(s))
+		{
+			if (r[i] > 0)
+				expected.push_back(i);
+		}
+
+		exact = expected.count() == buckets.end(s) - buckets.begin(s);
+		for (int k = 0; exact && k < expected.count(); ++k)
+		{
+			int i = expected[k], j = buckets.begin(s) + k;
+			exact = points.r()[j] == r[i] && points.x()[j] == x[i] && points.y()[j] == y[i];
+		}
+	}
+
+	_report << QString("DistanceBuckets: %1, %2 of %3 points kept, map %4 ms, buckets %5 ms")
+		.arg(exact ? "exact" : "MISMATCH")
+		.arg(buckets.count())
+		.arg(count)
+		.arg(tRef, 0, 'f', 2)
+		.arg(tm.getTimeMilli(), 0, 'f', 2);
+
+	return exact;
+}
+
+bool SelfTest::transverseMercator(QStringList & _report)
+{
+	TransverseMercator tm(35, true);
+	double err = 0, x = 0, y = 0;
+	int count = sizeof(TMReferences) / sizeof(TMReferences[0]);
+	for (int i = 0; i < count; ++i)
+	{
+		tm.forward(TMReferences[i][0], TMReferences[i][1], x, y);
+		err = std::max(err, std::max(std::abs(x - TMReferences[i][2]), std::abs(y - TMReferences[i][3])));
+	}
+
+	bool res = err < 0.001 && tm.srid() == 32635;
+	_report << QString("TransverseMercator: %1, max error %2 m over %3 reference points")
+		.arg(res ? "ok" : "MISMATCH")
+		.arg(err, 0, 'g', 3)
+		.arg(count);
+
+	// the batch against the exact projection: patch sized clusters across the zone, then scattered points that
+	// never share an anchor
+	cv::RNG rng(0x414e4b41);
+	const int clusters = 200, clusterSize = 5000, scattered = 2000;
+	int n = clusters * clusterSize + scattered;
+	QVector<double> lon(n), lat(n), bx(n), by(n), ex(n), ey(n);
+	for (int c = 0, i = 0; c < clusters; ++c)
+	{
+		double cLon = rng.uniform(24.0, 30.0), cLat = rng.uniform(36.0, 42.0);
+		for (int k = 0; k < clusterSize; ++k, ++i)
+		{
+			lon[i] = cLon + rng.uniform(-0.005, 0.005);
+			lat[i] = cLat + rng.uniform(-0.005, 0.005);
+		}
+	}
+	for (int i = clusters * clusterSize; i < n; ++i)
+	{
+		lon[i] = rng.uniform(24.0, 30.0);
+		lat[i] = rng.uniform(36.0, 42.0);
+	}
+
+	cv::TickMeter timer;
+	timer.start();
+	for (int i = 0; i < n; ++i)
+		tm.forward(lon[i], lat[i], ex[i], ey[i]);
+	timer.stop();
+	double tExact = timer.getTimeMilli();
+
+	timer.reset();
+	timer.start();
+	tm.forward(lon.constData(), lat.constData(), n, bx.data(), by.data());
+	timer.stop();
+
+	double batchErr = 0;
+	for (int i = 0; i < n; ++i)
+		batchErr = std::max(batchErr, std::max(std::abs(bx[i] - ex[i]), std::abs(by[i] - ey[i])));
+
+	bool batchRes = batchErr < 1e-4;
+	_report << QString("TransverseMercator batch: %1, max deviation %2 m over %3 points, exact %4 ms, batch %5 ms")
+		.arg(batchRes ? "ok" : "MISMATCH")
+		.arg(batchErr, 0, 'g', 3)
+		.arg(n)
+		.arg(tExact, 0, 'f', 2)
+		.arg(timer.getTimeMilli(), 0, 'f', 2);
+
+	return res && batchRes;
+}
+
+bool SelfTest::pcPatchDecoder(QStringList & _report)
+{
+	// a typical pdal written geographic schema, the dimensions deliberately out of position order
+	QString schema =
+		"<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+		"<pc:PointCloudSchema xmlns:pc=\"http://pointcloud.org/schemas/PC/1.1\">"
+		"<pc:dimension><pc:position>4</pc:position><pc:size>2</pc:size><pc:name>Intensity</pc:name><pc:interpretation>uint16_t</pc:interpretation><pc:scale>1</pc:scale></pc:dimension>"
+		"<pc:dimension><pc:position>1</pc:position><pc:size>4</pc:size><pc:name>X</pc:name><pc:interpretation>int32_t</pc:interpretation><pc:scale>0.0000001</pc:scale></pc:dimension>"
+		"<pc:dimension><pc:position>2</pc:position><pc:size>4</pc:size><pc:name>Y</pc:name><pc:interpretation>int32_t</pc:interpretation><pc:scale>0.0000001</pc:scale></pc:dimension>"
+		"<pc:dimension><pc:position>3</pc:position><pc:size>4</pc:size><pc:name>Z</pc:name><pc:interpretation>int32_t</pc:interpretation><pc:scale>0.01</pc:scale><pc:offset>100</pc:offset></pc:dimension>"
+		"<pc:dimension><pc:position>5</pc:position><pc:size>1</pc:size><pc:name>ReturnNumber</pc:name><pc:interpretation>uint8_t</pc:interpretation><pc:scale>1</pc:scale></pc:dimension>"
+		"<pc:dimension><pc:position>6</pc:position><pc:size>8</pc:size><pc:name>GpsTime</pc:name><pc:interpretation>double</pc:interpretation><pc:scale>1</pc:scale></pc:dimension>"
+		"</pc:PointCloudSchema>";
+	PcPatchDecoder decoder(3, 4326, schema);
+	TransverseMercator tm;
+
+	// an uncompressed little endian patch
+	cv::RNG rng(0x414e4b41);
+	int count = 10000;
+	quint32 header[3] = { 3, 0, (quint32)count };
+	QByteArray wkb(1, 1);
+	wkb.append(reinterpret_cast<const char *>(header), sizeof(header));
+	QVector<LidarPoint> expected;
+	for (int i = 0; i < count; ++i)
+	{
+		qint32 x = 290000000 + rng.uniform(0, 10000), y = 410000000 + rng.uniform(0, 10000), z = rng.uniform(0, 5000);
+		quint16 intensity = (quint16)rng.uniform(0, 65536);
+		quint8 returnNumber = 1;
+		double time = 40000000000.0 + i * 10;
+
+		wkb.append(reinterpret_cast<const char *>(&x), 4);
+		wkb.append(reinterpret_cast<const char *>(&y), 4);
+		wkb.append(reinterpret_cast<const char *>(&z), 4);
+		wkb.append(reinterpret_cast<const char *>(&intensity), 2);
+		wkb.append(reinterpret_cast<const char *>(&returnNumber), 1);
+		wkb.append(reinterpret_cast<const char *>(&time), 8);
+
+		LidarPoint p(0, 0, z * 0.01 + 100, (qint64)time, intensity);
+		tm.forward(x * 0.0000001, y * 0.0000001, p.X, p.Y);
+		expected.push_back(p);
+	}
+
+	PointBlockBuilder builder(PcPatchDecoder::pointCountOf(wkb));
+	bool res = decoder.isValid() && decoder.pointSize() == 23 && PcPatchDecoder::pcidOf(wkb) == 3 && decoder.decode(wkb, tm, builder);
+	PointBlock block = builder.build();
+	res &= block.count() == count;
+
+	double err = 0;
+	for (int i = 0; res && i < count; ++i)
+	{
+		LidarPoint p = block.point(i);
+		err = std::max(err, std::max(std::abs(p.X - expected[i].X), std::max(std::abs(p.Y - expected[i].Y), std::abs(p.Z - expected[i].Z))));
+		res = p.Time == expected[i].Time && p.Intensity == expected[i].Intensity;
+	}
+	res &= err < 1e-4;
+
+	// a truncated patch and a schema without time are refused
+	res &= !decoder.decode(wkb.left(wkb.size() - 1), tm, builder);
+	res &= !PcPatchDecoder(4, 4326, QString(schema).replace("GpsTime", "Time")).isValid();
+
+	_report << QString("PcPatchDecoder: %1, %2 points, max position error %3 m")
+		.arg(res ? "ok" : "MISMATCH")
+		.arg(count)
+		.arg(err, 0, 'g', 3);
+
+	return res;
+}
+
+bool SelfTest::patchDiskCache(QStringList & _report)
+{
+	cv::RNG rng(0x414e4b41);
+	cv::TickMeter tm;
+	const int count = 50000, blockCount = 4;
+
+	PointBlockVector blocks;
+	for (int b = 0; b < blockCount; ++b)
+		blocks.push_back(randomBlock(rng, count));
+
+	// room for three of the four files
+	QDir dir(QDir::temp().filePath("ankadepth_selftest_cache"));
+	dir.removeRecursively();
+	qint64 budget = 3 * (blocks[0].byteSize() + 256);
+
+	// the bytes of the cache files in the slot, which the cache's count has to match
+	PatchDiskCache cache;
+	bool stored = cache.open(dir.path(), budget);
+	QDir slot(cache.directory());
+	auto dirBytes = [&]()
+	{
+		qint64 res = 0;
+		QFileInfoList files = slot.entryInfoList(QStringList() << "*.apc", QDir::Files);
+		for (QFileInfoList::const_iterator it = files.constBegin(); it != files.constEnd(); ++it)
+			res += it->size();
+		return res;
+	};
+
+	tm.start();
+	for (int b = 0; b < blockCount - 1; ++b)
+		stored &= cache.store(QString("35/patch@%1").arg(b), blocks[b]);
+
+	// the first three stay mapped while the last store evicts the first, which not every platform can delete
+	PointBlockVector held;
+	for (int b = 0; b < blockCount - 1; ++b)
+		held.push_back(cache.load(QString("35/patch@%1").arg(b)));
+	stored &= cache.store(QString("35/patch@%1").arg(blockCount - 1), blocks[blockCount - 1]);
+	tm.stop();
+	double tStore = tm.getTimeMilli();
+	bool evicted = !cache.load("35/patch@0").isValid() && cache.fileCount() == blockCount - 1 && cache.bytes() == dirBytes();
+
+	// with the mapping gone the next eviction deletes it
+	held.clear();
+	stored &= cache.store(QString("35/patch@%1").arg(blockCount - 1), blocks[blockCount - 1]);
+	evicted = evicted && cache.bytes() <= budget && cache.bytes() == dirBytes();
+
+	// another worker of the host opening the same directory meanwhile gets a slot of its own
+	PatchDiskCache other;
+	bool slotted = other.open(dir.path(), budget) && other.directory() != cache.directory() && other.fileCount() == 0;
+	other.close();
+
+	// a new instance indexes the files of the last one, whose slot is free again
+	cache.close();
+	PatchDiskCache reopened;
+	slotted = slotted && reopened.open(dir.path(), budget) && reopened.directory() == slot.absolutePath();
+	tm.reset();
+	tm.start();
+	PointBlock block = reopened.load("35/patch@3");
+	tm.stop();
+	bool exact = block.isValid() && block.byteSize() == blocks[3].byteSize() &&
+		memcmp(block.storage()->data(), blocks[3].storage()->data(), block.byteSize()) == 0;
+	block = PointBlock();
+
+	// one flipped byte in the payload fails the checksum and drops the file
+	QFile file(slot.filePath(PatchDiskCache::fileName("35/patch@2")));
+	char c = 0;
+	bool damaged = file.open(QIODevice::ReadWrite) && file.seek(file.size() - 3) && file.getChar(&c) && file.seek(file.size() - 3) && file.putChar(c ^ 0x5a);
+	file.close();
+	damaged = damaged && !reopened.load("35/patch@2").isValid() && reopened.fileCount() == blockCount - 2 && !QFile::exists(file.fileName());
+
+	// a posted store is on disk once the writer is flushed
+	reopened.post("35/patch@0", blocks[0]);
+	reopened.flush();
+	block = reopened.load("35/patch@0");
+	bool posted = block.isValid() && block.byteSize() == blocks[0].byteSize() &&
+		memcmp(block.storage()->data(), blocks[0].storage()->data(), block.byteSize()) == 0;
+	block = PointBlock();
+	reopened.close();
+
+	dir.removeRecursively();
+
+	bool res = stored && evicted && slotted && exact && damaged && posted;
+	_report << QString("PatchDiskCache: %1, eviction %2, slots %3, reopened block %4, damaged file %5, posted store %6, store %7 ms, mapped load %8 ms")
+		.arg(res ? "ok" : "MISMATCH")
+		.arg(evicted ? "ok" : "failed")
+		.arg(slotted ? "ok" : "failed")
+		.arg(exact ? "exact" : "MISMATCH")
+		.arg(damaged ? "dropped" : "NOT DETECTED")
+		.arg(posted ? "written" : "MISSING")
+		.arg(tStore, 0, 'f', 2)
+		.arg(tm.getTimeMilli(), 0, 'f', 2);
+
+	return res;
+}
+
+bool SelfTest::sharedPatchArena(QStringList & _report)
+{
+	cv::RNG rng(0x414e4b41);
+	const int count = 20000, blockCount = 6, keyCount = 24;
+
+	PointBlockVector blocks;
+	for (int b = 0; b < blockCount; ++b)
+		blocks.push_back(randomBlock(rng, count));
+
+	// a segment of this process only, with room for four blocks; each arena stands in for a worker of the host
+	QString name = QString("AnkaDepthSelfTestArena_%1").arg(QCoreApplication::applicationPid());
+	qint64 bytes = 4 * ((blocks[0].byteSize() + 4095) / 4096 * 4096);
+	SharedPatchArena arenas[2];
+	bool opened = arenas[0].open(name, bytes) && arenas[1].open(name, bytes);
+
+	// the second worker reads what the first stored, in place: its loads share the bytes instead of copying them
+	PointBlock stored = arenas[0].store("35/patch@shared", blocks[0]);
+	bool shared =
+		stored.isValid() && stored.storage()->data() != blocks[0].storage()->data() &&
+		arenas[1].load("35/patch@shared").byteSize() == blocks[0].byteSize() &&
+		memcmp(arenas[1].load("35/patch@shared").storage()->data(), blocks[0].storage()->data(), blocks[0].byteSize()) == 0 &&
+		arenas[1].load("35/patch@shared").storage()->data() == arenas[1].load("35/patch@shared").storage()->data() &&
+		!arenas[1].load("35/patch@0").isValid();
+	stored = PointBlock();
+
+	// both workers load every key through a process cache that keeps all of them, the way DBPatchBufferer does: from
+	// the arena if the other one stored it, else "fetched" and stored. six times the arena's room goes through it, the
+	// caches' handles do not keep it from reclaiming their slots
+	PatchCache caches[2];
+	int stores = 0, failedStores = 0, arenaHits = 0;
+	for (int k = 0; k < keyCount; ++k)
+	{
+		for (int w = 0; w < 2; ++w)
+		{
+			QString key = QString("35/patch@%1").arg(k);
+			PointBlock block;
+			caches[w].setBudget(1LL << 30);
+			caches[w].get(key, [&](PointBlock & _block)
+			{
+				_block = arenas[w].load(key);
+				if (_block.isValid())
+				{
+					++arenaHits;
+					return true;
+				}
+
+				_block = arenas[w].store(key, blocks[k % blockCount]);
+				++(_block.isValid() ? stores : failedStores);
+				return _block.isValid();
+			}, block);
+		}
+	}
+
+	// the caches are charged for handles, the ones still in the arena hit with their bytes, the reclaimed ones miss
+	int hits = 0, misses = 0;
+	bool cached = failedStores == 0 && stores == keyCount && arenaHits == keyCount && arenas[0].blockCount() <= 4 &&
+		caches[0].count() == keyCount && caches[0].bytes() < blocks[0].byteSize();
+	for (int k = 0; cached && k < keyCount; ++k)
+	{
+		PointBlock block;
+		if (caches[0].get(QString("35/patch@%1").arg(k), [&](PointBlock &) { ++misses; return false; }, block))
+		{
+			++hits;
+			cached = memcmp(block.storage()->data(), blocks[k % blockCount].storage()->data(), block.byteSize()) == 0;
+		}
+	}
+	cached = cached && hits > 0 && hits <= 4 && hits + misses == keyCount;
+
+	// a block being read keeps its slot while more patches go through the arena than it has room for
+	QString last = QString("35/patch@%1").arg(keyCount - 1);
+	PointBlock reader = arenas[0].load(last);
+	int readerStores = 0;
+	for (int k = 0; k < 8; ++k)
+		readerStores += arenas[1].store(QString("35/patch@reader%1").arg(k), blocks[k % blockCount]).isValid() ? 1 : 0;
+	bool pinned = reader.isValid() && readerStores == 8 && arenas[1].load(last).isValid() &&
+		memcmp(reader.storage()->data(), blocks[(keyCount - 1) % blockCount].storage()->data(), reader.byteSize()) == 0;
+	reader = PointBlock();
+
+	// the oldest went to make room
+	bool evicted =
+		!arenas[0].load("35/patch@0").isValid() &&
+		arenas[1].load("35/patch@reader7").isValid();
+
+	bool res = opened && shared && cached && pinned && evicted;
+	_report << QString("SharedPatchArena: %1, shared %2, %3 stores and %4 refused past capacity with both caches full, %5 read from the arena, cache %6 (%7 hits, %8 reclaimed, %9 bytes), pinned block %10, evicted %11, %12 blocks in %13 KB")
+		.arg(res ? "ok" : "MISMATCH")
+		.arg(shared ? "ok" : "failed")
+		.arg(stores)
+		.arg(failedStores)
+		.arg(arenaHits)
+		.arg(cached ? "ok" : "failed")
+		.arg(hits)
+		.arg(misses)
+		.arg(caches[0].bytes())
+		.arg(pinned ? "kept" : "LOST")
+		.arg(evicted ? "ok" : "failed")
+		.arg(arenas[0].blockCount())
+		.arg(arenas[0].capacity() / 1024);
+
+	return res;
+}
+
+bool SelfTest::patchCache(QStringList & _report)
+{
+	const int keyCount = 4, requests = 256;
+	int threads = std::max(QThread::idealThreadCount(), 4);
+
+	// every request of a key arrives while its first load is still sleeping on the "database"
+	PatchCache cache;
+	cache.setBudget(1LL << 30);
+	QAtomicInt loads(0), loaders(0);
+	QVector<const char *> data(requests, nullptr);
+	ParallelExecutor::setParallelism(threads);
+	ParallelExecutor::parallelFor(requests, [&](int _begin, int _end)
+	{
+		for (int i = _begin; i < _end; ++i)
+		{
+			PointBlock block;
+			bool loaded = false;
+			bool ok = cache.get(QString("patch@%1").arg(i % keyCount), [&](PointBlock & _block)
+			{
+				loads.fetchAndAddOrdered(1);
+				QThread::msleep(50);
+				PointBlockBuilder builder(1);
+				builder.append(i, 0.0, 0.0, 0, 0);
+				_block = builder.build();
+				return true;
+			}, block, &loaded);
+
+			if (loaded)
+				loaders.fetchAndAddOrdered(1);
+			if (ok)
+				data[i] = block.storage()->data();
+		}
+	});
+	ParallelExecutor::setParallelism(1);
+
+	bool shared = true;
+	for (int i = keyCount; i < requests; ++i)
+		shared &= data[i] != nullptr && data[i] == data[i % keyCount];
+	bool once = loads.loadAcquire() == keyCount && loaders.loadAcquire() == keyCount && shared;
+
+	// a failed load hands its failure to the waiters only, the next request loads again
+	PatchCache single(1);
+	single.setBudget(2 * PointBlock::byteSize(1));
+	PointBlock block;
+	bool retried =
+		!single.get("failing", [](PointBlock &) { return false; }, block) &&
+		!single.contains("failing") &&
+		single.get("failing", [](PointBlock & _block) { PointBlockBuilder builder(1); builder.append(0.0, 0.0, 0.0, 0, 0); _block = builder.build(); return true; }, block) &&
+		single.contains("failing");
+
+	// the least recently used block goes first once the budget is reached
+	for (int i = 0; i < 2; ++i)
+		single.get(QString("patch@%1").arg(i), [](PointBlock & _block) { PointBlockBuilder builder(1); builder.append(0.0, 0.0, 0.0, 0, 0); _block = builder.build(); return true; }, block);
+	bool bounded = single.count() == 2 && !single.contains("failing") && single.contains("patch@0") && single.contains("patch@1");
+
+	// a batch: the cached key is served, the missing ones are delivered from decode threads, the undelivered one fails
+	QStringList keys = QStringList() << "patch@0" << "batch@0" << "batch@1" << "batch@2";
+	PointBlockVector blocks;
+	QVector<bool> loaded;
+	QVector<int> requested;
+	bool batchOk = cache.getAll(keys, [&](const QVector<int> & _indices, const PatchCache::Delivery & _deliver)
+	{
+		requested = _indices;
+		PatchFetchPipeline pipeline;
+		for (int i = 0; i < _indices.count() - 1; ++i)
+		{
+			int index = _indices[i];
+			pipeline.fetch([&pipeline, &_deliver, index]() { pipeline.decode([&_deliver, index]() { _deliver(index, true, blockAt(index, 0.0, 4)); }); });
+		}
+		pipeline.wait();
+	}, blocks, &loaded);
+	bool batched =
+		!batchOk &&
+		requested == (QVector<int>() << 1 << 2 << 3) &&
+		loaded == (QVector<bool>() << false << true << true << true) &&
+		blocks[0].isValid() && blocks[1].isValid() && blocks[2].isValid() && !blocks[3].isValid() &&
+		cache.contains("batch@1") && !cache.contains("batch@2");
+
+	bool res = once && retried && bounded && batched;
+	_report << QString("PatchCache: %1, %2 loads for %3 requests of %4 patches on %5 threads, retried %6, bounded %7, batched %8")
+		.arg(res ? "ok" : "MISMATCH")
+		.arg(loads.loadAcquire())
+		.arg(requests)
+		.arg(keyCount)
+		.arg(threads)
+		.arg(retried ? "ok" : "failed")
+		.arg(bounded ? "ok" : "failed")
+		.arg(batched ? "ok" : "failed");
+
+	return res;
+}
+
+bool SelfTest::patchEvictionPolicy(QStringList & _report)
+{
+	PointBlock block = blockAt(500000.0, 4500000.0, 64);
+	qint64 size = block.byteSize();
+
+	// a shard of four blocks under _policy: _frequent keys used twice, then a scan of _scan keys read once
+	auto survivors = [&](PatchCachePolicy _policy, int _frequent, int _scan)
+	{
+		QScopedPointer<PatchEvictionPolicy> policy(PatchEvictionPolicy::create(_policy));
+		policy->setBudget(4 * size);
+		QSet<QString> cached;
+		auto insert = [&](const QString & _key)
+		{
+			if (cached.contains(_key))
+			{
+				policy->accessed(_key);
+				return;
+			}
+			cached.insert(_key);
+			policy->inserted(_key, block);
+			while (cached.count() * size > 4 * size)
+				cached.remove(policy->victim());
+		};
+
+		for (int pass = 0; pass < 2; ++pass)
+			for (int i = 0; i < _frequent; ++i)
+				insert(QString("frequent@%1").arg(i));
+		for (int i = 0; i < _scan; ++i)
+			insert(QString("scan@%1").arg(i));
+
+		int res = 0;
+		for (int i = 0; i < _frequent; ++i)
+			res += cached.contains(QString("frequent@%1").arg(i)) ? 1 : 0;
+		return res;
+	};
+
+	int
+		lruKept = survivors(PCP_LRU, 2, 16),
+		arcKept = survivors(PCP_ARC, 2, 16);
+	bool scanResistant = lruKept == 0 && arcKept == 2;
+
+	// the patch a kilometre away goes before the least recently used one next to the task
+	QScopedPointer<PatchEvictionPolicy> trajectory(PatchEvictionPolicy::create(PCP_TRAJECTORY));
+	trajectory->inserted("near", blockAt(500000.0, 4500000.0, 16));
+	trajectory->inserted("far", blockAt(501000.0, 4500000.0, 16));
+	trajectory->inserted("close", blockAt(500030.0, 4500010.0, 16));
+	trajectory->accessed("far");
+	trajectory->setFocus(QVector<QPointF>() << QPointF(500010.0, 4500000.0));
+	QString first = trajectory->victim(), second = trajectory->victim();
+	bool nearFirst = first == "far" && second == "near";
+
+	bool res = scanResistant && nearFirst;
+	_report << QString("PatchEvictionPolicy: %1, frequent patches kept through a scan: LRU %2 of 2, ARC %3 of 2, trajectory order %4")
+		.arg(res ? "ok" : "MISMATCH")
+		.arg(lruKept)
+		.arg(arcKept)
+		.arg(nearFirst ? "ok" : "failed");
+
+	return res;
+}
+
+bool SelfTest::patchIndex(QStringList & _report)
+{
+	TransverseMercator projection(35);
+	PatchIndex index;
+	index.reset(projection);
+
+	// patches of a few metres to a few dozen scattered over a couple of kilometres, over a few minutes
+	class Patch
+	{
+	public:
+		int id;
+		double xMin, xMax, yMin, yMax, time;
+	};
+	QVector<Patch> patches;
+	std::mt19937 random(20);
+	std::uniform_real_distribution<double> lon(27.000, 27.025), lat(38.400, 38.420), size(0.00005, 0.0004), time(0.0, 600.0);
+	for (int i = 0; i < 4000; ++i)
+	{
+		double
+			lonMin = lon(random), latMin = lat(random),
+			lonMax = lonMin + size(random), latMax = latMin + size(random),
+			lons[4] = { lonMin, lonMax, lonMin, lonMax },
+			lats[4] = { latMin, latMin, latMax, latMax },
+			x[4], y[4];
+		projection.forward(lons, lats, 4, x, y);
+
+		Patch patch;
+		patch.id = i + 1;
+		patch.xMin = *std::min_element(x, x + 4);
+		patch.xMax = *std::max_element(x, x + 4);
+		patch.yMin = *std::min_element(y, y + 4);
+		patch.yMax = *std::max_element(y, y + 4);
+		patch.time = time(random);
+		patches.push_back(patch);
+
+		index.add(patch.id, lonMin, lonMax, latMin, latMax, patch.time);
+	}
+
+	// the index against the query it replaces, done as a scan of every patch
+	int queries = 200, mismatches = 0, found = 0;
+	for (int q = 0; q < queries; ++q)
+	{
+		double x, y, t = time(random);
+		projection.forward(lon(random), lat(random), x, y);
+		int limit = q % 2 ? 10 : 1000;
+
+		QVector<int> expected;
+		for (QVector<Patch>::const_iterator it = patches.constBegin(); it != patches.constEnd(); ++it)
+		{
+			double
+				dx = std::max(std::max(it->xMin - x, x - it->xMax), 0.0),
+				dy = std::max(std::max(it->yMin - y, y - it->yMax), 0.0);
+			if (dx * dx + dy * dy <= MAX_DISTANCE * MAX_DISTANCE && std::abs(it->time - t) < PATCH_TIME_WINDOW)
+				expected.push_back(it->id);
+		}
+		if (expected.count() > limit)
+			expected.resize(limit);
+
+		QVector<int> candidates = index.candidates(x, y, MAX_DISTANCE, t, limit);
+		mismatches += candidates == expected ? 0 : 1;
+		found += candidates.count();
+	}
+
+	// a stamp with fractions of a second, and one that cannot be read
+	double stamp = PatchIndex::secondsOf("2021-05-03 10:00:00.500");
+	bool stamps =
+		std::abs(stamp - 1620036000.5) < 1e-6 &&
+		std::isnan(PatchIndex::secondsOf("not a time"));
+
+	bool res = index.count() == patches.count() && mismatches == 0 && found > 0 && stamps;
+	_report << QString("PatchIndex: %1, %2 patches, %3 of %4 queries mismatched, %5 candidates found, time stamps %6")
+		.arg(res ? "ok" : "MISMATCH")
+		.arg(index.count())
+		.arg(mismatches)
+		.arg(queries)
+		.arg(found)
+		.arg(stamps ? "ok" : "failed");
+
+	return res;
+}
+
+bool SelfTest::patchPrefetcher(QStringList & _report)
+{
+	// frames of a drive heading north east at 3 metres a frame, a frame every half second
+	auto frameAt = [](int _id, const QString & _drive)
+	{
+		PatchPrefetcher::Frame frame;
+		frame.taskId = _id;
+		frame.drive = _drive;
+		frame.x = 500000.0 + _id * 3.0 * std::sqrt(0.5);
+		frame.y = 4500000.0 + _id * 3.0 * std::sqrt(0.5);
+		frame.lon = 27.0 + _id * 0.00002;
+		frame.lat = 38.4 + _id * 0.00002;
+		frame.time = 1564830000.0 + _id * 0.5;
+		return frame;
+	};
+
+	// two frames apart, as a worker sees a drive whose every other frame went to another worker, the next ones it gets
+	// are as far apart; a Hilbert run may walk the drive against its ids
+	bool stepped = true;
+	for (int reversed = 0; reversed < 2; ++reversed)
+	{
+		int from = reversed ? 12 : 10, to = reversed ? 10 : 12;
+		QVector<PatchPrefetcher::Frame> ahead = PatchPrefetcher::extrapolate(frameAt(from, "a/1"), frameAt(to, "a/1"), 4);
+		stepped &= ahead.count() == 4;
+		for (int i = 0; stepped && i < ahead.count(); ++i)
+		{
+			PatchPrefetcher::Frame expected = frameAt(to + (to - from) * (i + 1), "a/1");
+			stepped =
+				ahead[i].taskId == 0 &&
+				std::abs(ahead[i].x - expected.x) < 1e-6 &&
+				std::abs(ahead[i].y - expected.y) < 1e-6 &&
+				std::abs(ahead[i].lon - expected.lon) < 1e-9 &&
+				std::abs(ahead[i].lat - expected.lat) < 1e-9 &&
+				std::abs(PatchIndex::secondsOf(ahead[i].timeStamp) - expected.time) < 1e-3;
+		}
+	}
+
+	PatchPrefetcher::Frame jump = frameAt(11, "a/1");
+	jump.x += PATCH_PREFETCH_MAX_STEP * 2;
+	PatchPrefetcher::Frame unstamped = frameAt(11, "a/1");
+	unstamped.time = PatchIndex::secondsOf("not a time");
+	bool refused =
+		PatchPrefetcher::extrapolate(frameAt(10, "a/1"), jump, 4).isEmpty() &&
+		PatchPrefetcher::extrapolate(frameAt(10, "a/1"), unstamped, 4).isEmpty() &&
+		PatchPrefetcher::extrapolate(unstamped, frameAt(12, "a/1"), 4).isEmpty() &&
+		PatchPrefetcher::extrapolate(frameAt(10, "a/1"), frameAt(11, "a/2"), 4).isEmpty() &&
+		PatchPrefetcher::extrapolate(frameAt(10, "a/1"), frameAt(10, "a/1"), 4).isEmpty() &&
+		PatchPrefetcher::extrapolate(PatchPrefetcher::Frame(), frameAt(10, "a/1"), 4).isEmpty();
+
+	bool res = stepped && refused;
+	_report << QString("PatchPrefetcher: %1, drive extrapolated %2, gaps, other drives and unreadable stamps refused %3")
+		.arg(res ? "ok" : "MISMATCH")
+		.arg(stepped ? "ok" : "failed")
+		.arg(refused ? "ok" : "failed");
+
+	return res;
+}
+
+bool SelfTest::taskRunScheduler(QStringList & _report)
+{
+	// consecutive cells of the curve are neighbours and every cell is on it once
+	int order = 5, side = 1 << order;
+	QVector<QPoint> cells(side * side, QPoint(-1, -1));
+	for (int x = 0; x < side; ++x)
+		for (int y = 0; y < side; ++y)
+			cells[(int)TaskRunScheduler::hilbertIndex(x, y, order)] = QPoint(x, y);
+	bool curve = true;
+	for (int i = 0; curve && i < cells.count(); ++i)
+		curve = cells[i].x() >= 0 && (i == 0 || std::abs(cells[i].x() - cells[i - 1].x()) + std::abs(cells[i].y() - cells[i - 1].y()) == 1);
+
+	// two drives of 40 and 20 frames
+	DepthTaskList tasks;
+	for (int i = 0; i < 60; ++i)
+	{
+		DepthTask * task = new DepthTask();
+		QString parent = "root", sub = i < 40 ? "drive1" : "drive2";
+		task->setId(i + 1);
+		task->setParentDir(parent);
+		task->setSubDir(sub);
+		task->setX(500000.0 + i * 3.0);
+		task->setY(4500000.0);
+		tasks.push_back(task);
+	}
+
+	TaskRunScheduler scheduler;
+	scheduler.build(tasks, SM_DRIVE_RUNS);
+
+	// two workers get a drive each, a third the back half of what is left of the first drive
+	QMap<QString, QList<int>> taken;
+	QStringList workers = QStringList() << "w1" << "w2";
+	for (int round = 0; round < 5; ++round)
+		for (QStringList::const_iterator it = workers.constBegin(); it != workers.constEnd(); ++it)
+			taken[*it] << scheduler.take(*it)->id();
+	DepthTask * split = scheduler.take("w3");
+	taken["w3"] << (split ? split->id() : 0);
+
+	bool runs =
+		scheduler.runCount() == 3 &&
+		taken["w1"] == (QList<int>() << 1 << 2 << 3 << 4 << 5) &&
+		taken["w2"] == (QList<int>() << 41 << 42 << 43 << 44 << 45) &&
+		taken["w3"] == (QList<int>() << 23);
+
+	// a task handed back is the next one a worker without a run gets
+	scheduler.release("w2");
+	scheduler.requeue(tasks[2]);
+	DepthTask * requeued = scheduler.take("w4");
+	runs = runs && requeued == tasks[2] && scheduler.take("w4")->id() == 46;
+
+	// every task comes out once
+	QSet<int> seen;
+	for (QMap<QString, QList<int>>::const_iterator it = taken.constBegin(); it != taken.constEnd(); ++it)
+		for (QList<int>::const_iterator id = it.value().constBegin(); id != it.value().constEnd(); ++id)
+			seen << *id;
+	seen << 3 << 46;
+	DepthTask * task = nullptr;
+	while (task = scheduler.take("w1"))
+		seen << task->id();
+	while (task = scheduler.take("w3"))
+		seen << task->id();
+	while (task = scheduler.take("w4"))
+		seen << task->id();
+	bool drained = seen.count() == 60 && scheduler.count() == 0;
+
+	qDeleteAll(tasks);
+
+	bool res = curve && runs && drained;
+	_report << QString("TaskRunScheduler: %1, Hilbert curve %2, runs %3, drained %4")
+		.arg(res ? "ok" : "MISMATCH")
+		.arg(curve ? "ok" : "failed")
+		.arg(runs ? "ok" : "failed")
+		.arg(drained ? "ok" : "failed");
+
+	return res;
+}
+
+bool SelfTest::gridFrame(QStringList & _report)
+{
+	// doubles that do not survive 12 decimals, and strings beyond ASCII
+	DepthTask tasks[2];
+	QString parent = "KARS", sub = "ladybug_19027046_20190803_110601-000000", file = QString::fromUtf8("görüntü_0001.jpg"), stamp = "2019-08-03 11:06:01.123";
+	for (int i = 0; i < 2; ++i)
+	{
+		tasks[i].setId(1000 + i);
+		tasks[i].setLongtitude(27.123456789012345 + i);
+		tasks[i].setLatitude(38.1 / 3.0);
+		tasks[i].setX(1.0 / 7.0);
+		tasks[i].setY(4500000.000000001);
+		tasks[i].setAltitude(-12.5);
+		tasks[i].setHeading(359.99999999999994);
+		tasks[i].setPitch(1e-300);
+		tasks[i].setRoll(-0.0);
+		tasks[i].setParentDir(parent);
+		tasks[i].setSubDir(sub);
+		tasks[i].setFileName(file);
+		tasks[i].setTimeStamp(stamp);
+	}
+
+	GridFrame::Writer writer(GridFrame::GFT_TASKS);
+	writer.writeInt32(2);
+	for (int i = 0; i < 2; ++i)
+		tasks[i].write(writer);
+	QByteArray frame = writer.frame();
+
+	GridFrame::Reader reader(GridFrame::fromArgument(GridFrame::toArgument(frame)), GridFrame::GFT_TASKS);
+	bool same = reader.isValid() && reader.readInt32() == 2;
+	for (int i = 0; same && i < 2; ++i)
+	{
+		DepthTask task;
+		same = task.read(reader);
+
+		// bit for bit, where the text form would round
+		double
+			read[3] = { task.longtitude(), task.x(), task.pitch() },
+			written[3] = { tasks[i].longtitude(), tasks[i].x(), tasks[i].pitch() };
+		same = same &&
+			memcmp(read, written, sizeof(read)) == 0 &&
+			task.id() == tasks[i].id() &&
+			task.fileName() == file &&
+			task.timeStamp() == stamp;
+	}
+	same = same && reader.atEnd();
+
+	// a cut frame, another type, and another version
+	QByteArray cut = frame.left(frame.size() - 3), versioned = frame;
+	versioned[2] = (char)(GridFrame::Version + 1);
+	DepthTask task;
+	GridFrame::Reader cutReader(cut, GridFrame::GFT_TASKS);
+	bool refused =
+		!cutReader.isValid() &&
+		!GridFrame::Reader(frame, GridFrame::GFT_RESULTS).isValid() &&
+		!GridFrame::Reader(versioned, GridFrame::GFT_TASKS).isValid() &&
+		!task.read(cutReader);
+
+	bool res = same && refused;
+	_report << QString("GridFrame: %1, %2 bytes for two tasks against %3 in text, read back %4, damaged frames refused %5")
+		.arg(res ? "ok" : "MISMATCH")
+		.arg(frame.size())
+		.arg(tasks[0].toString().toUtf8().size() + tasks[1].toString().toUtf8().size())
+		.arg(same ? "ok" : "failed")
+		.arg(refused ? "ok" : "failed");
+
+	return res;
+}
+
+bool SelfTest::timerWheel(QStringList & _report)
+{
+	// a small wheel so deadlines wrap over several turns, some of them already passed when scheduled
+	std::mt19937 random(25);
+	std::uniform_int_distribution<int> delay(-50, 3000), id(0, 399), step(0, 120);
+	TimerWheel wheel(10, 32);
+	QMap<int, qint64> deadlines;
+
+	qint64 now = 0;
+	int expired = 0;
+	bool same = true, next = true;
+	for (int round = 0; round < 2000 && same && next; ++round)
+	{
+		// schedule, reschedule or cancel
+		int key = id(random);
+		if (round % 5 == 4)
+		{
+			same = wheel.cancel(key) == deadlines.contains(key);
+			deadlines.remove(key);
+		}
+		else
+		{
+			qint64 deadline = std::max<qint64>(now + delay(random), 0);
+			wheel.schedule(key, deadline);
+			deadlines[key] = deadline;
+		}
+
+		qint64 earliest = -1;
+		for (QMap<int, qint64>::const_iterator it = deadlines.constBegin(); it != deadlines.constEnd(); ++it)
+		{
+			if (earliest < 0 || it.value() < earliest)
+				earliest = it.value();
+		}
+		next = wheel.nextDeadline() == earliest;
+
+		// now and then a jump over more than a turn
+		now += round % 97 == 96 ? 1000 : step(random);
+		QMap<int, qint64> due;
+		for (QMap<int, qint64>::iterator it = deadlines.begin(); it != deadlines.end();)
+		{
+			if (it.value() <= now)
+			{
+				due.insert(it.key(), it.value());
+				it = deadlines.erase(it);
+			}
+			else
+				++it;
+		}
+
+		// every due id once, in deadline order
+		QVector<int> ids = wheel.expire(now);
+		same = same && ids.count() == due.count() && wheel.count() == deadlines.count();
+		qint64 last = -1;
+		for (QVector<int>::const_iterator it = ids.constBegin(); same && it != ids.constEnd(); ++it)
+		{
+			same = due.contains(*it) && due.value(*it) >= last;
+			last = due.value(*it);
+			due.remove(*it);
+		}
+		expired += ids.count();
+	}
+
+	bool res = same && next;
+	_report << QString("TimerWheel: %1, %2 deadlines expired, expiry %3, next deadline %4")
+		.arg(res ? "ok" : "MISMATCH")
+		.arg(expired)
+		.arg(same ? "ok" : "failed")
+		.arg(next ? "ok" : "failed");
+
+	return res;
+}
\ No newline at end of file
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <QStringList>
+
+namespace AnkaDepthLib
+{
+	// equivalence checks and micro benchmarks of the depth pipeline kernels, run with the '-test' argument
+	class SelfTest
+	{
+	public:
+		static bool run(QStringList & _report);
+
+		// ClosingFilter against cv::morphologyEx with the per-slice kernels, and its seam wrapping against a tiled image
+		static bool closingFilter(QStringList & _report);
+
+		// PanoramaBuffer round trip and halo contents against a wrap-padded copy of the image
+		static bool panoramaBuffer(QStringList & _report);
+
+		// both HoleFiller modes against the per-pixel averageDistance scan they replace
+		static bool holeFiller(QStringList & _report);
+
+		// GroundRegenerator against the original per-pixel loop through cv::Mat and LidarPoint::faceTo
+		static bool groundRegenerator(QStringList & _report);
+
+		// every index of a ParallelExecutor loop runs exactly once, and a tiled stage gives the serial result
+		static bool parallelExecutor(QStringList & _report);
+
+		// PointBlock round trip, and ProjectedPoints pixels against LidarPoint::faceTo
+		static bool pointBlock(QStringList & _report);
+
+		// the approximated atan2 against half a pixel, every SphericalProjector kernel against LidarPoint::faceTo and
+		// the vector kernels against the scalar one, bit for bit
+		static bool sphericalProjector(QStringList & _report);
+
+		// DistanceBuckets slices against the map of index vectors they replace
+		static bool distanceBuckets(QStringList & _report);
+
+		// TransverseMercator against UTM zone 35N reference coordinates, and its batch against the exact projection
+		static bool transverseMercator(QStringList & _report);
+
+		// PcPatchDecoder on a synthetic uncompressed patch against the points it was written from
+		static bool pcPatchDecoder(QStringList & _report);
+
+		// PatchDiskCache eviction, also of a file still mapped, two caches on one directory in slots of their own, a
+		// reopened cache mapping a block back bit for bit, a damaged file being dropped and a store posted to the writer
+		// thread
+		static bool patchDiskCache(QStringList & _report);
+
+		// SharedPatchArena blocks read in place through a second attachment, two of them filled past capacity while both
+		// workers' caches keep a handle of every block, the reclaimed handles missing and a block being read kept
+		static bool sharedPatchArena(QStringList & _report);
+
+		// PatchCache running each key's loader once for concurrent requests, failed loads retried, the budget kept, and a
+		// batch delivered from PatchFetchPipeline threads
+		static bool patchCache(QStringList & _report);
+
+		// ARC keeping reused patches through a scan that flushes LRU, and the trajectory policy dropping far patches first
+		static bool patchEvictionPolicy(QStringList & _report);
+
+		// PatchIndex candidates against a scan of every patch, and task stamps read as the wall clock
+		static bool patchIndex(QStringList & _report);
+
+		// PatchPrefetcher stepping a drive on past its last frame either way along it, and refusing gaps, frames of
+		// different drives and frames without a readable time stamp
+		static bool patchPrefetcher(QStringList & _report);
+
+		// TaskRunScheduler keeping workers on contiguous runs and splitting one only for a worker without, and the
+		// Hilbert curve stepping between neighbouring cells
+		static bool taskRunScheduler(QStringList & _report);
+
+		// DepthTask frames read back bit for bit through the base64url argument, and damaged frames refused
+		static bool gridFrame(QStringList & _report);
+
+		// TimerWheel expiring deadlines as a sorted list of them would, over turns, cancels and reschedules
+		static bool timerWheel(QStringList & _report);
+
+	private:
+		SelfTest();
+	};
+}
\ No newline at end of file
@@ -0,0 +1,623 @@
+#include "sharedpatcharena.h"
+#include <QSharedMemory>
+#include <QCryptographicHash>
+#include <QCoreApplication>
+#include <QThread>
+#include <atomic>
+#include <climits>
+#include <cstring>
+#include <new>
+#ifdef Q_OS_WIN
+#include <windows.h>
+#else
+#include <cerrno>
+#include <signal.h>
+#endif
+
+using namespace AnkaDepthLib;
+
+#define ARENA_MAGIC				0x52504e41	// "ANPR"
+#define ARENA_VERSION			3
+#define ARENA_PAGE_SIZE			4096
+#define ARENA_BYTES_PER_SLOT	32768		// a few thousand points per patch
+#define ARENA_MIN_SLOTS			1024
+#define ARENA_PROBE_LENGTH		16
+#define ARENA_DIGEST_SIZE		20
+#define ARENA_MAX_PROCESSES		64
+#define ARENA_PROCESS_PINS		4096		// blocks the readers of one process hold at once
+#define ARENA_HANDLE_BYTES		256			// what a process cache is charged for a handle and its entries
+#define ARENA_OPEN_RETRIES		200
+#define ARENA_OPEN_RETRY_MS		10
+
+namespace
+{
+	// first bytes of the segment, written by the process that creates it; the others take the layout from here
+	class ArenaHeader
+	{
+	public:
+		quint32 magic;
+		quint32 version;
+		quint32 slotCount;
+		quint32 pageCount;
+		qint64 processesOffset;
+		qint64 slotsOffset;
+		qint64 bitmapOffset;
+		qint64 dataOffset;
+		std::atomic<quint64> clock;
+	};
+
+	// an attached process and the pins it holds, so the pins of a process that died holding them can be dropped
+	class ArenaProcess
+	{
+	public:
+		std::atomic<qint64> pid;							// 0 while the entry is free
+		std::atomic<qint32> pins[ARENA_PROCESS_PINS];		// slot index + 1 of a pin held, 0 while free
+	};
+
+	inline qint64 alignTo(qint64 _value, qint64 _alignment)
+	{
+		return (_value + _alignment - 1) / _alignment * _alignment;
+	}
+
+	bool processAlive(qint64 _pid)
+	{
+#ifdef Q_OS_WIN
+		// a process of another user is there even if it cannot be opened
+		HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, (DWORD)_pid);
+		if (!process)
+			return GetLastError() == ERROR_ACCESS_DENIED;
+
+		bool res = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+		CloseHandle(process);
+		return res;
+#else
+		return kill((pid_t)_pid, 0) == 0 || errno == EPERM;
+#endif
+	}
+}
+
+class SharedPatchArena::Slot
+{
+public:
+	std::atomic<qint32> pins;		// -1 while the slot is free or being written, else the blocks reading it
+	quint32 firstPage;
+	quint32 pageCount;
+	quint32 reserved;
+	quint64 size;
+	std::atomic<quint64> lastUse;
+	std::atomic<quint64> cachePins;	// the generation in the high half, the handles of process caches in the low one
+	char digest[ARENA_DIGEST_SIZE];
+};
+
+class SharedPatchArena::Segment
+{
+public:
+	Segment(const QString & _name)
+		:
+		memory(_name),
+		header(nullptr),
+		process(nullptr),
+		slotTable(nullptr),
+		bitmap(nullptr),
+		data(nullptr)
+	{
+	}
+
+	~Segment()
+	{
+		if (process)
+		{
+			memory.lock();
+			process->pid.store(0);
+			memory.unlock();
+		}
+
+		if (memory.isAttached())
+			memory.detach();
+	}
+
+	QSharedMemory memory;
+	ArenaHeader * header;
+	ArenaProcess * process;		// this attachment's entry of the process table
+	Slot * slotTable;
+	quint64 * bitmap;
+	char * data;
+};
+
+// what a process cache keeps of a slot: a cache pin, dropped with the handle unless the slot was reclaimed meanwhile.
+// the bytes are read only while the handle is made from a view, later ones go through pinned()
+class SharedPatchArena::Handle : public PointBlockStorage
+{
+public:
+	Handle(QSharedPointer<Segment> _segment, Slot * _slot, quint32 _generation)
+		:
+		mSegment(_segment),
+		mSlot(_slot),
+		mGeneration(_generation),
+		mData(_segment->data + (qint64)_slot->firstPage * ARENA_PAGE_SIZE),
+		mSize(_slot->size)
+	{
+	}
+
+	~Handle()
+	{
+		quint64 cachePins = mSlot->cachePins.load(std::memory_order_acquire);
+		while ((quint32)(cachePins >> 32) == mGeneration && (cachePins & 0xffffffffULL) > 0 &&
+			!mSlot->cachePins.compare_exchange_weak(cachePins, cachePins - 1, std::memory_order_acq_rel))
+			;
+	}
+
+	const char * data() const override
+	{
+		return mData;
+	}
+
+	qint64 size() const override
+	{
+		return mSize;
+	}
+
+	QSharedPointer<PointBlockStorage> pinned(const QSharedPointer<PointBlockStorage> & _self) const override;
+
+	qint64 footprint() const override
+	{
+		return ARENA_HANDLE_BYTES;
+	}
+
+private:
+	QSharedPointer<Segment> mSegment;
+	Slot * mSlot;
+	quint32 mGeneration;
+	const char * mData;
+	qint64 mSize;
+};
+
+// the bytes of a slot read in place; keeps the segment attached and the slot pinned for as long as a block uses them
+class SharedPatchArena::View : public PointBlockStorage
+{
+public:
+	View(QSharedPointer<Segment> _segment, Slot * _slot, quint32 _generation)
+		:
+		mSegment(_segment),
+		mSlot(_slot),
+		mGeneration(_generation)
+	{
+	}
+
+	~View()
+	{
+		unpin(mSegment.data(), mSlot);
+	}
+
+	const char * data() const override
+	{
+		return mSegment->data + (qint64)mSlot->firstPage * ARENA_PAGE_SIZE;
+	}
+
+	qint64 size() const override
+	{
+		return mSlot->size;
+	}
+
+	QSharedPointer<PointBlockStorage> cached(const QSharedPointer<PointBlockStorage> &) const override
+	{
+		// the slot is pinned, so it is still of the view's generation
+		mSlot->cachePins.fetch_add(1, std::memory_order_acq_rel);
+		return QSharedPointer<PointBlockStorage>(new Handle(mSegment, mSlot, mGeneration));
+	}
+
+	qint64 footprint() const override
+	{
+		return ARENA_HANDLE_BYTES;
+	}
+
+private:
+	QSharedPointer<Segment> mSegment;
+	Slot * mSlot;
+	quint32 mGeneration;
+};
+
+QSharedPointer<PointBlockStorage> SharedPatchArena::Handle::pinned(const QSharedPointer<PointBlockStorage> &) const
+{
+	// the generation is checked under the pin, a slot being read is not reclaimed
+	if (!pin(mSegment.data(), mSlot))
+		return QSharedPointer<PointBlockStorage>();
+
+	if ((quint32)(mSlot->cachePins.load(std::memory_order_acquire) >> 32) != mGeneration)
+	{
+		unpin(mSegment.data(), mSlot);
+		return QSharedPointer<PointBlockStorage>();
+	}
+
+	return QSharedPointer<PointBlockStorage>(new View(mSegment, mSlot, mGeneration));
+}
+
+SharedPatchArena::SharedPatchArena()
+{
+}
+
+SharedPatchArena::~SharedPatchArena()
+{
+	close();
+}
+
+bool SharedPatchArena::open(const QString & _name, qint64 _bytes)
+{
+	close();
+	if (_name.isEmpty() || _bytes <= 0)
+		return false;
+
+	// QSharedMemory sizes are ints, the layout is fitted into that
+	quint32
+		slotCount = (quint32)std::max<qint64>(ARENA_MIN_SLOTS, _bytes / ARENA_BYTES_PER_SLOT),
+		pageCount = (quint32)(std::min<qint64>(_bytes, INT_MAX - (qint64)slotCount * sizeof(Slot) - ARENA_MAX_PROCESSES * sizeof(ArenaProcess) - ARENA_PAGE_SIZE * 4) / ARENA_PAGE_SIZE);
+	qint64
+		processesOffset = alignTo(sizeof(ArenaHeader), 64),
+		slotsOffset = alignTo(processesOffset + ARENA_MAX_PROCESSES * sizeof(ArenaProcess), 64),
+		bitmapOffset = alignTo(slotsOffset + (qint64)slotCount * sizeof(Slot), 64),
+		dataOffset = alignTo(bitmapOffset + (pageCount + 63) / 64 * sizeof(quint64), ARENA_PAGE_SIZE),
+		total = dataOffset + (qint64)pageCount * ARENA_PAGE_SIZE;
+
+	QSharedPointer<Segment> segment(new Segment(_name));
+	bool created = segment->memory.create((int)total);
+	if (!created && (segment->memory.error() != QSharedMemory::AlreadyExists || !segment->memory.attach()))
+		return false;
+
+	// the creator builds the layout under the segment's lock. the segment is visible from its create() on, a process
+	// attaching before the creator took the lock finds no magic yet and looks again after a while
+	char * base = static_cast<char *>(segment->memory.data());
+	ArenaHeader * header = reinterpret_cast<ArenaHeader *>(base);
+	for (int retry = 0; ; ++retry)
+	{
+		segment->memory.lock();
+		if (created || header->magic == ARENA_MAGIC || retry == ARENA_OPEN_RETRIES)
+			break;
+
+		segment->memory.unlock();
+		QThread::msleep(ARENA_OPEN_RETRY_MS);
+	}
+
+	if (created)
+	{
+		memset(base, 0, dataOffset);
+		new (header) ArenaHeader();
+		header->version = ARENA_VERSION;
+		header->slotCount = slotCount;
+		header->pageCount = pageCount;
+		header->processesOffset = processesOffset;
+		header->slotsOffset = slotsOffset;
+		header->bitmapOffset = bitmapOffset;
+		header->dataOffset = dataOffset;
+		header->clock.store(0);
+
+		ArenaProcess * processes = reinterpret_cast<ArenaProcess *>(base + processesOffset);
+		for (int i = 0; i < ARENA_MAX_PROCESSES; ++i)
+		{
+			new (processes + i) ArenaProcess();
+			processes[i].pid.store(0);
+			for (int j = 0; j < ARENA_PROCESS_PINS; ++j)
+				processes[i].pins[j].store(0);
+		}
+
+		Slot * slotTable = reinterpret_cast<Slot *>(base + slotsOffset);
+		for (quint32 i = 0; i < slotCount; ++i)
+		{
+			new (slotTable + i) Slot();
+			slotTable[i].pins.store(-1);
+			slotTable[i].lastUse.store(0);
+			slotTable[i].cachePins.store(0);
+		}
+
+		header->magic = ARENA_MAGIC;
+	}
+
+	bool valid =
+		header->magic == ARENA_MAGIC &&
+		header->version == ARENA_VERSION &&
+		segment->memory.size() >= header->dataOffset + (qint64)header->pageCount * ARENA_PAGE_SIZE;
+	if (valid)
+	{
+		segment->header = header;
+		segment->slotTable = reinterpret_cast<Slot *>(base + header->slotsOffset);
+		segment->bitmap = reinterpret_cast<quint64 *>(base + header->bitmapOffset);
+		segment->data = base + header->dataOffset;
+
+		// a worker coming up is often the one replacing a crashed one, whose pins go first
+		ArenaProcess * processes = reinterpret_cast<ArenaProcess *>(base + header->processesOffset);
+		releaseDeadProcesses(segment.data());
+		for (int i = 0; i < ARENA_MAX_PROCESSES && !segment->process; ++i)
+		{
+			if (processes[i].pid.load() == 0)
+			{
+				segment->process = processes + i;
+				segment->process->pid.store(QCoreApplication::applicationPid());
+			}
+		}
+		valid = segment->process != nullptr;
+	}
+	segment->memory.unlock();
+
+	if (!valid)
+		return false;
+
+	mSegment = segment;
+
+	return true;
+}
+
+void SharedPatchArena::close()
+{
+	// blocks still in use keep the segment attached through their storage
+	mSegment.clear();
+}
+
+bool SharedPatchArena::isOpen() const
+{
+	return !mSegment.isNull();
+}
+
+PointBlock SharedPatchArena::load(const QString & _key)
+{
+	if (mSegment.isNull())
+		return PointBlock();
+
+	Slot * slot = find(digest(_key));
+	if (!slot)
+		return PointBlock();
+
+	slot->lastUse.store(mSegment->header->clock.fetch_add(1) + 1, std::memory_order_relaxed);
+	return view(slot);
+}
+
+PointBlock SharedPatchArena::store(const QString & _key, const PointBlock & _block)
+{
+	if (mSegment.isNull() || !_block.isValid())
+		return PointBlock();
+
+	QByteArray key = digest(_key);
+	quint32 pages = (quint32)((_block.byteSize() + ARENA_PAGE_SIZE - 1) / ARENA_PAGE_SIZE);
+	if (pages > mSegment->header->pageCount)
+		return PointBlock();
+
+	mSegment->memory.lock();
+
+	// another process may have stored it since the caller's load
+	Slot * slot = find(key);
+	if (!slot && ((slot = claim(key)) || (releaseDeadProcesses(mSegment.data()) && (slot = claim(key)))))
+	{
+		qint64 first = findPages(pages);
+		while (first < 0 && (evictLeastRecent() || releaseDeadProcesses(mSegment.data())))
+			first = findPages(pages);
+
+		if (first >= 0)
+		{
+			markPages((quint32)first, pages, true);
+			slot->firstPage = (quint32)first;
+			slot->pageCount = pages;
+			slot->size = _block.byteSize();
+			memcpy(mSegment->data + first * ARENA_PAGE_SIZE, _block.storage()->data(), _block.byteSize());
+			memcpy(slot->digest, key.constData(), ARENA_DIGEST_SIZE);
+			slot->lastUse.store(mSegment->header->clock.fetch_add(1) + 1, std::memory_order_relaxed);
+
+			// published, then pinned for the caller like any reader
+			slot->pins.store(0, std::memory_order_release);
+			if (!pin(mSegment.data(), slot))
+				slot = nullptr;
+		}
+		else
+			slot = nullptr;
+	}
+
+	mSegment->memory.unlock();
+
+	return slot ? view(slot) : PointBlock();
+}
+
+qint64 SharedPatchArena::capacity() const
+{
+	return mSegment.isNull() ? 0 : (qint64)mSegment->header->pageCount * ARENA_PAGE_SIZE;
+}
+
+int SharedPatchArena::blockCount() const
+{
+	if (mSegment.isNull())
+		return 0;
+
+	int count = 0;
+	for (quint32 i = 0; i < mSegment->header->slotCount; ++i)
+		count += mSegment->slotTable[i].pins.load(std::memory_order_relaxed) >= 0 ? 1 : 0;
+	return count;
+}
+
+SharedPatchArena::Slot * SharedPatchArena::find(const QByteArray & _digest) const
+{
+	quint64 hash = 0;
+	memcpy(&hash, _digest.constData(), sizeof(hash));
+
+	quint32 slotCount = mSegment->header->slotCount;
+	for (quint32 p = 0; p < ARENA_PROBE_LENGTH && p < slotCount; ++p)
+	{
+		Slot * slot = mSegment->slotTable + (hash + p) % slotCount;
+		if (memcmp(slot->digest, _digest.constData(), ARENA_DIGEST_SIZE) != 0 || !pin(mSegment.data(), slot))
+			continue;
+
+		// checked again under the pin since the slot may have been reused in between
+		if (memcmp(slot->digest, _digest.constData(), ARENA_DIGEST_SIZE) == 0)
+			return slot;
+
+		unpin(mSegment.data(), slot);
+	}
+
+	return nullptr;
+}
+
+bool SharedPatchArena::pin(Segment * _segment, Slot * _slot)
+{
+	// taken only while the slot is published
+	qint32 pins = _slot->pins.load(std::memory_order_acquire);
+	while (pins >= 0 && !_slot->pins.compare_exchange_weak(pins, pins + 1, std::memory_order_acq_rel))
+		;
+	if (pins < 0)
+		return false;
+
+	// recorded in the process's pins from the slot's own place on, without room for it the slot is left alone
+	qint32 index = (qint32)(_slot - _segment->slotTable) + 1;
+	for (int i = 0; i < ARENA_PROCESS_PINS; ++i)
+	{
+		qint32 free = 0;
+		if (_segment->process->pins[(index + i) % ARENA_PROCESS_PINS].compare_exchange_strong(free, index, std::memory_order_acq_rel))
+			return true;
+	}
+
+	_slot->pins.fetch_sub(1, std::memory_order_release);
+	return false;
+}
+
+void SharedPatchArena::unpin(Segment * _segment, Slot * _slot)
+{
+	// the record goes first: a process dying in between leaks the pin instead of having it dropped twice
+	qint32 index = (qint32)(_slot - _segment->slotTable) + 1;
+	for (int i = 0; i < ARENA_PROCESS_PINS; ++i)
+	{
+		qint32 held = index;
+		if (_segment->process->pins[(index + i) % ARENA_PROCESS_PINS].compare_exchange_strong(held, 0, std::memory_order_acq_rel))
+			break;
+	}
+	_slot->pins.fetch_sub(1, std::memory_order_release);
+}
+
+PointBlock SharedPatchArena::view(Slot * _slot) const
+{
+	quint32 generation = (quint32)(_slot->cachePins.load(std::memory_order_acquire) >> 32);
+	return PointBlock(QSharedPointer<PointBlockStorage>(new View(mSegment, _slot, generation)));
+}
+
+bool SharedPatchArena::releaseDeadProcesses(Segment * _segment)
+{
+	bool res = false;
+	ArenaProcess * processes = reinterpret_cast<ArenaProcess *>(reinterpret_cast<char *>(_segment->header) + _segment->header->processesOffset);
+	for (int i = 0; i < ARENA_MAX_PROCESSES; ++i)
+	{
+		qint64 pid = processes[i].pid.load();
+		if (pid == 0 || processAlive(pid))
+			continue;
+
+		for (int j = 0; j < ARENA_PROCESS_PINS; ++j)
+		{
+			qint32 index = processes[i].pins[j].exchange(0);
+			if (index <= 0 || (quint32)index > _segment->header->slotCount)
+				continue;
+
+			std::atomic<qint32> & pins = _segment->slotTable[index - 1].pins;
+			qint32 count = pins.load(std::memory_order_acquire);
+			while (count > 0 && !pins.compare_exchange_weak(count, count - 1, std::memory_order_acq_rel))
+				;
+			res = true;
+		}
+		processes[i].pid.store(0);
+	}
+
+	return res;
+}
+
+SharedPatchArena::Slot * SharedPatchArena::claim(const QByteArray & _digest)
+{
+	quint64 hash = 0;
+	memcpy(&hash, _digest.constData(), sizeof(hash));
+
+	// a free slot of the probe window, else the one of it to evict first
+	quint32 slotCount = mSegment->header->slotCount;
+	Slot * victim = nullptr;
+	for (quint32 p = 0; p < ARENA_PROBE_LENGTH && p < slotCount; ++p)
+	{
+		Slot * slot = mSegment->slotTable + (hash + p) % slotCount;
+		qint32 pins = slot->pins.load(std::memory_order_acquire);
+		if (pins < 0)
+			return slot;
+		if (pins == 0)
+			victim = preferred(slot, victim);
+	}
+
+	return victim && reclaim(victim) ? victim : nullptr;
+}
+
+bool SharedPatchArena::evictLeastRecent()
+{
+	// a full scan, still nothing next to the database fetch that makes room necessary
+	Slot * victim = nullptr;
+	for (quint32 i = 0; i < mSegment->header->slotCount; ++i)
+	{
+		Slot * slot = mSegment->slotTable + i;
+		if (slot->pins.load(std::memory_order_relaxed) == 0)
+			victim = preferred(slot, victim);
+	}
+
+	return victim && reclaim(victim);
+}
+
+SharedPatchArena::Slot * SharedPatchArena::preferred(Slot * _slot, Slot * _victim)
+{
+	if (!_victim)
+		return _slot;
+
+	// a slot no process cache holds goes before a cached one, the least recently used first among either
+	bool
+		cached = (_slot->cachePins.load(std::memory_order_relaxed) & 0xffffffffULL) != 0,
+		victimCached = (_victim->cachePins.load(std::memory_order_relaxed) & 0xffffffffULL) != 0;
+	if (cached != victimCached)
+		return cached ? _victim : _slot;
+	return _slot->lastUse.load(std::memory_order_relaxed) < _victim->lastUse.load(std::memory_order_relaxed) ? _slot : _victim;
+}
+
+bool SharedPatchArena::reclaim(Slot * _slot)
+{
+	qint32 unpinned = 0;
+	if (!_slot->pins.compare_exchange_strong(unpinned, -1, std::memory_order_acq_rel))
+		return false;
+
+	// the handles of the old generation miss from here on, their cache pins go with it
+	quint64 generation = (_slot->cachePins.load(std::memory_order_acquire) >> 32) + 1;
+	_slot->cachePins.store(generation << 32, std::memory_order_release);
+	markPages(_slot->firstPage, _slot->pageCount, false);
+	return true;
+}
+
+qint64 SharedPatchArena::findPages(quint32 _count) const
+{
+	// first fit over the page bitmap, skipping full words
+	const quint64 * bitmap = mSegment->bitmap;
+	quint32 pageCount = mSegment->header->pageCount, run = 0;
+	for (quint32 p = 0; p < pageCount; ++p)
+	{
+		if ((p & 63) == 0 && bitmap[p >> 6] == ~0ULL)
+		{
+			run = 0;
+			p += 63;
+			continue;
+		}
+
+		if ((bitmap[p >> 6] >> (p & 63)) & 1)
+			run = 0;
+		else if (++run == _count)
+			return (qint64)p + 1 - _count;
+	}
+
+	return -1;
+}
+
+void SharedPatchArena::markPages(quint32 _first, quint32 _count, bool _used)
+{
+	quint64 * bitmap = mSegment->bitmap;
+	for (quint32 p = _first; p < _first + _count; ++p)
+	{
+		if (_used)
+			bitmap[p >> 6] |= 1ULL << (p & 63);
+		else
+			bitmap[p >> 6] &= ~(1ULL << (p & 63));
+	}
+}
+
+QByteArray SharedPatchArena::digest(const QString & _key)
+{
+	return QCryptographicHash::hash(_key.toUtf8(), QCryptographicHash::Sha1);
+}
\ No newline at end of file
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <QString>
+#include <QSharedPointer>
+#include "pointblock.h"
+
+namespace AnkaDepthLib
+{
+	// patch cache shared by the worker processes of a host: a named shared memory segment with a slot table and a
+	// page allocated data area. a patch loaded by one process is copied in once and every process reads it in place
+	// instead of fetching or copying it again. a block read from the arena pins its slot for as long as a reader holds
+	// it; the process caches keep handles with a cache pin of their own instead, which does not keep the slot from
+	// being reclaimed: the handle is pinned again when the cache hands the block out and misses once the slot holds
+	// another patch. lookups are lock free, only slots without readers are evicted, the ones no cache holds first and
+	// least recently used first; inserts and evictions take the segment's system lock. every attached process records
+	// its readers' pins in its entry of the segment's process table, the pins of a process found dead are dropped; its
+	// cache pins only make their slots look cached until they are reclaimed
+	class SharedPatchArena
+	{
+	public:
+		SharedPatchArena();
+		~SharedPatchArena();
+
+		// creates the segment _name of _bytes or attaches to the one another process created; zero bytes disables it
+		bool open(const QString & _name, qint64 _bytes);
+		void close();
+		bool isOpen() const;
+
+		// the block stored under _key, read in place; an invalid block if there is none
+		PointBlock load(const QString & _key);
+
+		// copies the block in under _key, evicting blocks nobody reads to make room, and returns the arena's block for
+		// it, also if another process stored the key meanwhile; an invalid block if the room left is all being read
+		PointBlock store(const QString & _key, const PointBlock & _block);
+
+		qint64 capacity() const;
+		int blockCount() const;
+
+	private:
+		class Segment;
+		class Slot;
+		class View;
+		class Handle;
+
+		// _digest's slot with a pin taken and recorded for this process, or nullptr
+		Slot * find(const QByteArray & _digest) const;
+		// a reader's pin of _slot if it is published, recorded for this process; false without room for the record
+		static bool pin(Segment * _segment, Slot * _slot);
+		static void unpin(Segment * _segment, Slot * _slot);
+		// the block of the pinned _slot, the view takes over the pin
+		PointBlock view(Slot * _slot) const;
+
+		// drops the pins of attached processes that are gone and frees their entries, true if a pin was dropped;
+		// under the system lock
+		static bool releaseDeadProcesses(Segment * _segment);
+		// a free slot of _digest's probe window, evicting one if needed; under the system lock
+		Slot * claim(const QByteArray & _digest);
+		// under the system lock
+		bool evictLeastRecent();
+		// the better of two slots to evict, _victim may be nullptr
+		static Slot * preferred(Slot * _slot, Slot * _victim);
+		// frees the pages of a slot without readers and moves it to the next generation, its handles miss from then on
+		bool reclaim(Slot * _slot);
+		qint64 findPages(quint32 _count) const;
+		void markPages(quint32 _first, quint32 _count, bool _used);
+
+		static QByteArray digest(const QString & _key);
+
+		QSharedPointer<Segment> mSegment;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,133 @@
+#include "sphericalprojector.h"
+#include "sphericalprojectorkernels.h"
+#include <cmath>
+
+using namespace AnkaDepthLib;
+
+SphericalProjector::SphericalProjector()
+{
+}
+
+void SphericalProjector::project(const PointBlock & _block, const LidarPoint & _center, double _heading, int _width, int _height,
+	float * _r, int * _x, int * _y)
+{
+	project(_block, _center, _heading, _width, _height, _r, _x, _y, level());
+}
+
+void SphericalProjector::project(const PointBlock & _block, const LidarPoint & _center, double _heading, int _width, int _height,
+	float * _r, int * _x, int * _y, SphericalProjectorLevel _level)
+{
+	int n = _block.count();
+	if (n == 0)
+		return;
+
+	// the block origin relative to the centre is taken in double, the float offsets only span the patch
+	double thetaBase = fmod(360.0 - (_heading + 90.0) + 360.0, 360.0);
+	if (thetaBase < 0.0)
+		thetaBase += 360.0;
+
+	SphericalProjectionFrame frame;
+	frame.originX = (float)(_block.originX() - _center.X);
+	frame.originY = (float)(_block.originY() - _center.Y);
+	frame.originZ = (float)(_block.originZ() - _center.Z);
+	frame.thetaBase = (float)thetaBase;
+	frame.scaleX = (float)(_width / 360.0);
+	frame.scaleY = (float)(_height / 180.0);
+	frame.width = _width;
+	frame.height = _height;
+
+	switch (std::min(_level, level()))
+	{
+	case SPL_AVX512:
+		sphericalProjectAVX512(frame, _block.x(), _block.y(), _block.z(), 0, n, _r, _x, _y);
+		break;
+	case SPL_AVX2:
+		sphericalProjectAVX2(frame, _block.x(), _block.y(), _block.z(), 0, n, _r, _x, _y);
+		break;
+	case SPL_SSE4:
+		sphericalProjectSSE4(frame, _block.x(), _block.y(), _block.z(), 0, n, _r, _x, _y);
+		break;
+	default:
+		sphericalProjectScalar(frame, _block.x(), _block.y(), _block.z(), 0, n, _r, _x, _y);
+		break;
+	}
+}
+
+SphericalProjectorLevel SphericalProjector::level()
+{
+	static const SphericalProjectorLevel detected = detectLevel();
+	return detected;
+}
+
+QString SphericalProjector::levelName(SphericalProjectorLevel _level)
+{
+	switch (_level)
+	{
+	case SPL_AVX512:
+		return "AVX-512";
+	case SPL_AVX2:
+		return "AVX2";
+	case SPL_SSE4:
+		return "SSE4.1";
+	default:
+		return "scalar";
+	}
+}
+
+SphericalProjectorLevel SphericalProjector::detectLevel()
+{
+	// checkHardwareSupport also accounts for the OS saving the wide registers
+	if (cv::checkHardwareSupport(CV_CPU_AVX_512F))
+		return SPL_AVX512;
+	if (cv::checkHardwareSupport(CV_CPU_AVX2))
+		return SPL_AVX2;
+	if (cv::checkHardwareSupport(CV_CPU_SSE4_1))
+		return SPL_SSE4;
+	return SPL_SCALAR;
+}
+
+float SphericalProjector::atan2Deg(float _y, float _x)
+{
+	float
+		ax = std::abs(_x),
+		ay = std::abs(_y),
+		t = std::min(ax, ay) / std::max(std::max(ax, ay), 1e-30f),
+		s = t * t,
+		a = t * (SPK_ATAN_C0 + s * (SPK_ATAN_C1 + s * (SPK_ATAN_C2 + s * (SPK_ATAN_C3 + s * (SPK_ATAN_C4 + s * SPK_ATAN_C5)))));
+
+	if (ay > ax)
+		a = SPK_HALF_PI - a;
+	if (_x < 0)
+		a = SPK_PI - a;
+	if (std::signbit(_y))
+		a = -a;
+
+	return a * SPK_RAD2DEG;
+}
+
+namespace AnkaDepthLib
+{
+	void sphericalProjectScalar(const SphericalProjectionFrame & _frame, const float * _x, const float * _y, const float * _z, int _begin, int _end, float * _r, int * _px, int * _py)
+	{
+		float x = 0, y = 0, z = 0, rho2 = 0, theta = 0, phi = 0;
+		for (int i = _begin; i < _end; ++i)
+		{
+			x = _frame.originX + _x[i];
+			y = _frame.originY + _y[i];
+			z = _frame.originZ + _z[i];
+			rho2 = x * x + y * y;
+
+			_r[i] = std::sqrt(rho2 + z * z);
+
+			theta = _frame.thetaBase - SphericalProjector::atan2Deg(y, x);
+			if (theta < 0.0f)
+				theta += 360.0f;
+			if (theta >= 360.0f)
+				theta -= 360.0f;
+			_px[i] = std::min((int)(theta * _frame.scaleX), _frame.width - 1);
+
+			phi = SphericalProjector::atan2Deg(std::sqrt(rho2), z);
+			_py[i] = std::min((int)(phi * _frame.scaleY), _frame.height - 1);
+		}
+	}
+}
\ No newline at end of file
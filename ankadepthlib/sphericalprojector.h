@@ -0,0 +1,34 @@
+#pragma once
+
+#include "ankadepthlibglobals.h"
+#include "lidarpoint.h"
+#include "pointblock.h"
+
+namespace AnkaDepthLib
+{
+	// batch version of LidarPoint::faceTo followed by get2D_X/get2D_Y: writes the distance and the pixel of every point
+	// of a block in one pass. atan2 is a polynomial with an error far below half a pixel, the kernel is picked at run
+	// time from the SSE4.1, AVX2 and AVX-512 builds the CPU supports
+	class SphericalProjector
+	{
+	public:
+		// _r, _x and _y receive _block.count() values; pixels are for a _width x _height panorama
+		static void project(const PointBlock & _block, const LidarPoint & _center, double _heading, int _width, int _height,
+			float * _r, int * _x, int * _y);
+
+		// the same with a given kernel, which is lowered to the best one the CPU supports
+		static void project(const PointBlock & _block, const LidarPoint & _center, double _heading, int _width, int _height,
+			float * _r, int * _x, int * _y, SphericalProjectorLevel _level);
+
+		// best kernel the CPU supports, detected once
+		static SphericalProjectorLevel level();
+		static QString levelName(SphericalProjectorLevel _level);
+
+		// the atan2 approximation of the kernels, in degrees
+		static float atan2Deg(float _y, float _x);
+
+	private:
+		SphericalProjector();
+		static SphericalProjectorLevel detectLevel();
+	};
+}
\ No newline at end of file
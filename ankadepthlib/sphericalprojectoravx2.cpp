@@ -0,0 +1,74 @@
+#include "sphericalprojectorkernels.h"
+#include <immintrin.h>
+
+using namespace AnkaDepthLib;
+
+namespace
+{
+	// atan2 in degrees of eight lanes, the polynomial of SphericalProjector::atan2Deg
+	inline __m256 atan2Deg(__m256 _y, __m256 _x)
+	{
+		const __m256 sign = _mm256_set1_ps(-0.0f);
+		__m256
+			ax = _mm256_andnot_ps(sign, _x),
+			ay = _mm256_andnot_ps(sign, _y),
+			t = _mm256_div_ps(_mm256_min_ps(ax, ay), _mm256_max_ps(_mm256_max_ps(ax, ay), _mm256_set1_ps(1e-30f))),
+			s = _mm256_mul_ps(t, t),
+			a = _mm256_set1_ps(SPK_ATAN_C5);
+
+		a = _mm256_add_ps(_mm256_mul_ps(a, s), _mm256_set1_ps(SPK_ATAN_C4));
+		a = _mm256_add_ps(_mm256_mul_ps(a, s), _mm256_set1_ps(SPK_ATAN_C3));
+		a = _mm256_add_ps(_mm256_mul_ps(a, s), _mm256_set1_ps(SPK_ATAN_C2));
+		a = _mm256_add_ps(_mm256_mul_ps(a, s), _mm256_set1_ps(SPK_ATAN_C1));
+		a = _mm256_add_ps(_mm256_mul_ps(a, s), _mm256_set1_ps(SPK_ATAN_C0));
+		a = _mm256_mul_ps(a, t);
+
+		a = _mm256_blendv_ps(a, _mm256_sub_ps(_mm256_set1_ps(SPK_HALF_PI), a), _mm256_cmp_ps(ay, ax, _CMP_GT_OQ));
+		a = _mm256_blendv_ps(a, _mm256_sub_ps(_mm256_set1_ps(SPK_PI), a), _mm256_cmp_ps(_x, _mm256_setzero_ps(), _CMP_LT_OQ));
+		a = _mm256_xor_ps(a, _mm256_and_ps(sign, _y));
+
+		return _mm256_mul_ps(a, _mm256_set1_ps(SPK_RAD2DEG));
+	}
+}
+
+namespace AnkaDepthLib
+{
+	void sphericalProjectAVX2(const SphericalProjectionFrame & _frame, const float * _x, const float * _y, const float * _z, int _begin, int _end, float * _r, int * _px, int * _py)
+	{
+		const __m256
+			ox = _mm256_set1_ps(_frame.originX),
+			oy = _mm256_set1_ps(_frame.originY),
+			oz = _mm256_set1_ps(_frame.originZ),
+			base = _mm256_set1_ps(_frame.thetaBase),
+			full = _mm256_set1_ps(360.0f),
+			scaleX = _mm256_set1_ps(_frame.scaleX),
+			scaleY = _mm256_set1_ps(_frame.scaleY);
+		const __m256i
+			maxX = _mm256_set1_epi32(_frame.width - 1),
+			maxY = _mm256_set1_epi32(_frame.height - 1);
+
+		int i = _begin;
+		for (; i + 8 <= _end; i += 8)
+		{
+			__m256
+				x = _mm256_add_ps(ox, _mm256_loadu_ps(_x + i)),
+				y = _mm256_add_ps(oy, _mm256_loadu_ps(_y + i)),
+				z = _mm256_add_ps(oz, _mm256_loadu_ps(_z + i)),
+				rho2 = _mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y));
+
+			_mm256_storeu_ps(_r + i, _mm256_sqrt_ps(_mm256_add_ps(rho2, _mm256_mul_ps(z, z))));
+
+			__m256 theta = _mm256_sub_ps(base, atan2Deg(y, x));
+			theta = _mm256_add_ps(theta, _mm256_and_ps(full, _mm256_cmp_ps(theta, _mm256_setzero_ps(), _CMP_LT_OQ)));
+			theta = _mm256_sub_ps(theta, _mm256_and_ps(full, _mm256_cmp_ps(theta, full, _CMP_GE_OQ)));
+			_mm256_storeu_si256((__m256i *)(_px + i), _mm256_min_epi32(_mm256_cvttps_epi32(_mm256_mul_ps(theta, scaleX)), maxX));
+
+			__m256 phi = atan2Deg(_mm256_sqrt_ps(rho2), z);
+			_mm256_storeu_si256((__m256i *)(_py + i), _mm256_min_epi32(_mm256_cvttps_epi32(_mm256_mul_ps(phi, scaleY)), maxY));
+		}
+
+		// leaves the upper halves clean for the SSE code that follows
+		_mm256_zeroupper();
+		sphericalProjectScalar(_frame, _x, _y, _z, i, _end, _r, _px, _py);
+	}
+}
\ No newline at end of file
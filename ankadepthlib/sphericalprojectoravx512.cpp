@@ -0,0 +1,75 @@
+#include "sphericalprojectorkernels.h"
+#include <immintrin.h>
+
+using namespace AnkaDepthLib;
+
+namespace
+{
+	// atan2 in degrees of sixteen lanes, the polynomial of SphericalProjector::atan2Deg; only AVX-512F instructions,
+	// the float bit operations go through the integer unit
+	inline __m512 atan2Deg(__m512 _y, __m512 _x)
+	{
+		const __m512i sign = _mm512_set1_epi32((int)0x80000000);
+		__m512
+			ax = _mm512_abs_ps(_x),
+			ay = _mm512_abs_ps(_y),
+			t = _mm512_div_ps(_mm512_min_ps(ax, ay), _mm512_max_ps(_mm512_max_ps(ax, ay), _mm512_set1_ps(1e-30f))),
+			s = _mm512_mul_ps(t, t),
+			a = _mm512_set1_ps(SPK_ATAN_C5);
+
+		a = _mm512_add_ps(_mm512_mul_ps(a, s), _mm512_set1_ps(SPK_ATAN_C4));
+		a = _mm512_add_ps(_mm512_mul_ps(a, s), _mm512_set1_ps(SPK_ATAN_C3));
+		a = _mm512_add_ps(_mm512_mul_ps(a, s), _mm512_set1_ps(SPK_ATAN_C2));
+		a = _mm512_add_ps(_mm512_mul_ps(a, s), _mm512_set1_ps(SPK_ATAN_C1));
+		a = _mm512_add_ps(_mm512_mul_ps(a, s), _mm512_set1_ps(SPK_ATAN_C0));
+		a = _mm512_mul_ps(a, t);
+
+		a = _mm512_mask_sub_ps(a, _mm512_cmp_ps_mask(ay, ax, _CMP_GT_OQ), _mm512_set1_ps(SPK_HALF_PI), a);
+		a = _mm512_mask_sub_ps(a, _mm512_cmp_ps_mask(_x, _mm512_setzero_ps(), _CMP_LT_OQ), _mm512_set1_ps(SPK_PI), a);
+		a = _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(a), _mm512_and_si512(sign, _mm512_castps_si512(_y))));
+
+		return _mm512_mul_ps(a, _mm512_set1_ps(SPK_RAD2DEG));
+	}
+}
+
+namespace AnkaDepthLib
+{
+	void sphericalProjectAVX512(const SphericalProjectionFrame & _frame, const float * _x, const float * _y, const float * _z, int _begin, int _end, float * _r, int * _px, int * _py)
+	{
+		const __m512
+			ox = _mm512_set1_ps(_frame.originX),
+			oy = _mm512_set1_ps(_frame.originY),
+			oz = _mm512_set1_ps(_frame.originZ),
+			base = _mm512_set1_ps(_frame.thetaBase),
+			full = _mm512_set1_ps(360.0f),
+			zero = _mm512_setzero_ps(),
+			scaleX = _mm512_set1_ps(_frame.scaleX),
+			scaleY = _mm512_set1_ps(_frame.scaleY);
+		const __m512i
+			maxX = _mm512_set1_epi32(_frame.width - 1),
+			maxY = _mm512_set1_epi32(_frame.height - 1);
+
+		int i = _begin;
+		for (; i + 16 <= _end; i += 16)
+		{
+			__m512
+				x = _mm512_add_ps(ox, _mm512_loadu_ps(_x + i)),
+				y = _mm512_add_ps(oy, _mm512_loadu_ps(_y + i)),
+				z = _mm512_add_ps(oz, _mm512_loadu_ps(_z + i)),
+				rho2 = _mm512_add_ps(_mm512_mul_ps(x, x), _mm512_mul_ps(y, y));
+
+			_mm512_storeu_ps(_r + i, _mm512_sqrt_ps(_mm512_add_ps(rho2, _mm512_mul_ps(z, z))));
+
+			__m512 theta = _mm512_sub_ps(base, atan2Deg(y, x));
+			theta = _mm512_mask_add_ps(theta, _mm512_cmp_ps_mask(theta, zero, _CMP_LT_OQ), theta, full);
+			theta = _mm512_mask_sub_ps(theta, _mm512_cmp_ps_mask(theta, full, _CMP_GE_OQ), theta, full);
+			_mm512_storeu_si512(_px + i, _mm512_min_epi32(_mm512_cvttps_epi32(_mm512_mul_ps(theta, scaleX)), maxX));
+
+			__m512 phi = atan2Deg(_mm512_sqrt_ps(rho2), z);
+			_mm512_storeu_si512(_py + i, _mm512_min_epi32(_mm512_cvttps_epi32(_mm512_mul_ps(phi, scaleY)), maxY));
+		}
+
+		_mm256_zeroupper();
+		sphericalProjectScalar(_frame, _x, _y, _z, i, _end, _r, _px, _py);
+	}
+}
\ No newline at end of file
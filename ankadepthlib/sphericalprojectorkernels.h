@@ -0,0 +1,37 @@
+#pragma once
+
+namespace AnkaDepthLib
+{
+	// the kernels are built with their own instruction set flags, so this header must not pull in any Qt or OpenCV
+	// header: an inline function instantiated in an AVX translation unit may be the copy the linker keeps for everyone
+	class SphericalProjectionFrame
+	{
+	public:
+		float originX;		// block origin relative to the projection centre
+		float originY;
+		float originZ;
+		float thetaBase;	// 630 - heading wrapped to [0, 360), theta is thetaBase - atan2(y, x) in degrees
+		float scaleX;		// pixels per degree
+		float scaleY;
+		int width;
+		int height;
+	};
+
+	// atan(t) for t in [0, 1], max error 2e-6 rad; shared by every kernel so all levels agree on the pixels. every
+	// kernel multiplies and adds in the order of the scalar code, without fused multiply-adds, which round once less
+#define SPK_ATAN_C0		0.99997726f
+#define SPK_ATAN_C1		-0.33262347f
+#define SPK_ATAN_C2		0.19354346f
+#define SPK_ATAN_C3		-0.11643287f
+#define SPK_ATAN_C4		0.05265332f
+#define SPK_ATAN_C5		-0.01172120f
+#define SPK_HALF_PI		1.57079637f
+#define SPK_PI			3.14159274f
+#define SPK_RAD2DEG		57.2957795f
+
+	// project the points [_begin, _end) of the block arrays, writing distance and pixel coordinates
+	void sphericalProjectScalar(const SphericalProjectionFrame & _frame, const float * _x, const float * _y, const float * _z, int _begin, int _end, float * _r, int * _px, int * _py);
+	void sphericalProjectSSE4(const SphericalProjectionFrame & _frame, const float * _x, const float * _y, const float * _z, int _begin, int _end, float * _r, int * _px, int * _py);
+	void sphericalProjectAVX2(const SphericalProjectionFrame & _frame, const float * _x, const float * _y, const float * _z, int _begin, int _end, float * _r, int * _px, int * _py);
+	void sphericalProjectAVX512(const SphericalProjectionFrame & _frame, const float * _x, const float * _y, const float * _z, int _begin, int _end, float * _r, int * _px, int * _py);
+}
\ No newline at end of file
@@ -0,0 +1,73 @@
+#include "sphericalprojectorkernels.h"
+#include <immintrin.h>
+
+using namespace AnkaDepthLib;
+
+namespace
+{
+	// atan2 in degrees of four lanes, the polynomial of SphericalProjector::atan2Deg
+	inline __m128 atan2Deg(__m128 _y, __m128 _x)
+	{
+		const __m128 sign = _mm_set1_ps(-0.0f);
+		__m128
+			ax = _mm_andnot_ps(sign, _x),
+			ay = _mm_andnot_ps(sign, _y),
+			t = _mm_div_ps(_mm_min_ps(ax, ay), _mm_max_ps(_mm_max_ps(ax, ay), _mm_set1_ps(1e-30f))),
+			s = _mm_mul_ps(t, t),
+			a = _mm_set1_ps(SPK_ATAN_C5);
+
+		a = _mm_add_ps(_mm_mul_ps(a, s), _mm_set1_ps(SPK_ATAN_C4));
+		a = _mm_add_ps(_mm_mul_ps(a, s), _mm_set1_ps(SPK_ATAN_C3));
+		a = _mm_add_ps(_mm_mul_ps(a, s), _mm_set1_ps(SPK_ATAN_C2));
+		a = _mm_add_ps(_mm_mul_ps(a, s), _mm_set1_ps(SPK_ATAN_C1));
+		a = _mm_add_ps(_mm_mul_ps(a, s), _mm_set1_ps(SPK_ATAN_C0));
+		a = _mm_mul_ps(a, t);
+
+		a = _mm_blendv_ps(a, _mm_sub_ps(_mm_set1_ps(SPK_HALF_PI), a), _mm_cmpgt_ps(ay, ax));
+		a = _mm_blendv_ps(a, _mm_sub_ps(_mm_set1_ps(SPK_PI), a), _mm_cmplt_ps(_x, _mm_setzero_ps()));
+		a = _mm_xor_ps(a, _mm_and_ps(sign, _y));
+
+		return _mm_mul_ps(a, _mm_set1_ps(SPK_RAD2DEG));
+	}
+}
+
+namespace AnkaDepthLib
+{
+	void sphericalProjectSSE4(const SphericalProjectionFrame & _frame, const float * _x, const float * _y, const float * _z, int _begin, int _end, float * _r, int * _px, int * _py)
+	{
+		const __m128
+			ox = _mm_set1_ps(_frame.originX),
+			oy = _mm_set1_ps(_frame.originY),
+			oz = _mm_set1_ps(_frame.originZ),
+			base = _mm_set1_ps(_frame.thetaBase),
+			full = _mm_set1_ps(360.0f),
+			scaleX = _mm_set1_ps(_frame.scaleX),
+			scaleY = _mm_set1_ps(_frame.scaleY);
+		const __m128i
+			maxX = _mm_set1_epi32(_frame.width - 1),
+			maxY = _mm_set1_epi32(_frame.height - 1);
+
+		int i = _begin;
+		for (; i + 4 <= _end; i += 4)
+		{
+			__m128
+				x = _mm_add_ps(ox, _mm_loadu_ps(_x + i)),
+				y = _mm_add_ps(oy, _mm_loadu_ps(_y + i)),
+				z = _mm_add_ps(oz, _mm_loadu_ps(_z + i)),
+				rho2 = _mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y));
+
+			_mm_storeu_ps(_r + i, _mm_sqrt_ps(_mm_add_ps(rho2, _mm_mul_ps(z, z))));
+
+			// theta lies within 180 degrees of the base, a single wrap in either direction brings it to [0, 360)
+			__m128 theta = _mm_sub_ps(base, atan2Deg(y, x));
+			theta = _mm_add_ps(theta, _mm_and_ps(full, _mm_cmplt_ps(theta, _mm_setzero_ps())));
+			theta = _mm_sub_ps(theta, _mm_and_ps(full, _mm_cmpge_ps(theta, full)));
+			_mm_storeu_si128((__m128i *)(_px + i), _mm_min_epi32(_mm_cvttps_epi32(_mm_mul_ps(theta, scaleX)), maxX));
+
+			__m128 phi = atan2Deg(_mm_sqrt_ps(rho2), z);
+			_mm_storeu_si128((__m128i *)(_py + i), _mm_min_epi32(_mm_cvttps_epi32(_mm_mul_ps(phi, scaleY)), maxY));
+		}
+
+		sphericalProjectScalar(_frame, _x, _y, _z, i, _end, _r, _px, _py);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,202 @@
+#include "taskrunscheduler.h"
+#include <QMap>
+#include <QPair>
+#include <QVector>
+#include <algorithm>
+
+using namespace AnkaDepthLib;
+
+#define HILBERT_ORDER	16
+
+TaskRunScheduler::TaskRunScheduler()
+	: mCount(0)
+{
+}
+
+TaskRunScheduler::~TaskRunScheduler()
+{
+	// the tasks belong to the manager
+	qDeleteAll(mRuns);
+}
+
+void TaskRunScheduler::build(const DepthTaskList & _tasks, SchedulingMode _mode)
+{
+	qDeleteAll(mRuns);
+	mRuns.clear();
+	mFree.clear();
+	mOwned.clear();
+	mCount = _tasks.count();
+
+	QMap<QString, DepthTaskList> drives;
+	for (DepthTaskList::const_iterator it = _tasks.constBegin(); it != _tasks.constEnd(); ++it)
+		drives[driveOf(*it)].push_back(*it);
+
+	for (QMap<QString, DepthTaskList>::iterator it = drives.begin(); it != drives.end(); ++it)
+	{
+		DepthTaskList & tasks = it.value();
+		std::sort(tasks.begin(), tasks.end(), DepthTaskIdLessThan);
+
+		// a drive passing the same streets again gets its passes over a place next to each other; frames sharing a
+		// cell of the curve stay in id order
+		if (_mode == SM_HILBERT_RUNS && tasks.count() > 1)
+		{
+			double
+				xMin = tasks.first()->x(), xMax = xMin,
+				yMin = tasks.first()->y(), yMax = yMin;
+			for (DepthTaskList::iterator task = tasks.begin(); task != tasks.end(); ++task)
+			{
+				xMin = std::min(xMin, (*task)->x());
+				xMax = std::max(xMax, (*task)->x());
+				yMin = std::min(yMin, (*task)->y());
+				yMax = std::max(yMax, (*task)->y());
+			}
+
+			double
+				cells = (double)((1u << HILBERT_ORDER) - 1),
+				scale = std::max(xMax - xMin, yMax - yMin) > 0 ? cells / std::max(xMax - xMin, yMax - yMin) : 0;
+			QVector<QPair<quint64, DepthTask *>> keyed;
+			keyed.reserve(tasks.count());
+			for (DepthTaskList::iterator task = tasks.begin(); task != tasks.end(); ++task)
+				keyed.push_back(qMakePair(hilbertIndex((quint32)(((*task)->x() - xMin) * scale), (quint32)(((*task)->y() - yMin) * scale), HILBERT_ORDER), *task));
+			std::stable_sort(keyed.begin(), keyed.end(), [](const QPair<quint64, DepthTask *> & _left, const QPair<quint64, DepthTask *> & _right)
+			{
+				return _left.first < _right.first;
+			});
+
+			for (int i = 0; i < keyed.count(); ++i)
+				tasks[i] = keyed[i].second;
+		}
+
+		Run * run = new Run();
+		run->drive = it.key();
+		run->tasks = tasks;
+		mRuns.push_back(run);
+		mFree.push_back(run);
+	}
+}
+
+DepthTask * TaskRunScheduler::take(const QString & _worker)
+{
+	Run * run = mOwned.value(_worker);
+	if (!run || run->tasks.isEmpty())
+	{
+		if (run)
+			drop(run);
+		run = assign(_worker);
+	}
+
+	if (!run)
+		return nullptr;
+
+	--mCount;
+	return run->tasks.takeFirst();
+}
+
+void TaskRunScheduler::requeue(DepthTask * _task)
+{
+	// onto the front of the first free run when it is of the same drive, a run of its own otherwise
+	QString drive = driveOf(_task);
+	Run * run = mFree.isEmpty() ? nullptr : mFree.first();
+	if (!run || run->drive != drive)
+	{
+		run = new Run();
+		run->drive = drive;
+		mRuns.push_back(run);
+		mFree.push_front(run);
+	}
+
+	run->tasks.push_front(_task);
+	++mCount;
+}
+
+void TaskRunScheduler::release(const QString & _worker)
+{
+	Run * run = mOwned.take(_worker);
+	if (!run)
+		return;
+
+	run->owner.clear();
+	if (run->tasks.isEmpty())
+		drop(run);
+	else
+		mFree.push_front(run);
+}
+
+int TaskRunScheduler::count() const
+{
+	return mCount;
+}
+
+int TaskRunScheduler::runCount() const
+{
+	return mRuns.count();
+}
+
+quint64 TaskRunScheduler::hilbertIndex(quint32 _x, quint32 _y, int _order)
+{
+	quint64 res = 0, n = 1ULL << _order, x = _x, y = _y;
+	for (quint64 s = n / 2; s > 0; s /= 2)
+	{
+		quint64
+			rx = (x & s) > 0 ? 1 : 0,
+			ry = (y & s) > 0 ? 1 : 0;
+		res += s * s * ((3 * rx) ^ ry);
+
+		// the quadrant turned back to the curve's base orientation
+		if (ry == 0)
+		{
+			if (rx == 1)
+			{
+				x = n - 1 - x;
+				y = n - 1 - y;
+			}
+			std::swap(x, y);
+		}
+	}
+
+	return res;
+}
+
+TaskRunScheduler::Run * TaskRunScheduler::assign(const QString & _worker)
+{
+	Run * run = nullptr;
+	if (!mFree.isEmpty())
+		run = mFree.takeFirst();
+	else
+	{
+		// the back half of the longest run, its owner keeps going from the front
+		Run * longest = nullptr;
+		for (QMap<QString, Run *>::const_iterator it = mOwned.constBegin(); it != mOwned.constEnd(); ++it)
+		{
+			if (it.value()->tasks.count() > 1 && (!longest || it.value()->tasks.count() > longest->tasks.count()))
+				longest = it.value();
+		}
+		if (!longest)
+			return nullptr;
+
+		int half = longest->tasks.count() / 2;
+		run = new Run();
+		run->drive = longest->drive;
+		run->tasks = longest->tasks.mid(half);
+		longest->tasks.erase(longest->tasks.begin() + half, longest->tasks.end());
+		mRuns.push_back(run);
+	}
+
+	run->owner = _worker;
+	mOwned.insert(_worker, run);
+	return run;
+}
+
+void TaskRunScheduler::drop(Run * _run)
+{
+	if (!_run->owner.isEmpty() && mOwned.value(_run->owner) == _run)
+		mOwned.remove(_run->owner);
+	mFree.removeAll(_run);
+	mRuns.removeAll(_run);
+	delete _run;
+}
+
+QString TaskRunScheduler::driveOf(DepthTask * _task)
+{
+	return QString("%1/%2").arg(_task->parentDir()).arg(_task->subDir());
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <QString>
+#include <QList>
+#include <QMap>
+#include "ankadepthlibglobals.h"
+#include "depthtask.h"
+
+namespace AnkaDepthLib
+{
+	// hands the manager's pending tasks out in spatially contiguous runs: one run per drive (sub_dir), its frames in id
+	// order or in the Hilbert order of their x/y, and each worker keeps taking from the front of its own run. a worker
+	// whose run is exhausted takes a run nobody has, else the back half of the longest run of another worker, so
+	// rebalancing only ever splits a run and the pieces stay contiguous
+	class TaskRunScheduler
+	{
+	public:
+		TaskRunScheduler();
+		~TaskRunScheduler();
+
+		// the runs of _tasks, which the scheduler holds from here on
+		void build(const DepthTaskList & _tasks, SchedulingMode _mode);
+
+		// the next task of _worker's run, nullptr when there is nothing left to hand out
+		DepthTask * take(const QString & _worker);
+
+		// a task handed out that is to run again, ahead of the runs nobody has
+		void requeue(DepthTask * _task);
+
+		// _worker left the grid, what is left of its run goes to the next worker needing one
+		void release(const QString & _worker);
+
+		int count() const;
+		int runCount() const;
+
+		// position of (_x, _y) on the Hilbert curve of a 2^_order by 2^_order grid
+		static quint64 hilbertIndex(quint32 _x, quint32 _y, int _order);
+
+	private:
+		class Run
+		{
+		public:
+			QString drive;
+			QString owner;
+			DepthTaskList tasks;
+		};
+
+		// a run for _worker, nullptr if every task is in someone's run of one task
+		Run * assign(const QString & _worker);
+		void drop(Run * _run);
+
+		static QString driveOf(DepthTask * _task);
+
+		QList<Run *> mFree;
+		QList<Run *> mRuns;
+		QMap<QString, Run *> mOwned;
+		int mCount;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,133 @@
+#include "timerwheel.h"
+#include <algorithm>
+
+using namespace AnkaDepthLib;
+
+TimerWheel::TimerWheel(qint64 _tick, int _slots)
+	:
+	mSlots(std::max(_slots, 1)),
+	mTick(std::max<qint64>(_tick, 1)),
+	mCurrent(0)
+{
+}
+
+void TimerWheel::schedule(int _id, qint64 _deadline)
+{
+	cancel(_id);
+
+	// a deadline already passed goes to the current tick and expires on the next call
+	int slot = slotOf(std::max(_deadline / mTick, mCurrent));
+	Entry entry;
+	entry.id = _id;
+	entry.deadline = _deadline;
+	mSlots[slot].push_back(entry);
+	mSlotOfId.insert(_id, slot);
+}
+
+bool TimerWheel::cancel(int _id)
+{
+	if (!mSlotOfId.contains(_id))
+		return false;
+
+	QList<Entry> & entries = mSlots[mSlotOfId.take(_id)];
+	for (QList<Entry>::iterator it = entries.begin(); it != entries.end(); ++it)
+	{
+		if (it->id == _id)
+		{
+			entries.erase(it);
+			break;
+		}
+	}
+	return true;
+}
+
+QVector<int> TimerWheel::expire(qint64 _now)
+{
+	QVector<int> res;
+	if (mSlotOfId.isEmpty() || _now < mCurrent * mTick)
+	{
+		mCurrent = std::max(mCurrent, _now / mTick);
+		return res;
+	}
+
+	// the current tick is walked again next time, deadlines later in it are not due yet; a gap of a whole turn
+	// walks every slot once
+	qint64 target = _now / mTick;
+	qint64 first = target - mCurrent >= mSlots.count() ? target - mSlots.count() + 1 : mCurrent;
+	QVector<Entry> due;
+	for (qint64 tick = first; tick <= target; ++tick)
+	{
+		QList<Entry> & entries = mSlots[slotOf(tick)];
+		for (QList<Entry>::iterator it = entries.begin(); it != entries.end();)
+		{
+			if (it->deadline <= _now)
+			{
+				due.push_back(*it);
+				mSlotOfId.remove(it->id);
+				it = entries.erase(it);
+			}
+			else
+				++it;
+		}
+	}
+	mCurrent = target;
+
+	std::stable_sort(due.begin(), due.end(), [](const Entry & _left, const Entry & _right)
+	{
+		return _left.deadline < _right.deadline;
+	});
+	res.reserve(due.count());
+	for (QVector<Entry>::const_iterator it = due.constBegin(); it != due.constEnd(); ++it)
+		res.push_back(it->id);
+
+	return res;
+}
+
+qint64 TimerWheel::nextDeadline() const
+{
+	if (mSlotOfId.isEmpty())
+		return -1;
+
+	// the first slot ahead holding a deadline of its own turn has the earliest one
+	for (qint64 tick = mCurrent; tick < mCurrent + mSlots.count(); ++tick)
+	{
+		qint64 res = -1;
+		const QList<Entry> & entries = mSlots[slotOf(tick)];
+		for (QList<Entry>::const_iterator it = entries.constBegin(); it != entries.constEnd(); ++it)
+		{
+			if (it->deadline / mTick <= tick && (res < 0 || it->deadline < res))
+				res = it->deadline;
+		}
+		if (res >= 0)
+			return res;
+	}
+
+	// every deadline is beyond this turn
+	qint64 res = -1;
+	for (QVector<QList<Entry>>::const_iterator slot = mSlots.constBegin(); slot != mSlots.constEnd(); ++slot)
+	{
+		for (QList<Entry>::const_iterator it = slot->constBegin(); it != slot->constEnd(); ++it)
+		{
+			if (res < 0 || it->deadline < res)
+				res = it->deadline;
+		}
+	}
+	return res;
+}
+
+int TimerWheel::count() const
+{
+	return mSlotOfId.count();
+}
+
+void TimerWheel::clear()
+{
+	for (QVector<QList<Entry>>::iterator it = mSlots.begin(); it != mSlots.end(); ++it)
+		it->clear();
+	mSlotOfId.clear();
+}
+
+int TimerWheel::slotOf(qint64 _tick) const
+{
+	return (int)(_tick % mSlots.count());
+}
\ No newline at end of file
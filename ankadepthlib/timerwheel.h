@@ -0,0 +1,50 @@
+#pragma once
+
+#include <QList>
+#include <QVector>
+#include <QHash>
+
+namespace AnkaDepthLib
+{
+	// hashed timing wheel of deadlines keyed by an id: a deadline goes into the slot of its tick, so scheduling and
+	// cancelling touch one slot and expiring walks only the slots of the ticks passed since the last call. deadlines
+	// further out than one turn of the wheel wait in their slot for the turns in between
+	class TimerWheel
+	{
+	public:
+		// _tick milliseconds per slot, _slots slots to a turn
+		TimerWheel(qint64 _tick = 1000, int _slots = 256);
+
+		// (re)schedules _id to expire at _deadline, in milliseconds on the caller's clock
+		void schedule(int _id, qint64 _deadline);
+
+		// false if _id was not scheduled
+		bool cancel(int _id);
+
+		// the ids whose deadlines are at or before _now, in deadline order, unscheduled
+		QVector<int> expire(qint64 _now);
+
+		// the earliest deadline scheduled, -1 when none is
+		qint64 nextDeadline() const;
+
+		int count() const;
+		void clear();
+
+	private:
+		class Entry
+		{
+		public:
+			int id;
+			qint64 deadline;
+		};
+
+		int slotOf(qint64 _tick) const;
+
+		QVector<QList<Entry>> mSlots;
+		QHash<int, int> mSlotOfId;
+		qint64 mTick;
+
+		// the tick expired last, the wheel never schedules behind it
+		qint64 mCurrent;
+	};
+}
\ No newline at end of file
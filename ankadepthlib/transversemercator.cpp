@@ -0,0 +1,201 @@
+#include "transversemercator.h"
+#include <opencv2/core/hal/intrin.hpp>
+#include <cmath>
+#include <algorithm>
+
+using namespace AnkaDepthLib;
+
+#define WGS84_A						6378137.0
+#define WGS84_F						(1.0 / 298.257223563)
+#define UTM_K0						0.9996
+#define UTM_FALSE_EASTING			500000.0
+#define UTM_FALSE_NORTHING_SOUTH	10000000.0
+#define TM_PI						3.14159265358979323846
+// stencil step of the local model and the offset from its anchor it is used for, both in degrees
+#define TM_MODEL_STEP				0.005
+#define TM_MODEL_RANGE				0.01
+// runs shorter than this are cheaper to project exactly than to fit
+#define TM_MODEL_MIN_RUN			16
+
+namespace
+{
+	// central differences of the values _f at the offsets (i h, j h), i, j in -1..1, stored at (j + 1) * 3 + i + 1
+	void fitQuadratic(const double * _f, double _h, double * _c)
+	{
+		_c[0] = _f[4];
+		_c[1] = (_f[5] - _f[3]) / (2.0 * _h);
+		_c[2] = (_f[7] - _f[1]) / (2.0 * _h);
+		_c[3] = (_f[5] - 2.0 * _f[4] + _f[3]) / (2.0 * _h * _h);
+		_c[4] = (_f[8] - _f[6] - _f[2] + _f[0]) / (4.0 * _h * _h);
+		_c[5] = (_f[7] - 2.0 * _f[4] + _f[1]) / (2.0 * _h * _h);
+	}
+}
+
+TransverseMercator::TransverseMercator(int _zone, bool _north)
+	:
+	mZone(_zone),
+	mNorth(_north),
+	mLon0((_zone * 6.0 - 183.0) * TM_PI / 180.0),
+	mFalseNorthing(_north ? 0.0 : UTM_FALSE_NORTHING_SOUTH)
+{
+	double
+		f = WGS84_F,
+		n = f / (2.0 - f),
+		n2 = n * n,
+		n3 = n2 * n,
+		n4 = n3 * n,
+		n5 = n4 * n,
+		n6 = n5 * n;
+
+	mE = std::sqrt(f * (2.0 - f));
+	// rectifying radius times the scale on the central meridian
+	mScaledA = UTM_K0 * WGS84_A / (1.0 + n) * (1.0 + n2 / 4.0 + n4 / 64.0 + n6 / 256.0);
+
+	mAlpha[0] = n / 2.0 - 2.0 * n2 / 3.0 + 5.0 * n3 / 16.0 + 41.0 * n4 / 180.0 - 127.0 * n5 / 288.0 + 7891.0 * n6 / 37800.0;
+	mAlpha[1] = 13.0 * n2 / 48.0 - 3.0 * n3 / 5.0 + 557.0 * n4 / 1440.0 + 281.0 * n5 / 630.0 - 1983433.0 * n6 / 1935360.0;
+	mAlpha[2] = 61.0 * n3 / 240.0 - 103.0 * n4 / 140.0 + 15061.0 * n5 / 26880.0 + 167603.0 * n6 / 181440.0;
+	mAlpha[3] = 49561.0 * n4 / 161280.0 - 179.0 * n5 / 168.0 + 6601661.0 * n6 / 7257600.0;
+	mAlpha[4] = 34729.0 * n5 / 80640.0 - 3418889.0 * n6 / 1995840.0;
+	mAlpha[5] = 212378941.0 * n6 / 319334400.0;
+}
+
+int TransverseMercator::zone() const
+{
+	return mZone;
+}
+
+bool TransverseMercator::isNorth() const
+{
+	return mNorth;
+}
+
+int TransverseMercator::srid() const
+{
+	return (mNorth ? 32600 : 32700) + mZone;
+}
+
+void TransverseMercator::forward(double _lon, double _lat, double & _x, double & _y) const
+{
+	double
+		phi = _lat * TM_PI / 180.0,
+		dl = _lon * TM_PI / 180.0 - mLon0,
+		sinPhi = std::sin(phi),
+		// tangent of the conformal latitude
+		t = std::sinh(std::atanh(sinPhi) - mE * std::atanh(mE * sinPhi)),
+		xi = std::atan2(t, std::cos(dl)),
+		eta = std::atanh(std::sin(dl) / std::sqrt(1.0 + t * t));
+
+	// the multiple angle terms by rotating cos/sin(2 xi) and cosh/sinh(2 eta) instead of 24 more transcendentals
+	double
+		c2 = std::cos(2.0 * xi),
+		s2 = std::sin(2.0 * xi),
+		ch2 = std::cosh(2.0 * eta),
+		sh2 = std::sinh(2.0 * eta),
+		c = c2,
+		s = s2,
+		ch = ch2,
+		sh = sh2,
+		x = eta,
+		y = xi,
+		tmp = 0;
+
+	for (int j = 0; j < 6; ++j)
+	{
+		x += mAlpha[j] * c * sh;
+		y += mAlpha[j] * s * ch;
+
+		tmp = c * c2 - s * s2;
+		s = s * c2 + c * s2;
+		c = tmp;
+		tmp = ch * ch2 + sh * sh2;
+		sh = sh * ch2 + ch * sh2;
+		ch = tmp;
+	}
+
+	_x = UTM_FALSE_EASTING + mScaledA * x;
+	_y = mFalseNorthing + mScaledA * y;
+}
+
+void TransverseMercator::degreesPerMetre(double _lat, double & _lonDegrees, double & _latDegrees)
+{
+	double
+		phi = _lat * TM_PI / 180.0,
+		e2 = WGS84_F * (2.0 - WGS84_F),
+		w = 1.0 - e2 * std::sin(phi) * std::sin(phi),
+		// prime vertical and meridional radii
+		n = WGS84_A / std::sqrt(w),
+		m = WGS84_A * (1.0 - e2) / (w * std::sqrt(w));
+
+	_lonDegrees = 180.0 / (TM_PI * n * std::max(std::cos(phi), 1e-12));
+	_latDegrees = 180.0 / (TM_PI * m);
+}
+
+void TransverseMercator::forward(const double * _lon, const double * _lat, int _count, double * _x, double * _y) const
+{
+	LocalModel model;
+	int begin = 0, end = 0;
+	while (begin < _count)
+	{
+		// the run the anchor covers, the model is only fitted if it pays off
+		end = begin + 1;
+		while (end < _count && std::abs(_lon[end] - _lon[begin]) <= TM_MODEL_RANGE && std::abs(_lat[end] - _lat[begin]) <= TM_MODEL_RANGE)
+			++end;
+
+		if (end - begin < TM_MODEL_MIN_RUN)
+		{
+			for (int i = begin; i < end; ++i)
+				forward(_lon[i], _lat[i], _x[i], _y[i]);
+		}
+		else
+		{
+			fitModel(_lon[begin], _lat[begin], model);
+			applyModel(model, _lon + begin, _lat + begin, end - begin, _x + begin, _y + begin);
+		}
+
+		begin = end;
+	}
+}
+
+void TransverseMercator::fitModel(double _lon, double _lat, LocalModel & _model) const
+{
+	double x[9], y[9];
+	for (int j = -1; j <= 1; ++j)
+		for (int i = -1; i <= 1; ++i)
+			forward(_lon + i * TM_MODEL_STEP, _lat + j * TM_MODEL_STEP, x[(j + 1) * 3 + i + 1], y[(j + 1) * 3 + i + 1]);
+
+	_model.lon = _lon;
+	_model.lat = _lat;
+	fitQuadratic(x, TM_MODEL_STEP, _model.x);
+	fitQuadratic(y, TM_MODEL_STEP, _model.y);
+}
+
+void TransverseMercator::applyModel(const LocalModel & _model, const double * _lon, const double * _lat, int _count, double * _x, double * _y)
+{
+	const double * cx = _model.x;
+	const double * cy = _model.y;
+	int i = 0;
+#if CV_SIMD128_64F
+	cv::v_float64x2
+		lon0 = cv::v_setall_f64(_model.lon), lat0 = cv::v_setall_f64(_model.lat),
+		x0 = cv::v_setall_f64(cx[0]), x1 = cv::v_setall_f64(cx[1]), x2 = cv::v_setall_f64(cx[2]),
+		x3 = cv::v_setall_f64(cx[3]), x4 = cv::v_setall_f64(cx[4]), x5 = cv::v_setall_f64(cx[5]),
+		y0 = cv::v_setall_f64(cy[0]), y1 = cv::v_setall_f64(cy[1]), y2 = cv::v_setall_f64(cy[2]),
+		y3 = cv::v_setall_f64(cy[3]), y4 = cv::v_setall_f64(cy[4]), y5 = cv::v_setall_f64(cy[5]);
+	for (; i <= _count - 2; i += 2)
+	{
+		cv::v_float64x2
+			u = cv::v_load(_lon + i) - lon0,
+			v = cv::v_load(_lat + i) - lat0;
+		cv::v_store(_x + i, x0 + u * (x1 + x3 * u + x4 * v) + v * (x2 + x5 * v));
+		cv::v_store(_y + i, y0 + u * (y1 + y3 * u + y4 * v) + v * (y2 + y5 * v));
+	}
+#endif
+	double u = 0, v = 0;
+	for (; i < _count; ++i)
+	{
+		u = _lon[i] - _model.lon;
+		v = _lat[i] - _model.lat;
+		_x[i] = cx[0] + u * (cx[1] + cx[3] * u + cx[4] * v) + v * (cx[2] + cx[5] * v);
+		_y[i] = cy[0] + u * (cy[1] + cy[3] * u + cy[4] * v) + v * (cy[2] + cy[5] * v);
+	}
+}
\ No newline at end of file
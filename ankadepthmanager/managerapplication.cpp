@@ -1,21 +1,29 @@
 #include "managerapplication.h"
 #include "computegridcommons.hpp"
 #include "ankadepthlibglobals.h"
+#include "transversemercator.h"
+#include "gridframe.h"
 #include <QCoreApplication>
 #include <QSqlDatabase>
 #include <QSqlQuery>
 #include <QSqlResult>
 #include <QSqlError>
 #include <QTextStream>
+#include <algorithm>
+#include <climits>
 
 using namespace ComputeGrid;
 using namespace AnkaDepthLib;
 
+#define WORK_SCHEDULE_CHECK_MSECS	1000
+
 ManagerApplication::ManagerApplication(QObject * _parent)
 	: QThread(_parent),
+	mWakeFlag(false),
 	mTotalTasksCount(0),
 	mCompletedTaskCounter(0),
-	mFailedTaskCounter(0)
+	mFailedTaskCounter(0),
+	mStatusDirty(true)
 {
 	mConfig.fromIni(QCoreApplication::applicationName() + "_config.ini");
 	
@@ -82,8 +90,6 @@ void ManagerApplication::run()
 					coordx as lon,\
 					coordy as lat,\
 					altitude,\
-					ST_X(ST_Transform(ST_GeomFromText(CONCAT('Point(', CAST(coordx as text), ' ', CAST(coordy as text), ')'), 4326), 32635)) as x,\
-					ST_Y(ST_Transform(ST_GeomFromText(CONCAT('Point(', CAST(coordx as text), ' ', CAST(coordy as text), ')'), 4326), 32635)) as y,\
 					dirname as parent_dir,\
 					filename as sub_dir,\
 					imgname as file_name,\
@@ -103,6 +109,20 @@ void ManagerApplication::run()
 				while (query.next())
 					mTasks.append(new DepthTask(query));
 
+				// the positions are projected to the configured UTM zone here instead of row by row on the server
+				QVector<double> xs(mTasks.count()), ys(mTasks.count());
+				for (int i = 0; i < mTasks.count(); ++i)
+				{
+					xs[i] = mTasks[i]->longtitude();
+					ys[i] = mTasks[i]->latitude();
+				}
+				TransverseMercator(mConfig.utmZone()).forward(xs.constData(), ys.constData(), xs.count(), xs.data(), ys.data());
+				for (int i = 0; i < mTasks.count(); ++i)
+				{
+					mTasks[i]->setX(xs[i]);
+					mTasks[i]->setY(ys[i]);
+				}
+
 				// sort by id
 				qSort(mTasks.begin(), mTasks.end(), AnkaDepthLib::DepthTaskIdLessThan);
 				mTotalTasksCount = mTasks.count();
@@ -167,6 +187,16 @@ void ManagerApplication::run()
 						emit out(ComputeGridGlobals::makeLogCommand(LS_MP, LT_WARNING, QString("%1 regions are dropped.").arg(mCompletedTaskCounter + mFailedTaskCounter)));
 					}
 				}
+
+				// in the run modes the scheduler holds the pending tasks from here on
+				if (mConfig.schedulingMode() != SM_SCATTERED)
+				{
+					mRWLock.lockForWrite();
+					mScheduler.build(mTasks, mConfig.schedulingMode());
+					mTasks.clear();
+					emit out(ComputeGridGlobals::makeLogCommand(LS_MP, LT_INFO, QString("%1 regions are split into %2 runs.").arg(mScheduler.count()).arg(mScheduler.runCount())));
+					mRWLock.unlock();
+				}
 			}
 			else
 			{
@@ -193,72 +223,115 @@ void ManagerApplication::run()
 #pragma endregion
 
 #pragma region Main-Loop
+	// the loop sleeps until a worker joins or leaves, results come in, the run is started or stopped, or the earliest
+	// task timeout or a held back status update is due; tasks are assigned and the status is built only then
 	bool running = false;
 	int pendingTasks = 0;
 	QString status;
+	QElapsedTimer statusTimer;
+	mClock.start();
+	mRWLock.lockForWrite();
 	while (!exitFlag)
 	{
-		if (running = checkIfNeedToWork())
+		mWakeFlag = false;
+		if (running != checkIfNeedToWork())
+		{
+			running = !running;
+			mStatusDirty = true;
+		}
+
+		if (running)
 		{
 			pendingTasks = 0;
 
+			// timed out tasks, found in the workers' lists only when one expires
+			QVector<int> timedOut = mTaskTimeouts.expire(mClock.elapsed());
+			for (QVector<int>::const_iterator id = timedOut.constBegin(); id != timedOut.constEnd(); ++id)
+			{
+				for (QMap<QString, DepthTaskList>::iterator worker = mWorkerTasksMap.begin(); worker != mWorkerTasksMap.end(); ++worker)
+				{
+					DepthTaskList::iterator it = worker.value().begin();
+					while (it != worker.value().end() && (*it)->id() != *id)
+						++it;
+					if (it == worker.value().end())
+						continue;
+
+					emit out(ComputeGridGlobals::makeLogCommand(LS_MP, LT_WARNING, QString("Region ID: %1 => Execution timed out on worker: %2. Task reqeueued.").arg(*id).arg(worker.key())));
+					returnTask(*it, false);
+					worker.value().erase(it);
+					break;
+				}
+			}
+
 			// task assign
-			mRWLock.lockForWrite();
 			DepthTask * task = nullptr;
 			for (int i = 0; i < mWorkers.count(); ++i)
 			{
 				QString worker = mWorkers[i];
 
-				// timeout check
-				for (DepthTaskList::iterator it = mWorkerTasksMap[worker].begin(); it != mWorkerTasksMap[worker].end();)
+				// assign new tasks; once the worker's queue beyond its running tasks has drained it is topped up to the
+				// queue depth, as one block for the workers taking batches
+				task = nullptr;
+				if (mWorkerTasksMap[worker].count() <= mWorkerCapacityMap[worker])
 				{
-					task = *it;
-					if (task->assingmentDateTime().secsTo(QDateTime::currentDateTime()) >= 600) // to do: make parametric
+					DepthTaskList assigned;
+					while (mWorkerTasksMap[worker].count() < mWorkerCapacityMap[worker] + mConfig.workerQueueDepth() && (task = takeTask(i)))
 					{
-						emit out(ComputeGridGlobals::makeLogCommand(LS_MP, LT_WARNING, QString("Region ID: %1 => Execution timed out on worker: %2. Task reqeueued.").arg(task->id()).arg(worker)));
-						mTasks.append(task);
-						it = mWorkerTasksMap[worker].erase(it);
+						task->setAssignmentDateTime(QDateTime::currentDateTime());
+						mTaskTimeouts.schedule(task->id(), mClock.elapsed() + mConfig.taskTimeout() * 1000LL);
+						mWorkerTasksMap[worker].push_back(task);
+						assigned.push_back(task);
 					}
-					else
-						++it;
-				}
-
-				// assign new tasks
-				task = nullptr;
-				while (mWorkerTasksMap[worker].count() < mWorkerCapacityMap[worker] && mTasks.count() > 0)
-				{
-					task = mTasks.takeAt(mTasks.count() > mWorkers.count() ? ((mTasks.count() / mWorkers.count()) * i) : 0);
-					task->setAssignmentDateTime(QDateTime::currentDateTime());
-					mWorkerTasksMap[worker].push_back(task);
-					emit out(ComputeGridGlobals::makeProcessCommand(PC_WORKER_DATA, QStringList() << worker << QString::number(DTPT_TASK_EXECUTE) << task->toString()));
+					sendTasks(worker, assigned);
 				}
 				pendingTasks += mWorkerTasksMap[worker].count();
 			}
 
-			if (mTasks.count() == 0 && pendingTasks == 0)
+			if (pendingTaskCount() == 0 && pendingTasks == 0)
 			{
 				emit out(ComputeGridGlobals::makeLogCommand(LS_MP, LT_WARNING, QString("All tasks are completed.")));
 				exitCode = 0;
 				exitFlag = true;
 			}
-			mRWLock.unlock();
 		}
 
-		// status update
-		mRWLock.lockForRead();
-		status = QString("Anka-Depth v%1 - Status: %2, Completed: <font color=\"green\">%3</font>, Failed: <font color=\"red\">%4</font>, Total: <font color=\"blue\">%5</font>, Workers: <font color=\"blue\">%6</font>, Progress: <font color=\"blue\">%%7</font>")
-			.arg(QString("%1.%2.%3.%4").arg(AnkaDepthLibGlobals::VersionMajor).arg(AnkaDepthLibGlobals::VersionMinor).arg(AnkaDepthLibGlobals::VersionPatch).arg(AnkaDepthLibGlobals::VersionBuild))
-			.arg(running ? "<font color=\"green\">Running</font>" : "<font color=\"red\">Waiting</font>")
-			.arg(mCompletedTaskCounter)
-			.arg(mFailedTaskCounter)
-			.arg(mTotalTasksCount)
-			.arg(mWorkers.count())
-			.arg(QString::number((double)(mFailedTaskCounter + mCompletedTaskCounter) / (double)mTotalTasksCount * 100.0, 'f', 2));
-		mRWLock.unlock();
+		// status update, at most one per status interval and the last one right away
+		unsigned long wait = ULONG_MAX;
+		if (mStatusDirty)
+		{
+			qint64 left = statusTimer.isValid() && !exitFlag ? mConfig.statusInterval() - statusTimer.elapsed() : 0;
+			if (left > 0)
+				wait = (unsigned long)left;
+			else
+			{
+				status = QString("Anka-Depth v%1 - Status: %2, Completed: <font color=\"green\">%3</font>, Failed: <font color=\"red\">%4</font>, Total: <font color=\"blue\">%5</font>, Workers: <font color=\"blue\">%6</font>, Progress: <font color=\"blue\">%%7</font>")
+					.arg(QString("%1.%2.%3.%4").arg(AnkaDepthLibGlobals::VersionMajor).arg(AnkaDepthLibGlobals::VersionMinor).arg(AnkaDepthLibGlobals::VersionPatch).arg(AnkaDepthLibGlobals::VersionBuild))
+					.arg(running ? "<font color=\"green\">Running</font>" : "<font color=\"red\">Waiting</font>")
+					.arg(mCompletedTaskCounter)
+					.arg(mFailedTaskCounter)
+					.arg(mTotalTasksCount)
+					.arg(mWorkers.count())
+					.arg(QString::number((double)(mFailedTaskCounter + mCompletedTaskCounter) / (double)mTotalTasksCount * 100.0, 'f', 2));
+				mStatusDirty = false;
+				statusTimer.start();
+
+				if (mLastStatus != status)
+					emit out(ComputeGridGlobals::makeProcessCommand(PC_STATUS_MESSAGE, QStringList() << (mLastStatus = status)));
+			}
+		}
+
+		// the earliest timeout, and the work schedule's window opening or closing with no event to tell
+		qint64 timeout = running ? mTaskTimeouts.nextDeadline() : -1;
+		if (timeout >= 0)
+			wait = std::min(wait, (unsigned long)std::max<qint64>(timeout - mClock.elapsed(), 0));
+		if (mStartFlag && mConfig.scheduledWork())
+			wait = std::min(wait, (unsigned long)WORK_SCHEDULE_CHECK_MSECS);
 
-		if (mLastStatus != status)
-			emit out(ComputeGridGlobals::makeProcessCommand(PC_STATUS_MESSAGE, QStringList() << (mLastStatus = status)));
+		// events coming while the loop ran are not waited for
+		if (!exitFlag && !mWakeFlag)
+			mWakeCondition.wait(&mRWLock, wait);
 	}
+	mRWLock.unlock();
 #pragma endregion
 
 	emit out(ComputeGridGlobals::makeLogCommand(LS_MP, LT_WARNING, QString("Process is exiting...")));
@@ -275,7 +348,12 @@ void ManagerApplication::workerIn(QStringList _args)
 		mRWLock.lockForWrite();
 		mWorkers.append(worker);
 		mWorkerCapacityMap[worker] = cap;
+		mWorkerCapsMap[worker] = 0;
 		emit out(ComputeGridGlobals::makeProcessCommand(PC_WORKER_DATA, QStringList() << worker << QString::number(DTPT_TASK_CONFIG) << mConfig.toString()));
+
+		// workers that understand it answer with their own capabilities, the others keep the message per task
+		emit out(ComputeGridGlobals::makeProcessCommand(PC_WORKER_DATA, QStringList() << worker << QString::number(DTPT_GRID_CAPS) << QString::number(GC_TASK_BATCHES | GC_BINARY_FRAMES)));
+		wake();
 		mRWLock.unlock();
 
 		emit out(ComputeGridGlobals::makeLogCommand(LS_MP, LT_WARNING, QString("Worker: %1 has joined to the compute-grid with %2 parallel computing capacity.").arg(worker).arg(cap)));
@@ -292,11 +370,15 @@ void ManagerApplication::workerOut(QStringList _args)
 
 		mRWLock.lockForWrite();
 
-		// de-assign worker's tasks
+		// de-assign worker's tasks, ahead of what is left of its run
+		mScheduler.release(worker);
 		if (mWorkerTasksMap.contains(worker))
 		{
 			for (DepthTaskList::reverse_iterator it = mWorkerTasksMap[worker].rbegin(); it != mWorkerTasksMap[worker].rend(); ++it)
-				mTasks.insert(mTasks.begin(), *it);
+			{
+				mTaskTimeouts.cancel((*it)->id());
+				returnTask(*it, true);
+			}
 
 			mWorkerTasksMap.remove(worker);
 		}
@@ -304,6 +386,7 @@ void ManagerApplication::workerOut(QStringList _args)
 		// remove worker capacity
 		if(mWorkerCapacityMap.contains(worker))
 			mWorkerCapacityMap.remove(worker);
+		mWorkerCapsMap.remove(worker);
 		
 		// remove worker
 		int ind = -1;
@@ -313,6 +396,7 @@ void ManagerApplication::workerOut(QStringList _args)
 			emit out(ComputeGridGlobals::makeLogCommand(LS_MP, LT_WARNING, QString("Worker: %1 is out of grid.").arg(worker)));
 		}
 
+		wake();
 		mRWLock.unlock();
 	}
 	else
@@ -329,29 +413,45 @@ void ManagerApplication::workerData(QStringList _args)
 		switch (dtpt)
 		{
 		case AnkaDepthLib::DTPT_TASK_RESULT:
+		case AnkaDepthLib::DTPT_TASK_RESULT_BATCH:
+			// a batch is taken under one lock
+			mRWLock.lockForWrite();
+			for (int i = 2; i + 1 < _args.count(); i += 2)
+				taskResult(worker, (DepthTaskWorkerStatus)_args[i].toInt(), _args[i + 1].toInt());
+			wake();
+			mRWLock.unlock();
+			break;
+
+		case AnkaDepthLib::DTPT_TASK_RESULT_FRAME:
+		{
+			// read in place from the decoded frame, the text form's argument list is never built
+			GridFrame::Reader reader(GridFrame::fromArgument(_args[2]), GridFrame::GFT_RESULTS);
+			qint32 count = reader.readInt32();
 			mRWLock.lockForWrite();
-			for (int i = 0; i < mWorkerTasksMap[worker].count(); i++)
+			for (qint32 i = 0; i < count && reader.isValid(); ++i)
 			{
-				DepthTask * task = mWorkerTasksMap[worker].at(i);
-				if (task->id() == _args[3].toInt())
-				{
-					if ((DepthTaskWorkerStatus)_args[2].toInt() == DTWS_COMPLETED)
-					{
-						logCompletedTask(*task);
-						mCompletedTaskCounter++;
-					}
-					else
-					{
-						logFailedTask(*task);
-						mFailedTaskCounter++;
-					}
-						
-					mWorkerTasksMap[worker].removeAt(i);
-					delete task;
-					break; //for
-				}
+				DepthTaskWorkerStatus status = (DepthTaskWorkerStatus)reader.readInt32();
+				int id = reader.readInt32();
+				if (reader.isValid())
+					taskResult(worker, status, id);
 			}
+			wake();
 			mRWLock.unlock();
+
+			if (!reader.isValid())
+				emit out(ComputeGridGlobals::makeLogCommand(LS_MP, LT_ERROR, QString("Worker: %1 sent a broken result frame.").arg(worker)));
+			break;
+		}
+
+		case AnkaDepthLib::DTPT_GRID_CAPS:
+			mRWLock.lockForWrite();
+			if (mWorkerCapacityMap.contains(worker))
+				mWorkerCapsMap[worker] = _args[2].toInt();
+			mRWLock.unlock();
+			emit out(ComputeGridGlobals::makeLogCommand(LS_MP, LT_INFO, QString("Worker: %1 takes %2 in %3.")
+				.arg(worker)
+				.arg((_args[2].toInt() & GC_TASK_BATCHES) ? "task batches" : "single tasks")
+				.arg((_args[2].toInt() & GC_BINARY_FRAMES) ? "binary frames" : "text")));
 			break;
 
 		default:
@@ -377,6 +477,7 @@ void ManagerApplication::terminalCommand(QStringList _args)
 		{
 			mRWLock.lockForWrite();
 			mStartFlag = (cmd == "start");
+			wake();
 			mRWLock.unlock();
 		}
 		else if (cmd == "tasks")
@@ -434,13 +535,102 @@ void ManagerApplication::logCompletedTask(DepthTask & _task)
 		emit out(ComputeGridGlobals::makeLogCommand(LS_MP, LT_ERROR, QString("Log file %1 couldn't open.").arg(mCompletedTasksFile.fileName())));
 }
 
-bool ManagerApplication::checkIfNeedToWork()
+void ManagerApplication::taskResult(const QString & _worker, DepthTaskWorkerStatus _status, int _taskId)
 {
-	bool res = false;
+	for (int i = 0; i < mWorkerTasksMap[_worker].count(); i++)
+	{
+		DepthTask * task = mWorkerTasksMap[_worker].at(i);
+		if (task->id() == _taskId)
+		{
+			mTaskTimeouts.cancel(_taskId);
+			if (_status == DTWS_COMPLETED)
+			{
+				logCompletedTask(*task);
+				mCompletedTaskCounter++;
+			}
+			else
+			{
+				logFailedTask(*task);
+				mFailedTaskCounter++;
+			}
 
-	mRWLock.lockForRead();
-	res = mWorkers.count() > 0 && mStartFlag;
-	mRWLock.unlock();
+			mWorkerTasksMap[_worker].removeAt(i);
+			delete task;
+			break; //for
+		}
+	}
+}
+
+void ManagerApplication::sendTasks(const QString & _worker, const DepthTaskList & _tasks)
+{
+	int caps = mWorkerCapsMap.value(_worker);
+	if (caps & GC_BINARY_FRAMES)
+	{
+		int batch = (caps & GC_TASK_BATCHES) ? TASK_BATCH_MAX : 1;
+		for (int i = 0; i < _tasks.count(); i += batch)
+		{
+			int count = std::min(batch, _tasks.count() - i);
+			GridFrame::Writer writer(GridFrame::GFT_TASKS);
+			writer.writeInt32(count);
+			for (int j = i; j < i + count; ++j)
+				_tasks[j]->write(writer);
+			emit out(ComputeGridGlobals::makeProcessCommand(PC_WORKER_DATA, QStringList() << _worker << QString::number(DTPT_TASK_EXECUTE_FRAME) << GridFrame::toArgument(writer.frame())));
+		}
+		return;
+	}
+
+	if (!(caps & GC_TASK_BATCHES))
+	{
+		for (DepthTaskList::const_iterator it = _tasks.constBegin(); it != _tasks.constEnd(); ++it)
+			emit out(ComputeGridGlobals::makeProcessCommand(PC_WORKER_DATA, QStringList() << _worker << QString::number(DTPT_TASK_EXECUTE) << (*it)->toString()));
+		return;
+	}
+
+	for (int i = 0; i < _tasks.count(); i += TASK_BATCH_MAX)
+	{
+		QStringList args = QStringList() << _worker << QString::number(DTPT_TASK_EXECUTE_BATCH);
+		for (int j = i; j < std::min(i + TASK_BATCH_MAX, _tasks.count()); ++j)
+			args << _tasks[j]->toString();
+		emit out(ComputeGridGlobals::makeProcessCommand(PC_WORKER_DATA, args));
+	}
+}
+
+DepthTask * ManagerApplication::takeTask(int _workerIndex)
+{
+	if (mConfig.schedulingMode() != SM_SCATTERED)
+		return mScheduler.take(mWorkers[_workerIndex]);
+
+	if (mTasks.isEmpty())
+		return nullptr;
+
+	return mTasks.takeAt(mTasks.count() > mWorkers.count() ? ((mTasks.count() / mWorkers.count()) * _workerIndex) : 0);
+}
+
+void ManagerApplication::returnTask(DepthTask * _task, bool _front)
+{
+	if (mConfig.schedulingMode() != SM_SCATTERED)
+		mScheduler.requeue(_task);
+	else if (_front)
+		mTasks.insert(mTasks.begin(), _task);
+	else
+		mTasks.append(_task);
+}
+
+void ManagerApplication::wake()
+{
+	mWakeFlag = true;
+	mStatusDirty = true;
+	mWakeCondition.wakeAll();
+}
+
+int ManagerApplication::pendingTaskCount()
+{
+	return mConfig.schedulingMode() != SM_SCATTERED ? mScheduler.count() : mTasks.count();
+}
+
+bool ManagerApplication::checkIfNeedToWork()
+{
+	bool res = mWorkers.count() > 0 && mStartFlag;
 
 	// schedule check
 	if (res && mConfig.scheduledWork())
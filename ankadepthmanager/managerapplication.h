@@ -5,9 +5,13 @@
 #include <QMap>
 #include <QList>
 #include <QReadWriteLock>
+#include <QWaitCondition>
+#include <QElapsedTimer>
 #include <QFile>
 #include "depthconfiguration.h"
 #include "depthtask.h"
+#include "taskrunscheduler.h"
+#include "timerwheel.h"
 
 class ManagerApplication : public QThread
 {
@@ -36,29 +40,62 @@ public:
 private:
 	void logFailedTask(AnkaDepthLib::DepthTask & _task);
 	void logCompletedTask(AnkaDepthLib::DepthTask & _task);
+
+	// under the lock
 	bool checkIfNeedToWork();
 
+	// wakes the main loop for an event, its status is rebuilt; under the lock
+	void wake();
+
+	// the next task for the _workerIndex'th worker by the scheduling mode, nullptr if none is pending; under the lock
+	AnkaDepthLib::DepthTask * takeTask(int _workerIndex);
+
+	// a task handed out back to the pending ones, first in line with _front; under the lock
+	void returnTask(AnkaDepthLib::DepthTask * _task, bool _front);
+
+	int pendingTaskCount();
+
+	// the outcome of a task _worker ran; under the lock
+	void taskResult(const QString & _worker, AnkaDepthLib::DepthTaskWorkerStatus _status, int _taskId);
+
+	// hands _tasks to _worker, in blocks of TASK_BATCH_MAX if it takes batches and as frames if it reads them
+	void sendTasks(const QString & _worker, const AnkaDepthLib::DepthTaskList & _tasks);
+
 	// start flag
 	bool mStartFlag;
 
 	// lock object to use in invoke calls
 	QReadWriteLock mRWLock;
 
+	// the main loop sleeps on it with the lock released, mWakeFlag keeps an event coming while it runs
+	QWaitCondition mWakeCondition;
+	bool mWakeFlag;
+
 	// configuration
 	AnkaDepthLib::DepthConfiguration mConfig;
 
 	// list of tasks
 	AnkaDepthLib::DepthTaskList mTasks;
 
+	// pending tasks in the run scheduling modes, mTasks is empty then
+	AnkaDepthLib::TaskRunScheduler mScheduler;
+
 	// list of active workers
 	QStringList mWorkers;
 
 	// map of worker's parallel computing capacities
 	QMap<QString, int> mWorkerCapacityMap;
 	
+	// map of worker's GridCapability flags, 0 until the worker tells
+	QMap<QString, int> mWorkerCapsMap;
+
 	// map of worker's assigned tasks
 	QMap<QString, AnkaDepthLib::DepthTaskList> mWorkerTasksMap;
 
+	// the assigned tasks' timeouts by task id, on mClock
+	AnkaDepthLib::TimerWheel mTaskTimeouts;
+	QElapsedTimer mClock;
+
 	// completed tasks log file
 	QFile mCompletedTasksFile;
 
@@ -71,6 +108,9 @@ private:
 
 	QString mLastStatus;
 
+	// something shown in the status changed since the last update
+	bool mStatusDirty;
+
 #pragma region Signals-Slots
 signals:
 	// command out signal
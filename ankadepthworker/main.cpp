@@ -5,6 +5,7 @@
 #include <QtConcurrent/qtconcurrentrun.h>
 #include "workerapplication.h"
 #include "computegridcommons.hpp"
+#include "selftest.h"
 
 using namespace ComputeGrid;
 
@@ -28,8 +29,12 @@ int main(int argc, char *argv[])
 #pragma region test call
 	if (argc > 1 && QString(argv[1]) == "-test")
 	{
-		// to do: perform test
-		return 1;
+		QStringList report;
+		bool res = AnkaDepthLib::SelfTest::run(report);
+		for (QStringList::iterator it = report.begin(); it != report.end(); ++it)
+			outStream << *it << endl;
+
+		return res ? 0 : 1;
 	}
 #pragma endregion
 
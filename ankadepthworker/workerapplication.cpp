@@ -1,5 +1,6 @@
 #include "workerapplication.h"
 #include "dbpatchbufferer.h"
+#include "gridframe.h"
 #include <QCoreApplication>
 #include <QSqlDatabase>
 #include <QSqlQuery>
@@ -7,35 +8,48 @@
 #include <QSqlError>
 #include <QThread>
 #include <QThreadPool>
+#include <algorithm>
+#include <climits>
 
 using namespace ComputeGrid;
 
 WorkerApplication::WorkerApplication(QObject * _parent)
 	: QThread(_parent),
+	mWakeFlag(false),
 	mCompletedTaskCounter(0),
-	mFailedTaskCounter(0)
+	mFailedTaskCounter(0),
+	mStatusDirty(true),
+	mManagerCaps(0)
 {
+	// the tasks query the database over their threads' pooled connections, an idle thread keeps them
+	QThreadPool::globalInstance()->setExpiryTimeout(-1);
+
 	DBPatchBufferer::init(&mConfig);
+	mPrefetcher.configure(&mConfig);
 }
 
 WorkerApplication::~WorkerApplication()
 {
+	mPrefetcher.clear();
 	DBPatchBufferer::clearBuffer();
 }
 
 void WorkerApplication::run()
 {
+	// the loop sleeps until tasks are queued or finish, or the result window or a held back status update is due
 	QString status;
+	QElapsedTimer statusTimer;
+	mRWLock.lockForWrite();
 	while (!QThread::isInterruptionRequested())
 	{
+		mWakeFlag = false;
 		DepthTaskWorker * tw = nullptr;
-		
-		mRWLock.lockForWrite();
 		for (DepthTaskWorkerList::iterator it = mTaskWorkers.begin(); it != mTaskWorkers.end(); ++it)
 		{
 			tw = *it;
 			if (tw->status() == DTWS_IDLE)
 			{
+				QObject::connect(tw, SIGNAL(started(DepthTaskWorker *)), this, SLOT(taskWorkerStarted(DepthTaskWorker *)));
 				QObject::connect(tw, SIGNAL(progress(DepthTaskWorker *, QString)), this, SLOT(taskWorkerProgress(DepthTaskWorker *, QString)));
 				QObject::connect(tw, SIGNAL(error(DepthTaskWorker *, QString)), this, SLOT(taskWorkerError(DepthTaskWorker *, QString)));
 				QObject::connect(tw, SIGNAL(finished(DepthTaskWorker *)), this, SLOT(taskWorkerFinished(DepthTaskWorker *)));
@@ -44,23 +58,50 @@ void WorkerApplication::run()
 			}
 		}
 
-		status = QString("Anka-Depth v%1 - Queued: <font color=\"blue\">%2</font>, Completed: <font color=\"green\">%3</font>, Failed: <font color=\"red\">%4</font>")
-			.arg(QString("%1.%2.%3.%4").arg(AnkaDepthLibGlobals::VersionMajor).arg(AnkaDepthLibGlobals::VersionMinor).arg(AnkaDepthLibGlobals::VersionPatch).arg(AnkaDepthLibGlobals::VersionBuild))
-			.arg(mTaskWorkers.count())
-			.arg(mCompletedTaskCounter)
-			.arg(mFailedTaskCounter);
-		mRWLock.unlock();
+		// results finished close together go out as one message
+		unsigned long wait = ULONG_MAX;
+		if (!mResults.isEmpty())
+		{
+			qint64 left = mConfig.taskResultWindow() - mResultTimer.elapsed();
+			if (left > 0)
+				wait = (unsigned long)left;
+			else
+				flushResults();
+		}
+
+		// status update, at most one per status interval
+		if (mStatusDirty)
+		{
+			qint64 left = statusTimer.isValid() ? mConfig.statusInterval() - statusTimer.elapsed() : 0;
+			if (left > 0)
+				wait = std::min(wait, (unsigned long)left);
+			else
+			{
+				status = QString("Anka-Depth v%1 - Queued: <font color=\"blue\">%2</font>, Completed: <font color=\"green\">%3</font>, Failed: <font color=\"red\">%4</font>")
+					.arg(QString("%1.%2.%3.%4").arg(AnkaDepthLibGlobals::VersionMajor).arg(AnkaDepthLibGlobals::VersionMinor).arg(AnkaDepthLibGlobals::VersionPatch).arg(AnkaDepthLibGlobals::VersionBuild))
+					.arg(mTaskWorkers.count())
+					.arg(mCompletedTaskCounter)
+					.arg(mFailedTaskCounter);
+				mStatusDirty = false;
+				statusTimer.start();
+
+				if (mLastStatus != status)
+					emit out(ComputeGridGlobals::makeProcessCommand(PC_STATUS_MESSAGE, QStringList() << (mLastStatus = status)));
+			}
+		}
 
-		if (mLastStatus != status)
-			emit out(ComputeGridGlobals::makeProcessCommand(PC_STATUS_MESSAGE, QStringList() << (mLastStatus = status)));
+		// events coming while the loop ran are not waited for
+		if (!mWakeFlag)
+			mWakeCondition.wait(&mRWLock, wait);
 	}
+	mRWLock.unlock();
 
 	emit finished();
 }
 
 void WorkerApplication::workerData(QStringList _args)
 {
-	if (_args.count() == 2)
+	if (_args.count() >= 2)
 	{
 		DepthTaskParameterType pt = (DepthTaskParameterType)_args[0].toInt();
 
@@ -73,22 +114,64 @@ void WorkerApplication::workerData(QStringList _args)
 
 		case AnkaDepthLib::DTPT_TASK_CONFIG:
 			mConfig.fromString(_args[1]);
+			mPrefetcher.clear();
+			DBPatchBufferer::init(&mConfig);
+			mPrefetcher.configure(&mConfig);
 			emit out(ComputeGridGlobals::makeLogCommand(LS_WP, LT_INFO, "Depth task configuration loaded."));
 			break;
 
 		case AnkaDepthLib::DTPT_TASK_EXECUTE:
 		{
-			DepthTaskWorker * tw = new DepthTaskWorker(&mConfig, DepthTask(_args[1]));
-			tw->setStatus(DTWS_IDLE);
+			DepthTask task(_args[1]);
+			DepthTaskWorker * tw = newTaskWorker(task);
 
 			mRWLock.lockForWrite();
 			mTaskWorkers.append(tw);
+			wake();
 			mRWLock.unlock();
 
 			emit out(ComputeGridGlobals::makeLogCommand(LS_WP, LT_INFO, QString("Region ID: %1 => Execution queued.").arg(tw->id())));
 			break;
 		}
 
+		case AnkaDepthLib::DTPT_TASK_EXECUTE_BATCH:
+		{
+			DepthTaskWorkerList taskWorkers;
+			for (int i = 1; i < _args.count(); ++i)
+			{
+				DepthTask task(_args[i]);
+				taskWorkers.append(newTaskWorker(task));
+			}
+			queueTaskWorkers(taskWorkers);
+			break;
+		}
+
+		case AnkaDepthLib::DTPT_TASK_EXECUTE_FRAME:
+		{
+			// read in place from the decoded frame
+			GridFrame::Reader reader(GridFrame::fromArgument(_args[1]), GridFrame::GFT_TASKS);
+			qint32 count = reader.readInt32();
+			DepthTaskWorkerList taskWorkers;
+			for (qint32 i = 0; i < count && reader.isValid(); ++i)
+			{
+				DepthTask task;
+				if (task.read(reader))
+					taskWorkers.append(newTaskWorker(task));
+			}
+			queueTaskWorkers(taskWorkers);
+
+			if (!reader.isValid())
+				emit out(ComputeGridGlobals::makeLogCommand(LS_WP, LT_ERROR, QString("Broken task frame, %1 of %2 tasks read.").arg(taskWorkers.count()).arg(count)));
+			break;
+		}
+
+		case AnkaDepthLib::DTPT_GRID_CAPS:
+			mRWLock.lockForWrite();
+			mManagerCaps = _args[1].toInt();
+			mRWLock.unlock();
+			emit out(ComputeGridGlobals::makeProcessCommand(PC_WORKER_DATA, QStringList() << QString::number(DTPT_GRID_CAPS) << QString::number(GC_TASK_BATCHES | GC_BINARY_FRAMES)));
+			break;
+
 		default:
 			emit out(ComputeGridGlobals::makeLogCommand(LS_WP, LT_ERROR, QString("Unexpected task arguments.")));
 			break;
@@ -130,16 +213,79 @@ void WorkerApplication::workerExit(QStringList _args)
 		}
 	}
 
+	flushResults();
 	mRWLock.unlock();
 
 	QThreadPool::globalInstance()->clear();
 
+	mPrefetcher.clear();
 	DBPatchBufferer::clearBuffer();
 
 	QThread::requestInterruption();
+	mRWLock.lockForWrite();
+	wake();
+	mRWLock.unlock();
+}
+
+DepthTaskWorker * WorkerApplication::newTaskWorker(DepthTask & _task)
+{
+	DepthTaskWorker * tw = new DepthTaskWorker(&mConfig, _task);
+	tw->setStatus(DTWS_IDLE);
+
+	// its patches start loading while it waits for a thread
+	mPrefetcher.schedule(_task);
+	return tw;
+}
+
+void WorkerApplication::queueTaskWorkers(const DepthTaskWorkerList & _taskWorkers)
+{
+	if (_taskWorkers.isEmpty())
+		return;
+
+	mRWLock.lockForWrite();
+	mTaskWorkers.append(_taskWorkers);
+	wake();
+	mRWLock.unlock();
+
+	emit out(ComputeGridGlobals::makeLogCommand(LS_WP, LT_INFO, QString("Region IDs: %1 - %2 => Execution of %3 regions queued.").arg(_taskWorkers.first()->id()).arg(_taskWorkers.last()->id()).arg(_taskWorkers.count())));
+}
+
+void WorkerApplication::flushResults()
+{
+	if (mResults.isEmpty())
+		return;
+
+	if (mManagerCaps & GC_BINARY_FRAMES)
+	{
+		GridFrame::Writer writer(GridFrame::GFT_RESULTS);
+		writer.writeInt32(mResults.count() / 2);
+		for (QVector<int>::const_iterator it = mResults.constBegin(); it != mResults.constEnd(); ++it)
+			writer.writeInt32(*it);
+		emit out(ComputeGridGlobals::makeProcessCommand(PC_WORKER_DATA, QStringList() << QString::number(DTPT_TASK_RESULT_FRAME) << GridFrame::toArgument(writer.frame())));
+	}
+	else
+	{
+		QStringList args = QStringList() << QString::number(DTPT_TASK_RESULT_BATCH);
+		for (QVector<int>::const_iterator it = mResults.constBegin(); it != mResults.constEnd(); ++it)
+			args << QString::number(*it);
+		emit out(ComputeGridGlobals::makeProcessCommand(PC_WORKER_DATA, args));
+	}
+	mResults.clear();
+}
+
+void WorkerApplication::wake()
+{
+	mWakeFlag = true;
+	mStatusDirty = true;
+	mWakeCondition.wakeAll();
 }
 
 #pragma region Slots
+void WorkerApplication::taskWorkerStarted(AnkaDepthLib::DepthTaskWorker * _taskWorker)
+{
+	mPrefetcher.started(_taskWorker->id());
+}
+
 void WorkerApplication::taskWorkerProgress(AnkaDepthLib::DepthTaskWorker * _taskWorker, QString _message)
 {
 	emit out(ComputeGridGlobals::makeLogCommand(LS_WP, LT_INFO, _message));
@@ -152,10 +298,17 @@ void WorkerApplication::taskWorkerError(AnkaDepthLib::DepthTaskWorker * _taskWor
 
 void WorkerApplication::taskWorkerFinished(AnkaDepthLib::DepthTaskWorker * _taskWorker)
 {
-	emit out(ComputeGridGlobals::makeProcessCommand(PC_WORKER_DATA, QStringList() << QString::number(DTPT_TASK_RESULT) << QString::number(_taskWorker->status()) << QString::number(_taskWorker->id())));
-
 	mRWLock.lockForWrite();
 
+	if (mManagerCaps & GC_TASK_BATCHES)
+	{
+		if (mResults.isEmpty())
+			mResultTimer.start();
+		mResults << _taskWorker->status() << _taskWorker->id();
+	}
+	else
+		emit out(ComputeGridGlobals::makeProcessCommand(PC_WORKER_DATA, QStringList() << QString::number(DTPT_TASK_RESULT) << QString::number(_taskWorker->status()) << QString::number(_taskWorker->id())));
+
 	if (_taskWorker->status() == DTWS_COMPLETED)
 		++mCompletedTaskCounter;
 	else
@@ -164,6 +317,11 @@ void WorkerApplication::taskWorkerFinished(AnkaDepthLib::DepthTaskWorker * _task
 	mTaskWorkers.removeAll(_taskWorker);
 	_taskWorker->deleteLater();
 
+	// without queued tasks the manager is waiting on these to send more
+	if (mResults.count() >= TASK_BATCH_MAX * 2 || mTaskWorkers.isEmpty())
+		flushResults();
+
+	wake();
 	mRWLock.unlock();
 }
 #pragma endregion
@@ -3,11 +3,15 @@
 #include <QObject>
 #include <QThread>
 #include <QReadWriteLock>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <QVector>
 #include "computegridcommons.hpp"
 #include "ankadepthlibglobals.h"
 #include "depthconfiguration.h"
 #include "depthtask.h"
 #include "depthtaskworker.h"
+#include "patchprefetcher.h"
 
 using namespace AnkaDepthLib;
 
@@ -31,23 +35,53 @@ private:
 	// lock object to use in invoke calls
 	QReadWriteLock mRWLock;
 
+	// the main loop sleeps on it with the lock released, mWakeFlag keeps an event coming while it runs
+	QWaitCondition mWakeCondition;
+	bool mWakeFlag;
+
 	// configuration
 	DepthConfiguration mConfig;
 
 	// task worker pool
 	DepthTaskWorkerList mTaskWorkers;
 
+	// loads the patches of the queued tasks and of the frames ahead of them
+	PatchPrefetcher mPrefetcher;
+
 	int mCompletedTaskCounter;
 	int mFailedTaskCounter;
 
 	QString mLastStatus;
 
+	// something shown in the status changed since the last update
+	bool mStatusDirty;
+
+	// GridCapability flags of the manager, results are coalesced only for one that takes batches
+	int mManagerCaps;
+
+	// status and id pairs of the finished tasks not yet reported, and the time since the first of them
+	QVector<int> mResults;
+	QElapsedTimer mResultTimer;
+
+	// reports the coalesced results in one message, a frame for a manager that reads them; under the lock
+	void flushResults();
+
+	// a task worker for _task, its prefetch scheduled
+	DepthTaskWorker * newTaskWorker(DepthTask & _task);
+
+	// queues a block of task workers under one lock
+	void queueTaskWorkers(const DepthTaskWorkerList & _taskWorkers);
+
+	// wakes the main loop for an event, its status is rebuilt; under the lock
+	void wake();
+
 #pragma region Signals-Slots
 signals:
 	void finished();
 	void out(QString _cmd);
 
 public slots:
+	void taskWorkerStarted(DepthTaskWorker * _taskWorker);
 	void taskWorkerProgress(DepthTaskWorker * _taskWorker, QString _message);
 	void taskWorkerError(DepthTaskWorker * _taskWorker, QString _message);
 	void taskWorkerFinished(DepthTaskWorker * _taskWorker);